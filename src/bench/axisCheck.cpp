@@ -0,0 +1,126 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Check of the axis descriptions given to the kernel. The sensor deadzone
+// and fuzz belong only on axes which come from the accelerometer or gyro, as
+// the decoder marks them, wherever they are in the layout and however they
+// are reordered. Sliders keep the small slider fuzz and no deadzone.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "types.hpp"
+#include "data.hpp"
+#include "net/dataDecode.hpp"
+#include "output/linux/outputMgr.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::decode;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+	printf("  %-56s %s\n", what, ok ? "ok" : "FAILED");
+	if(!ok) failures++;
+}
+
+static bool isSlider(const dpAxisInfo &info) {
+	return info.fuzz == SLIDER_FUZZ && info.flat == 0 && info.resolution == 0;
+}
+
+/**
+ * Describes the axes of data as MainThread does for a joystick, and checks
+ * that exactly those in sensors got the sensor description.
+ */
+static void checkLayout(const char *what, const DPJSData &data, const vector<bool> &sensors) {
+	printf("%s:\n", what);
+	vector<dpAxisInfo> info = OutputManager::DescribeAxes(MODE_JS, data.axes.size(),
+			data.accelAxes, data.gyroAxes);
+	check(info.size() == data.axes.size() && sensors.size() == data.axes.size(), "one description per axis");
+	for(size_t i = 0; i < info.size() && i < sensors.size(); i++) {
+		char line[64];
+		snprintf(line, sizeof(line), "axis %d is a %s", (int)i, sensors[i] ? "sensor" : "slider");
+		check(sensors[i] ? info[i].flat > 0 && info[i].fuzz != SLIDER_FUZZ : isSlider(info[i]), line);
+	}
+}
+
+static vector<bool> sensorsAt(int numAxes, int first, int count) {
+	vector<bool> ret(numAxes, false);
+	for(int i = first; i < first + count && i < numAxes; i++) ret[i] = true;
+	return ret;
+}
+
+static RawBinaryElement slider() {
+	RawBinaryElement elem;
+	memset(&elem, 0, sizeof(elem));
+	elem.flags = ITEM_FLAG_SLIDER | ITEM_FLAG_HAS_X_AXIS | ITEM_FLAG_HAS_Y_AXIS;
+	elem.integer.data1 = 8192;
+	elem.integer.data2 = -8192;
+	return elem;
+}
+
+static RawBinaryHeader header(int flags) {
+	RawBinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	header.flags = flags;
+	header.axis.az = 9.8f;
+	return header;
+}
+
+int main(int argc, char **argv) {
+	Data::tweaks.tilt[0].totalAngle = Data::tweaks.tilt[1].totalAngle = 120;
+	Data::tweaks.rotation[0].totalAngle = 90;
+	for(int i = 0; i < NUM_AXIS; i++) Data::axisOrder[i] = i;
+
+	// A layout of sliders only, from a phone which also advertises a raw
+	// device; none of its axes come from a sensor.
+	vector<RawBinaryElement> sliders(2, slider());
+	checkLayout("Binary, sliders only", getBinaryData(header(0), sliders), sensorsAt(4, 0, 0));
+	DecodePlan plan;
+	checkLayout("Binary plan, sliders only", plan.Decode(header(0), sliders), sensorsAt(4, 0, 0));
+	const char *text = "[{A8192,-8192};{A0,0};1]";
+	checkLayout("Text, sliders only", getTextData(text, strlen(text)), sensorsAt(4, 0, 0));
+
+	// Header axes come first, whatever the sliders are
+	checkLayout("Binary, gyro and sliders", getBinaryData(header(HEADER_FLAG_HAS_GYRO), sliders), sensorsAt(5, 0, 1));
+	checkLayout("Binary plan, accel, gyro and sliders",
+			plan.Decode(header(HEADER_FLAG_HAS_ACCEL | HEADER_FLAG_HAS_GYRO), sliders), sensorsAt(7, 0, 3));
+
+	// A raw device in the text protocol is where its token is
+	text = "[{A8192,-8192};{0.5,0.5,9.8};0]";
+	checkLayout("Text, slider then raw device", getTextData(text, strlen(text)), sensorsAt(4, 2, 2));
+
+	// Swapping a slider with a tilt axis moves the description with it
+	Data::axisOrder[0] = 2;
+	Data::axisOrder[2] = 0;
+	DPJSData data = getTextData(text, strlen(text));
+	vector<bool> sensors = sensorsAt(4, 2, 2);
+	sensors[0] = true;
+	sensors[2] = false;
+	checkLayout("Text, slider swapped with a tilt axis", data, sensors);
+	data.reorder(Data::buttonOrder, Data::axisOrder);
+	check(data.accelAxes == ((1u << 0) | (1u << 3)), "reorder moves the sensor marks");
+
+	printf("{\"suite\":\"axischeck\",\"failures\":%d}\n", failures);
+	return failures == 0 ? 0 : 1;
+}
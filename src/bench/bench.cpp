@@ -0,0 +1,116 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "timing.hpp"
+
+// Time spent finding how many iterations fill a repeat
+#define CALIBRATE_NANOS (10 * NANOS_PER_MILLI)
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::bench;
+
+static volatile int64_t intSink;
+static volatile double doubleSink;
+
+void droidpad::bench::sink(int64_t value) {
+	intSink += value;
+}
+
+void droidpad::bench::sink(double value) {
+	doubleSink += value;
+}
+
+BenchCase::BenchCase(const string &name, const string &layout) :
+	name(name),
+	layout(layout)
+{ }
+
+BenchCase::~BenchCase() { }
+
+BenchOptions::BenchOptions() :
+	repeatNanos(50 * NANOS_PER_MILLI),
+	repeats(7)
+{ }
+
+bool BenchOptions::Parse(int argc, char **argv, const char *description) {
+	for(int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if(strncmp(arg, "--filter=", 9) == 0) filter = arg + 9;
+		else if(strncmp(arg, "--time=", 7) == 0) repeatNanos = atof(arg + 7) * NANOS_PER_MILLI;
+		else if(strncmp(arg, "--repeats=", 10) == 0) repeats = atoi(arg + 10);
+		else if(strncmp(arg, "--commit=", 9) == 0) commit = arg + 9;
+		else {
+			printf("%s\n"
+					"Usage: %s [--filter=TEXT] [--time=MS] [--repeats=N] [--commit=ID]\n"
+					"  --filter   only run benchmarks whose name or layout contains TEXT\n"
+					"  --time     target time of each repeat, in ms (default 50)\n"
+					"  --repeats  number of timed repeats (default 7)\n"
+					"  --commit   commit id to include in the results\n",
+					description, argv[0]);
+			return false;
+		}
+	}
+	if(repeats < 1) repeats = 1;
+	return true;
+}
+
+static uint64_t timeRun(BenchCase *c, long iterations) {
+	uint64_t start = monotonicNanos();
+	c->Run(iterations);
+	return monotonicNanos() - start;
+}
+
+void droidpad::bench::runAll(const vector<BenchCase *> &cases, const BenchOptions &options, const char *suite) {
+	for(vector<BenchCase *>::const_iterator it = cases.begin(); it != cases.end(); it++) {
+		BenchCase *c = *it;
+		if(!options.filter.empty() &&
+				c->name.find(options.filter) == string::npos &&
+				c->layout.find(options.filter) == string::npos)
+			continue;
+
+		// Find roughly how many iterations take CALIBRATE_NANOS, then scale to the repeat time.
+		long iterations = 1;
+		uint64_t elapsed;
+		while((elapsed = timeRun(c, iterations)) < CALIBRATE_NANOS && iterations < (1L << 30))
+			iterations *= 2;
+		iterations = max(1L, (long)((double)iterations * options.repeatNanos / max(elapsed, (uint64_t)1)));
+
+		vector<double> perOp;
+		for(int i = 0; i < options.repeats; i++)
+			perOp.push_back((double)timeRun(c, iterations) / iterations);
+		sort(perOp.begin(), perOp.end());
+
+		printf("{\"suite\":\"%s\",\"bench\":\"%s\",\"layout\":\"%s\",\"ns_per_op\":%.2f,\"min_ns_per_op\":%.2f,"
+				"\"iterations\":%ld,\"repeats\":%d",
+				suite, c->name.c_str(), c->layout.c_str(),
+				perOp[perOp.size() / 2], perOp[0], iterations, options.repeats);
+		if(!options.commit.empty()) printf(",\"commit\":\"%s\"", options.commit.c_str());
+		printf("}\n");
+		fflush(stdout);
+	}
+}
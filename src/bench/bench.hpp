@@ -0,0 +1,82 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_BENCH_H
+#define DP_BENCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace droidpad {
+	namespace bench {
+		/**
+		 * A single thing to be timed.
+		 */
+		class BenchCase {
+			public:
+				/**
+				 * name - What is being measured, usually the function name
+				 * layout - The input it's measured with
+				 */
+				BenchCase(const std::string &name, const std::string &layout);
+				virtual ~BenchCase();
+
+				/**
+				 * Runs the operation being measured the given number of times.
+				 * Results should be passed to sink() so they aren't optimised away.
+				 */
+				virtual void Run(long iterations) = 0;
+
+				std::string name, layout;
+		};
+
+		class BenchOptions {
+			public:
+				BenchOptions();
+
+				// Only run cases whose name or layout contains this
+				std::string filter;
+				// Target time for each repeat
+				uint64_t repeatNanos;
+				int repeats;
+				// Commit id to put in each result, if known
+				std::string commit;
+
+				/**
+				 * Parses the common options. Returns false if the program should exit.
+				 */
+				bool Parse(int argc, char **argv, const char *description);
+		};
+
+		/**
+		 * Runs each case and prints the results to stdout as one JSON object
+		 * per line, with the median and minimum time per operation.
+		 */
+		void runAll(const std::vector<BenchCase *> &cases, const BenchOptions &options, const char *suite);
+
+		/**
+		 * Keeps a value alive, so that the compiler can't remove the work that produced it.
+		 */
+		void sink(int64_t value);
+		void sink(double value);
+	};
+};
+
+#endif
@@ -0,0 +1,455 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Microbenchmarks of the decoding done for every frame received.
+
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <wx/string.h>
+
+#include "types.hpp"
+#include "data.hpp"
+#include "net/dataDecode.hpp"
+#include "net/byteSwap.hpp"
+#include "mathUtil.hpp"
+#include "frameGenerator.hpp"
+#include "textReference.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::bench;
+using namespace droidpad::decode;
+using namespace droidpad::sim;
+
+/**
+ * Layouts typical of what phones send.
+ */
+typedef struct {
+	const char *name;
+	int mode;
+	bool accel, gyro;
+	// On-screen axes and buttons, for MODE_JS
+	int axes, buttons;
+} BenchLayout;
+
+static const BenchLayout layouts[] = {
+	// Tilt only, with a full set of buttons
+	{ "js-2a-12b",		MODE_JS,	true,	false,	0,	12 },
+	// Tilt plus two on-screen sticks, and a large button grid
+	{ "js-6a-28b",		MODE_JS,	true,	false,	4,	28 },
+	{ "mouse-trackpad",	MODE_MOUSE,	false,	false,	0,	0 },
+	{ "absmouse-gyro",	MODE_ABSMOUSE,	true,	true,	0,	0 },
+	{ "slide-8b",		MODE_SLIDE,	false,	false,	0,	0 },
+};
+#define NUM_LAYOUTS (sizeof(layouts) / sizeof(BenchLayout))
+
+/**
+ * Two consecutive frames in a layout, in every form decoding goes through.
+ */
+class LayoutFrames {
+	public:
+		LayoutFrames(const BenchLayout &layout) :
+			name(layout.name)
+		{
+			SimLayout simLayout;
+			simLayout.mode = layout.mode;
+			simLayout.accel = layout.accel;
+			simLayout.gyro = layout.gyro;
+			simLayout.axes = layout.axes;
+			simLayout.buttons = layout.buttons;
+			FrameGenerator gen(simLayout, 1);
+
+			// Part way through the shape, so that values aren't all zero
+			gen.Step(0.3);
+			prevData = getTextData(textLine(gen));
+			gen.Step(0.3 + 1.0 / 60);
+
+			rawText = gen.TextFrame();
+			rawText.erase(rawText.size() - 1);
+			text = wxString(rawText.c_str(), wxConvUTF8);
+			binary = gen.BinaryFrame();
+			header = getBinaryHeader(binary.c_str());
+			elements = getBinaryElements(binary.c_str() + sizeof(RawBinaryHeader), header.numElements);
+			data = getBinaryData(header, elements);
+		}
+
+		string name;
+		wxString text;
+		string rawText;
+		string binary;
+		RawBinaryHeader header;
+		vector<RawBinaryElement> elements;
+		DPJSData data, prevData;
+
+	private:
+		static wxString textLine(const FrameGenerator &gen) {
+			string line = gen.TextFrame();
+			return wxString(line.substr(0, line.size() - 1).c_str(), wxConvUTF8);
+		}
+};
+
+class TextDataCase : public BenchCase {
+	public:
+		TextDataCase(const LayoutFrames &frames) :
+			BenchCase("getTextData", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((int64_t)getTextData(frames.text).axes.size());
+		}
+	private:
+		const LayoutFrames &frames;
+};
+
+// As done on the receive buffer, reusing the output's storage
+class RawTextDataCase : public BenchCase {
+	public:
+		RawTextDataCase(const LayoutFrames &frames) :
+			BenchCase("getTextData(raw)", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			DPJSData data;
+			for(long i = 0; i < iterations; i++) {
+				getTextData(frames.rawText.data(), frames.rawText.size(), data);
+				sink((int64_t)data.axes.size());
+			}
+		}
+	private:
+		const LayoutFrames &frames;
+};
+
+// The previous wxStringTokenizer based parser, for comparison
+class TextDataReferenceCase : public BenchCase {
+	public:
+		TextDataReferenceCase(const LayoutFrames &frames) :
+			BenchCase("getTextDataReference", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((int64_t)getTextDataReference(frames.text).axes.size());
+		}
+	private:
+		const LayoutFrames &frames;
+};
+
+class BinaryHeaderCase : public BenchCase {
+	public:
+		BinaryHeaderCase(const LayoutFrames &frames) :
+			BenchCase("getBinaryHeader", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((int64_t)getBinaryHeader(frames.binary.c_str()).numElements);
+		}
+	private:
+		const LayoutFrames &frames;
+};
+
+// All elements of one frame, one at a time
+class BinaryElementCase : public BenchCase {
+	public:
+		BinaryElementCase(const LayoutFrames &frames) :
+			BenchCase("getBinaryElement", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			const char *elements = frames.binary.c_str() + sizeof(RawBinaryHeader);
+			int num = frames.header.numElements;
+			for(long i = 0; i < iterations; i++)
+				for(int e = 0; e < num; e++)
+					sink((int64_t)getBinaryElement(elements + e * sizeof(RawBinaryElement)).flags);
+		}
+	private:
+		const LayoutFrames &frames;
+};
+
+class BinaryDataCase : public BenchCase {
+	public:
+		BinaryDataCase(const LayoutFrames &frames) :
+			BenchCase("getBinaryData", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((int64_t)getBinaryData(frames.header, frames.elements).axes.size());
+		}
+	private:
+		const LayoutFrames &frames;
+};
+
+// The same work as getBinaryData, through a plan built on the first run
+class DecodePlanCase : public BenchCase {
+	public:
+		DecodePlanCase(const LayoutFrames &frames) :
+			BenchCase("DecodePlan::Decode", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			DPJSData data;
+			for(long i = 0; i < iterations; i++) {
+				plan.Decode(frames.header, frames.elements, data);
+				sink((int64_t)data.axes.size());
+			}
+		}
+	private:
+		const LayoutFrames &frames;
+		DecodePlan plan;
+};
+
+// Everything done to a binary frame once it has been received
+class BinaryFrameCase : public BenchCase {
+	public:
+		BinaryFrameCase(const LayoutFrames &frames) :
+			BenchCase("binaryFrame", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			const char *buf = frames.binary.c_str();
+			for(long i = 0; i < iterations; i++) {
+				RawBinaryHeader header = getBinaryHeader(buf);
+				sink((int64_t)getBinaryData(header,
+							getBinaryElements(buf + sizeof(RawBinaryHeader), header.numElements)).axes.size());
+			}
+		}
+	private:
+		const LayoutFrames &frames;
+};
+
+class ReorderCase : public BenchCase {
+	public:
+		ReorderCase(const LayoutFrames &frames) :
+			BenchCase("DPJSData::reorder", frames.name), data(frames.data)
+		{
+			// Reverse everything, so that every element moves
+			for(int i = data.buttons.size() - 1; i >= 0; i--) bmap.push_back(i);
+			for(int i = data.axes.size() - 1; i >= 0; i--) amap.push_back(i);
+		}
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++) {
+				data.reorder(bmap, amap);
+				sink((int64_t)data.axes.size());
+			}
+		}
+	private:
+		DPJSData data;
+		vector<int> bmap, amap;
+};
+
+class MouseDataCase : public BenchCase {
+	public:
+		MouseDataCase(const LayoutFrames &frames) :
+			BenchCase("DPMouseData", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((int64_t)DPMouseData(frames.data, frames.prevData).x);
+		}
+	private:
+		const LayoutFrames &frames;
+};
+
+class TouchDataCase : public BenchCase {
+	public:
+		TouchDataCase(const LayoutFrames &frames) :
+			BenchCase("DPTouchData", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((double)DPTouchData(frames.data, frames.prevData, prevAbs).x);
+		}
+	private:
+		const LayoutFrames &frames;
+		DPTouchData prevAbs;
+};
+
+class SlideDataCase : public BenchCase {
+	public:
+		SlideDataCase(const LayoutFrames &frames) :
+			BenchCase("DPSlideData", frames.name), frames(frames) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((int64_t)DPSlideData(frames.data, frames.prevData).next);
+		}
+	private:
+		const LayoutFrames &frames;
+};
+
+class AccelToAxesCase : public BenchCase {
+	public:
+		AccelToAxesCase() : BenchCase("accelToAxes", "tilt") { }
+		void Run(long iterations) {
+			float a = 0;
+			for(long i = 0; i < iterations; i++) {
+				// Sweep through a range of tilts
+				a += 0.001f;
+				if(a > 1) a = -1;
+				sink((double)accelToAxes(a * 5, 4, 8).x);
+			}
+		}
+};
+
+class ApplyGammaCase : public BenchCase {
+	public:
+		ApplyGammaCase() : BenchCase("applyGamma", "axis") { }
+		void Run(long iterations) {
+			float v = 0;
+			for(long i = 0; i < iterations; i++) {
+				v += 0.001f;
+				if(v > 1) v = -1;
+				sink((double)applyGamma(v, 0.3f));
+			}
+		}
+};
+
+/**
+ * A block of elements, in network order, as byte swapped on receipt.
+ */
+class ElementBlock {
+	public:
+		ElementBlock(int numElements) :
+			numElements(numElements),
+			name(blockName(numElements)),
+			data(numElements * sizeof(RawBinaryElement), 0),
+			out(numElements)
+		{
+			for(size_t i = 0; i < data.size(); i++)
+				data[i] = (char)(i * 7 + 1);
+		}
+
+		int numElements;
+		string name;
+		string data;
+		vector<RawBinaryElement> out;
+
+	private:
+		static string blockName(int numElements) {
+			char name[32];
+			sprintf(name, "%d-elements", numElements);
+			return name;
+		}
+};
+
+// Swapping each field in turn, as getBinaryElement used to
+class FieldSwapCase : public BenchCase {
+	public:
+		FieldSwapCase(ElementBlock &block) :
+			BenchCase("swap(ntohl fields)", block.name), block(block) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++) {
+				for(int e = 0; e < block.numElements; e++) {
+					RawBinaryElement &elem = block.out[e];
+					memcpy(&elem, block.data.c_str() + e * sizeof(RawBinaryElement), sizeof(RawBinaryElement));
+					NTOH(elem.flags);
+					NTOH(elem.raw.data1);
+					NTOH(elem.raw.data2);
+					NTOH(elem.raw.data3);
+				}
+				sink((int64_t)block.out[0].flags);
+			}
+		}
+	private:
+		ElementBlock &block;
+};
+
+class SwapKernelCase : public BenchCase {
+	public:
+		SwapKernelCase(ElementBlock &block, int kernel) :
+			BenchCase(string("swap(") + getSwapKernelName(kernel) + ")", block.name),
+			block(block),
+			swap(getSwapKernel(kernel)) { }
+		void Run(long iterations) {
+			size_t words = block.numElements * sizeof(RawBinaryElement) / 4;
+			for(long i = 0; i < iterations; i++) {
+				swap(&block.out[0], block.data.c_str(), words);
+				sink((int64_t)block.out[0].flags);
+			}
+		}
+	private:
+		ElementBlock &block;
+		SwapKernel swap;
+};
+
+class BinaryElementsCase : public BenchCase {
+	public:
+		BinaryElementsCase(ElementBlock &block) :
+			BenchCase("getBinaryElements", block.name), block(block) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((int64_t)getBinaryElements(block.data.c_str(), block.numElements)[0].flags);
+		}
+	private:
+		ElementBlock &block;
+};
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	if(!options.Parse(argc, argv, "Benchmarks of frame decoding."))
+		return 0;
+
+	// Typical, non-default tweaks, so that gamma curves are applied
+	Data::tweaks.tilt[0].totalAngle = Data::tweaks.tilt[1].totalAngle = 90;
+	Data::tweaks.tilt[0].gamma = Data::tweaks.tilt[1].gamma = 20;
+	Data::tweaks.rotation[0].totalAngle = 90;
+	for(int i = 0; i < NUM_AXIS; i++)
+		Data::tweaks.onScreen[i].gamma = 10;
+
+	vector<LayoutFrames *> frames;
+	vector<BenchCase *> cases;
+	for(size_t i = 0; i < NUM_LAYOUTS; i++) {
+		LayoutFrames *f = new LayoutFrames(layouts[i]);
+		frames.push_back(f);
+		cases.push_back(new TextDataCase(*f));
+		cases.push_back(new RawTextDataCase(*f));
+		cases.push_back(new TextDataReferenceCase(*f));
+		cases.push_back(new BinaryHeaderCase(*f));
+		cases.push_back(new BinaryElementCase(*f));
+		cases.push_back(new BinaryDataCase(*f));
+		cases.push_back(new DecodePlanCase(*f));
+		cases.push_back(new BinaryFrameCase(*f));
+		switch(layouts[i].mode) {
+			case MODE_JS:
+				cases.push_back(new ReorderCase(*f));
+				break;
+			case MODE_MOUSE:
+				cases.push_back(new MouseDataCase(*f));
+				break;
+			case MODE_ABSMOUSE:
+				cases.push_back(new TouchDataCase(*f));
+				break;
+			case MODE_SLIDE:
+				cases.push_back(new SlideDataCase(*f));
+				break;
+		}
+	}
+	vector<ElementBlock *> blocks;
+	for(int numElements = 8; numElements <= 64; numElements *= 2) {
+		ElementBlock *block = new ElementBlock(numElements);
+		blocks.push_back(block);
+		cases.push_back(new FieldSwapCase(*block));
+		for(int kernel = 0; kernel < SWAP_KERNELS; kernel++)
+			if(getSwapKernel(kernel))
+				cases.push_back(new SwapKernelCase(*block, kernel));
+		cases.push_back(new BinaryElementsCase(*block));
+	}
+
+	cases.push_back(new AccelToAxesCase);
+	cases.push_back(new ApplyGammaCase);
+
+	runAll(cases, options, "decode");
+
+	for(vector<BenchCase *>::iterator it = cases.begin(); it != cases.end(); it++)
+		delete *it;
+	for(vector<LayoutFrames *>::iterator it = frames.begin(); it != frames.end(); it++)
+		delete *it;
+	for(vector<ElementBlock *>::iterator it = blocks.begin(); it != blocks.end(); it++)
+		delete *it;
+	return 0;
+}
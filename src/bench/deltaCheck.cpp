@@ -0,0 +1,228 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Round trip check of DPD2 delta frames. Encodes generated frames, with
+// random layout changes, dropped frames and corruption, and checks that
+// the decoder either rebuilds each frame exactly or rejects it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <getopt.h>
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+#include "net/deltaFrame.hpp"
+#include "frameGenerator.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::decode;
+using namespace droidpad::sim;
+
+static const int modes[] = { MODE_JS, MODE_MOUSE, MODE_ABSMOUSE, MODE_SLIDE };
+#define NUM_MODES (sizeof(modes) / sizeof(int))
+
+static SimLayout randomLayout() {
+	SimLayout layout;
+	layout.mode = modes[rand() % NUM_MODES];
+	layout.accel = rand() % 4 != 0;
+	layout.gyro = rand() % 2;
+	layout.axes = rand() % 5;
+	layout.buttons = rand() % 32;
+	layout.contacts = rand() % 3;
+	layout.shape = SHAPE_SINE + rand() % 5;
+	return layout;
+}
+
+/**
+ * What decoding frame should give: sensors rounded to the delta resolution,
+ * and buttons reduced to whether they are pressed.
+ */
+static bool matches(const RawBinaryHeader &header, const vector<RawBinaryElement> &elems,
+		const RawBinaryHeader &decoded, const vector<RawBinaryElement> &decodedElems) {
+	if(decoded.flags != header.flags || decoded.numElements != header.numElements) return false;
+	if(decodedElems.size() != elems.size()) return false;
+	const float *sensors = &header.axis.ax, *decodedSensors = &decoded.axis.ax;
+	for(int i = 0; i < DELTA_SENSORS; i++) {
+		float diff = sensors[i] - decodedSensors[i];
+		if(diff > 0.5f / DELTA_SENSOR_SCALE || diff < -0.5f / DELTA_SENSOR_SCALE) return false;
+	}
+	for(size_t i = 0; i < elems.size(); i++) {
+		const RawBinaryElement &a = elems[i], &b = decodedElems[i];
+		if(a.flags != b.flags) return false;
+		bool button = (a.flags & ITEM_FLAG_BUTTON) && !(a.flags & (ITEM_FLAG_SLIDER | ITEM_FLAG_TRACKPAD));
+		if(button) {
+			if((a.raw.data1 != 0) != (b.raw.data1 != 0)) return false;
+		} else if(a.raw.data1 != b.raw.data1 || a.raw.data2 != b.raw.data2 || a.raw.data3 != b.raw.data3) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Checks the largest layout delta frames can carry, with every value as long
+ * as it can be, and that one element more is refused rather than sent with
+ * a wrapped length. Returns the number of failures.
+ */
+static int checkLimits() {
+	int failures = 0;
+	RawBinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	for(size_t count = DELTA_MAX_ELEMENTS; count <= DELTA_MAX_ELEMENTS + 1; count++) {
+		vector<RawBinaryElement> elems(count);
+		for(size_t i = 0; i < count; i++) {
+			memset(&elems[i], 0, sizeof(RawBinaryElement));
+			elems[i].flags = ITEM_FLAG_SLIDER | ITEM_FLAG_HAS_X_AXIS | ITEM_FLAG_HAS_Y_AXIS;
+			elems[i].raw.data1 = elems[i].raw.data2 = elems[i].raw.data3 = 0x80000000;
+		}
+		header.numElements = count;
+
+		DeltaEncoder encoder;
+		DeltaDecoder decoder;
+		string frame = "x";
+		bool encoded = encoder.Encode(header, elems, frame);
+		frame.erase(0, 1);
+		if(count <= DELTA_MAX_ELEMENTS) {
+			RawBinaryHeader decoded;
+			vector<RawBinaryElement> decodedElems;
+			if(!encoded || !decoder.Decode(frame.data(), frame.size(), decoded, decodedElems) ||
+					!matches(header, elems, decoded, decodedElems)) {
+				fprintf(stderr, "Largest layout (%lu elements, %lu bytes) didn't round trip\n",
+						(unsigned long)count, (unsigned long)frame.size());
+				failures++;
+			}
+		} else if(encoded || !frame.empty()) {
+			fprintf(stderr, "Layout of %lu elements was encoded\n", (unsigned long)count);
+			failures++;
+		} else {
+			// Once the layout fits again, it starts with a keyframe
+			elems.pop_back();
+			header.numElements = elems.size();
+			if(!encoder.Encode(header, elems, frame) ||
+					!(frame[offsetof(DeltaFrameHeader, flags)] & DELTA_FLAG_KEYFRAME)) {
+				fprintf(stderr, "No keyframe after a refused layout\n");
+				failures++;
+			}
+		}
+	}
+	return failures;
+}
+
+static void usage(const char *name) {
+	printf("Usage: %s [--iterations=N] [--seed=N]\n", name);
+	printf("Checks that DPD2 delta frames decode to what was encoded.\n");
+}
+
+int main(int argc, char **argv) {
+	long iterations = 200000;
+	unsigned int seed = 1;
+
+	static const struct option longOptions[] = {
+		{ "iterations",	required_argument,	NULL, 'n' },
+		{ "seed",	required_argument,	NULL, 's' },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int opt;
+	while((opt = getopt_long(argc, argv, "n:s:h", longOptions, NULL)) != -1) {
+		switch(opt) {
+			case 'n':
+				iterations = atol(optarg);
+				break;
+			case 's':
+				seed = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 1;
+		}
+	}
+	srand(seed);
+
+	int limitFailures = checkLimits();
+
+	DeltaEncoder encoder;
+	DeltaDecoder decoder;
+	FrameGenerator *gen = new FrameGenerator(randomLayout(), seed);
+	double t = 0;
+	// Whether the decoder should be able to follow the stream
+	bool inSync = true;
+
+	long frames = 0, mismatches = 0, rejected = 0, falseRejects = 0;
+	uint64_t fullBytes = 0, deltaBytes = 0;
+	for(long i = 0; i < iterations; i++) {
+		// Occasionally, the phone switches layout
+		if(rand() % 2000 == 0) {
+			delete gen;
+			gen = new FrameGenerator(randomLayout(), rand());
+			t = 0;
+		}
+		t += 1.0 / 60;
+		gen->Step(t);
+
+		RawBinaryHeader header = gen->Header();
+		const vector<RawBinaryElement> &elems = gen->Elements();
+		string frame;
+		encoder.Encode(header, elems, frame);
+		bool keyframe = frame[offsetof(DeltaFrameHeader, flags)] & DELTA_FLAG_KEYFRAME;
+		if(keyframe) inSync = true;
+		frames++;
+		fullBytes += sizeof(RawBinaryHeader) + elems.size() * sizeof(RawBinaryElement);
+		deltaBytes += frame.size();
+
+		// Lost frames and corruption should be caught, not decoded into garbage
+		int fault = rand() % 500;
+		if(fault == 0) {
+			inSync = false;
+			continue;
+		} else if(fault == 1 && frame.size() > sizeof(DeltaFrameHeader)) {
+			frame.erase(frame.size() - 1);
+		}
+
+		RawBinaryHeader decoded;
+		vector<RawBinaryElement> decodedElems;
+		if(!decoder.Decode(frame.data(), frame.size(), decoded, decodedElems)) {
+			rejected++;
+			if(inSync && fault != 1) {
+				if(falseRejects < 10) fprintf(stderr, "Frame %ld rejected\n", i);
+				falseRejects++;
+			}
+			inSync = false;
+			continue;
+		}
+		if(!inSync || !matches(header, elems, decoded, decodedElems)) {
+			if(mismatches < 10) fprintf(stderr, "Frame %ld decoded wrongly\n", i);
+			mismatches++;
+		}
+	}
+	delete gen;
+
+	printf("{\"suite\":\"deltacheck\",\"seed\":%u,\"frames\":%ld,\"mismatches\":%ld,"
+			"\"rejected\":%ld,\"false_rejects\":%ld,\"limit_failures\":%d,"
+			"\"full_bytes_per_frame\":%.1f,\"delta_bytes_per_frame\":%.1f}\n",
+			seed, frames, mismatches, rejected, falseRejects, limitFailures,
+			(double)fullBytes / frames, (double)deltaBytes / frames);
+	return mismatches == 0 && falseRejects == 0 && limitFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,335 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// End to end latency, from a simulated phone sending a frame to droidpad
+// outputting it. The phones run in a child process, one per mode, and stream
+// timestamped frames over loopback to the real MainThread, which connects,
+// decodes, filters and smooths them as it would for a real phone, then
+// sends them to the recording output manager. Each output frame carries the
+// phone's send time, moved onto the computer's clock by the usual clock
+// sync, so the latency measured includes any sync error (a few
+// microseconds over loopback). CPU time is that of this process, which only
+// runs droidpad's threads and a harness thread that sleeps between reads.
+
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <wx/init.h>
+#include <wx/socket.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include "types.hpp"
+#include "timing.hpp"
+#include "data.hpp"
+#include "events.hpp"
+#include "mainThread.hpp"
+#include "output/recordingOutputMgr.hpp"
+#include "simPhone.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::bench;
+using namespace droidpad::sim;
+
+// Frames sent per second by each phone
+#define E2E_RATE 250
+// Time from the first timestamped frame being output to measuring, so the
+// clock sync has settled
+#define E2E_WARMUP (1 * NANOS_PER_SEC)
+#define E2E_MEASURE (3 * NANOS_PER_SEC)
+// Time to wait for a connection to start or finish
+#define E2E_TIMEOUT (10 * NANOS_PER_SEC)
+// Time between reading the output ring
+#define E2E_POLL_MS 5
+
+static const struct {
+	int mode;
+	const char *name;
+} modes[] = {
+	{ MODE_JS, "js" },
+	{ MODE_MOUSE, "mouse" },
+	{ MODE_ABSMOUSE, "absmouse" },
+	{ MODE_SLIDE, "slide" },
+};
+#define NUM_MODES (sizeof(modes) / sizeof(modes[0]))
+
+static uint64_t processCpuNanos() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return ((uint64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * NANOS_PER_SEC +
+		((uint64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * NANOS_PER_MICRO;
+}
+
+/**
+ * Runs a phone for each mode, the one for modes[i] on basePort + 2i and the
+ * next port for secure connections, until quitFd is closed. Writes a byte to
+ * readyFd once they are listening. Never returns.
+ */
+static void runPhones(int basePort, const string &deviceId, const string &psk, int readyFd, int quitFd) {
+	signal(SIGPIPE, SIG_IGN);
+	SSL_library_init();
+	SSL_load_error_strings();
+
+	vector<SimSettings> settings(NUM_MODES);
+	for(size_t i = 0; i < NUM_MODES; i++) {
+		settings[i].layout.mode = modes[i].mode;
+		settings[i].rate = E2E_RATE;
+		settings[i].basePort = basePort;
+		settings[i].timestamps = true;
+		settings[i].secure = true;
+		settings[i].deviceId = deviceId;
+		settings[i].psk = psk;
+	}
+	SSL_CTX *tlsContext = SimPhone::CreateTlsContext(&settings[0]);
+	if(tlsContext == NULL) {
+		ERR_print_errors_fp(stderr);
+		_exit(1);
+	}
+	vector<SimPhone *> phones;
+	for(size_t i = 0; i < NUM_MODES; i++) {
+		phones.push_back(new SimPhone(settings[i], i, tlsContext));
+		if(!phones.back()->Start()) _exit(1);
+	}
+
+	char c = 0;
+	if(write(readyFd, &c, 1) != 1) _exit(1);
+	while(read(quitFd, &c, 1) > 0);
+
+	for(size_t i = 0; i < phones.size(); i++)
+		delete phones[i];
+	SSL_CTX_free(tlsContext);
+	_exit(0);
+}
+
+/**
+ * Stands in for the DeviceManager, noting what the MainThread reports.
+ */
+class Harness : public wxEvtHandler {
+	public:
+		Harness() : started(false), failed(false), finished(false) { }
+
+		bool started, failed, finished;
+
+		void OnStarted(DMEvent &event) { started = true; }
+		void OnError(DMEvent &event) { failed = true; }
+		void OnFinish(DMEvent &event) { finished = true; }
+
+		DECLARE_EVENT_TABLE()
+};
+
+BEGIN_EVENT_TABLE(Harness, wxEvtHandler)
+	EVT_DMEVENT(dpTHREAD_STARTED, Harness::OnStarted)
+	EVT_DMEVENT(dpTHREAD_ERROR, Harness::OnError)
+	EVT_DMEVENT(dpTHREAD_FINISH, Harness::OnFinish)
+END_EVENT_TABLE()
+
+class E2EResult {
+	public:
+		E2EResult() : frames(0), elapsed(0), cpu(0), error(NULL) { }
+
+		// Output time less send time of each frame, in ns
+		vector<int64_t> latencies;
+		// Frames output while measuring, counting each once however often
+		// the smoothing repeats it
+		uint64_t frames;
+		uint64_t elapsed, cpu;
+		const char *error;
+};
+
+/**
+ * Connects to the phone for device, and measures it for E2E_MEASURE.
+ */
+static E2EResult measure(AndroidDevice &device) {
+	E2EResult result;
+	OutputEventRing ring;
+	RecordingOutputManager::SetHarnessRing(&ring);
+
+	Harness harness;
+	// Deletes itself once finished
+	MainThread *thread = new MainThread(harness, device, NULL);
+	thread->Create();
+	thread->Run();
+
+	const uint64_t start = monotonicNanos();
+	uint64_t measureStart = 0, warmupEnd = 0, cpuStart = 0;
+	while(result.error == NULL) {
+		wxMilliSleep(E2E_POLL_MS);
+		harness.ProcessPendingEvents();
+		if(harness.failed || harness.finished) {
+			result.error = "connection failed";
+			break;
+		}
+		uint64_t now = monotonicNanos();
+
+		OutputEvent event;
+		while(ring.Pop(event)) {
+			// Only the first output of each frame; smoothing repeats it
+			// with value (firstIteration) false.
+			if(event.type != OUTPUT_EVENT_SYNC || !event.value || event.senderTime == 0) continue;
+			if(measureStart != 0) {
+				result.frames++;
+				result.latencies.push_back((int64_t)(event.time - event.senderTime));
+			} else if(warmupEnd == 0) {
+				warmupEnd = now + E2E_WARMUP;
+			}
+		}
+
+		if(measureStart == 0) {
+			if(warmupEnd != 0 && now >= warmupEnd) {
+				measureStart = now;
+				cpuStart = processCpuNanos();
+			} else if(now - start > E2E_TIMEOUT) {
+				result.error = "no timestamped frames output";
+			}
+		} else if(now - measureStart >= E2E_MEASURE) {
+			result.elapsed = now - measureStart;
+			result.cpu = processCpuNanos() - cpuStart;
+			break;
+		}
+	}
+
+	thread->stop();
+	const uint64_t stopped = monotonicNanos();
+	while(!harness.finished && monotonicNanos() - stopped < E2E_TIMEOUT) {
+		wxMilliSleep(E2E_POLL_MS);
+		harness.ProcessPendingEvents();
+		ring.Clear();
+	}
+	if(!harness.finished) {
+		fprintf(stderr, "e2ebench: connection didn't stop\n");
+		exit(1);
+	}
+	// The output manager has been deleted by now
+	RecordingOutputManager::SetHarnessRing(NULL);
+	return result;
+}
+
+static void report(const char *bench, const char *layout, E2EResult &result, const BenchOptions &options) {
+	printf("{\"suite\":\"e2e\",\"bench\":\"%s\",\"layout\":\"%s\"", bench, layout);
+	if(result.error != NULL || result.latencies.empty()) {
+		printf(",\"error\":\"%s\"", result.error ? result.error : "no frames");
+	} else {
+		vector<int64_t> &latencies = result.latencies;
+		sort(latencies.begin(), latencies.end());
+		size_t n = latencies.size();
+		printf(",\"frames\":%lu,\"p50_ns\":%lld,\"p90_ns\":%lld,\"p99_ns\":%lld,\"max_ns\":%lld"
+				",\"frames_per_sec\":%.1f,\"cpu_ns_per_frame\":%.0f",
+				(unsigned long)n,
+				(long long)latencies[n / 2],
+				(long long)latencies[n * 9 / 10],
+				(long long)latencies[n * 99 / 100],
+				(long long)latencies[n - 1],
+				(double)result.frames * NANOS_PER_SEC / result.elapsed,
+				(double)result.cpu / result.frames);
+	}
+	if(!options.commit.empty()) printf(",\"commit\":\"%s\"", options.commit.c_str());
+	printf("}\n");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	if(!options.Parse(argc, argv, "Latency from a simulated phone through droidpad to the output."))
+		return 0;
+
+	// Pairing and connecting save preferences, so keep them out of the
+	// user's own.
+	char home[] = "/tmp/e2ebench.XXXXXX";
+	if(mkdtemp(home) == NULL) {
+		perror("e2ebench: mkdtemp");
+		return 1;
+	}
+	setenv("HOME", home, 1);
+
+	// The library prints progress to cout; keep stdout for results
+	cout.rdbuf(cerr.rdbuf());
+	wxInitializer wx;
+	if(!wx.IsOk() || !Data::initialise()) {
+		fprintf(stderr, "e2ebench: couldn't initialise (run from the source tree)\n");
+		return 1;
+	}
+	Data::recordOutput = true;
+	Credentials credentials = CredentialStore::createNewSet();
+
+	// Phones are started before any threads, so the fork is safe
+	int basePort = 20000 + getpid() % 10000 * 2;
+	int ready[2], quit[2];
+	if(pipe(ready) != 0 || pipe(quit) != 0) {
+		perror("e2ebench: pipe");
+		return 1;
+	}
+	pid_t phones = fork();
+	if(phones < 0) {
+		perror("e2ebench: fork");
+		return 1;
+	}
+	if(phones == 0) {
+		close(ready[0]);
+		close(quit[1]);
+		runPhones(basePort, credentials.deviceIdString(), credentials.psk, ready[1], quit[0]);
+	}
+	close(ready[1]);
+	close(quit[0]);
+	char c;
+	if(read(ready[0], &c, 1) != 1) {
+		fprintf(stderr, "e2ebench: simulated phones didn't start\n");
+		return 1;
+	}
+	wxSocketBase::Initialize();
+
+	for(size_t i = 0; i < NUM_MODES; i++) {
+		for(int secure = 0; secure < 2; secure++) {
+			const char *bench = secure ? "tls" : "plain";
+			if(!options.filter.empty() && string(bench).find(options.filter) == string::npos &&
+					string(modes[i].name).find(options.filter) == string::npos)
+				continue;
+
+			AndroidDevice device;
+			device.type = DEVICE_NET;
+			device.ip = wxT("127.0.0.1");
+			device.port = basePort + 2 * i;
+			device.securePort = device.port + 1;
+			device.name = wxT("e2ebench");
+			device.secureSupported = secure;
+			E2EResult result = measure(device);
+			report(bench, modes[i].name, result, options);
+		}
+	}
+
+	close(quit[1]);
+	waitpid(phones, NULL, 0);
+	unlink((string(home) + "/.droidpad").c_str());
+	rmdir(home);
+	return 0;
+}
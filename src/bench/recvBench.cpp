@@ -0,0 +1,296 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Cost of receiving from many phones at once, as at parties and arcades. A
+// sender thread plays each phone, sending a DPAD frame on every loopback TCP
+// connection 200 times a second. The frames are received and decoded with a
+// blocking thread per connection, as droidpad does, and with one thread
+// running a ReceiveLoop, with epoll and, where the kernel has it, io_uring.
+// Reported is the CPU time the receiving threads spent on each frame.
+
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <string>
+#include <vector>
+
+#include "timing.hpp"
+#include "net/protocol.hpp"
+#include "net/dataDecode.hpp"
+#include "net/receiveLoop.hpp"
+#include "frameGenerator.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::bench;
+using namespace droidpad::decode;
+using namespace droidpad::sim;
+
+#define FRAME_INTERVAL (5 * NANOS_PER_MILLI)
+#define FRAMES_PER_CONNECTION 400
+
+static const int connectionCounts[] = { 32, 128 };
+#define NUM_CONNECTION_COUNTS (sizeof(connectionCounts) / sizeof(int))
+
+static uint64_t threadCpuNanos() {
+	struct rusage usage;
+	getrusage(RUSAGE_THREAD, &usage);
+	return ((uint64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * NANOS_PER_SEC +
+		((uint64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * NANOS_PER_MICRO;
+}
+
+/**
+ * Decodes the frames arriving on one connection.
+ */
+class FrameSink : public ReceiveSink {
+	public:
+		FrameSink() : frames(0), closed(false) { }
+
+		void Received(const char *data, size_t length) {
+			pending.append(data, length);
+			size_t pos = 0;
+			while(pending.size() - pos >= sizeof(RawBinaryHeader)) {
+				RawBinaryHeader header = getBinaryHeader(pending.data() + pos);
+				size_t size = sizeof(RawBinaryHeader) + header.numElements * sizeof(RawBinaryElement);
+				if(pending.size() - pos < size) break;
+				plan.Decode(header, getBinaryElements(pending.data() + pos + sizeof(RawBinaryHeader),
+							header.numElements), frame);
+				pos += size;
+				frames++;
+			}
+			pending.erase(0, pos);
+		}
+
+		void Closed() {
+			closed = true;
+		}
+
+		long frames;
+		bool closed;
+
+	private:
+		string pending;
+		DecodePlan plan;
+		DPJSData frame;
+};
+
+/**
+ * The phones' ends of the connections, and the frame they send.
+ */
+struct Phones {
+	vector<int> fds;
+	string frame;
+};
+
+static void *sendFrames(void *arg) {
+	Phones *phones = (Phones *)arg;
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for(int i = 0; i < FRAMES_PER_CONNECTION; i++) {
+		next.tv_nsec += FRAME_INTERVAL;
+		if(next.tv_nsec >= (long)NANOS_PER_SEC) {
+			next.tv_nsec -= NANOS_PER_SEC;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		for(size_t c = 0; c < phones->fds.size(); c++)
+			send(phones->fds[c], phones->frame.data(), phones->frame.size(), MSG_NOSIGNAL);
+	}
+	// Closing tells the receivers they have everything
+	for(size_t c = 0; c < phones->fds.size(); c++)
+		shutdown(phones->fds[c], SHUT_WR);
+	return NULL;
+}
+
+/**
+ * Makes count loopback connections, giving the receiving ends in fds and
+ * the phones' ends in phones.
+ */
+static bool connectPhones(int count, vector<int> &fds, Phones &phones) {
+	int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	if(listenFd < 0 ||
+			bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+			listen(listenFd, count) < 0 ||
+			getsockname(listenFd, (struct sockaddr *)&addr, &len) < 0) {
+		perror("recvbench: listen");
+		if(listenFd >= 0) close(listenFd);
+		return false;
+	}
+	for(int i = 0; i < count; i++) {
+		int phone = socket(AF_INET, SOCK_STREAM, 0);
+		if(phone < 0 || connect(phone, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			perror("recvbench: connect");
+			close(listenFd);
+			return false;
+		}
+		int one = 1;
+		setsockopt(phone, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		phones.fds.push_back(phone);
+		fds.push_back(accept(listenFd, NULL, NULL));
+	}
+	close(listenFd);
+	return true;
+}
+
+struct ThreadArgs {
+	int fd;
+	FrameSink sink;
+	uint64_t cpuNanos;
+};
+
+static void *receiveBlocking(void *arg) {
+	ThreadArgs *args = (ThreadArgs *)arg;
+	uint64_t start = threadCpuNanos();
+	char buffer[RECEIVE_BUFFER_SIZE];
+	int length;
+	while((length = recv(args->fd, buffer, sizeof(buffer), 0)) > 0)
+		args->sink.Received(buffer, length);
+	args->cpuNanos = threadCpuNanos() - start;
+	return NULL;
+}
+
+enum {
+	BACKEND_THREADS,
+	BACKEND_EPOLL,
+	BACKEND_URING,
+};
+
+/**
+ * Receives everything the phones send. Returns the frames received, and
+ * the receiving threads' CPU time in cpuNanos, or -1 on failure.
+ */
+static long receive(int backend, const vector<int> &fds, uint64_t &cpuNanos) {
+	long frames = 0;
+	cpuNanos = 0;
+	if(backend == BACKEND_THREADS) {
+		vector<ThreadArgs> args(fds.size());
+		vector<pthread_t> threads(fds.size());
+		for(size_t i = 0; i < fds.size(); i++) {
+			args[i].fd = fds[i];
+			pthread_create(&threads[i], NULL, receiveBlocking, &args[i]);
+		}
+		for(size_t i = 0; i < fds.size(); i++) {
+			pthread_join(threads[i], NULL);
+			frames += args[i].sink.frames;
+			cpuNanos += args[i].cpuNanos;
+		}
+		return frames;
+	}
+
+	ReceiveLoop *loop;
+	if(backend == BACKEND_URING) {
+		UringReceiveLoop *uring = new UringReceiveLoop;
+		if(!uring->IsOpen()) {
+			delete uring;
+			return -1;
+		}
+		loop = uring;
+	} else
+		loop = new EpollReceiveLoop;
+
+	vector<FrameSink> sinks(fds.size());
+	for(size_t i = 0; i < fds.size(); i++)
+		loop->Add(fds[i], &sinks[i]);
+	uint64_t start = threadCpuNanos();
+	// Give up well after the phones should have finished
+	uint64_t deadline = monotonicNanos() + 10 * (uint64_t)FRAMES_PER_CONNECTION * FRAME_INTERVAL;
+	size_t open = fds.size();
+	while(open > 0 && monotonicNanos() < deadline) {
+		if(loop->Poll(1000) < 0) break;
+		open = 0;
+		for(size_t i = 0; i < sinks.size(); i++)
+			if(!sinks[i].closed) open++;
+	}
+	cpuNanos = threadCpuNanos() - start;
+	delete loop;
+	for(size_t i = 0; i < sinks.size(); i++)
+		frames += sinks[i].frames;
+	return open == 0 ? frames : -1;
+}
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	if(!options.Parse(argc, argv, "CPU time spent receiving frames from many phones at once."))
+		return 0;
+
+	SimLayout layout;
+	layout.mode = MODE_JS;
+	layout.accel = true;
+	layout.axes = 4;
+	layout.buttons = 12;
+	FrameGenerator generator(layout, 1);
+	generator.Step(0.5);
+	string frame = generator.BinaryFrame();
+
+	const char *backends[] = { "threads", "epoll", "io_uring" };
+	for(size_t c = 0; c < NUM_CONNECTION_COUNTS; c++) {
+		char layoutName[32];
+		snprintf(layoutName, sizeof(layoutName), "js-%dphones", connectionCounts[c]);
+		for(int backend = 0; backend < 3; backend++) {
+			if(!options.filter.empty() && string(backends[backend]).find(options.filter) == string::npos &&
+					string(layoutName).find(options.filter) == string::npos)
+				continue;
+
+			vector<int> fds;
+			Phones phones;
+			phones.frame = frame;
+			if(!connectPhones(connectionCounts[c], fds, phones)) return 1;
+			pthread_t sender;
+			pthread_create(&sender, NULL, sendFrames, &phones);
+			uint64_t cpuNanos;
+			long frames = receive(backend, fds, cpuNanos);
+			pthread_join(sender, NULL);
+			for(size_t i = 0; i < fds.size(); i++) {
+				close(fds[i]);
+				close(phones.fds[i]);
+			}
+
+			printf("{\"suite\":\"recv\",\"bench\":\"%s\",\"layout\":\"%s\"", backends[backend], layoutName);
+			if(frames < 0 && backend == BACKEND_URING)
+				printf(",\"skipped\":\"io_uring multishot receive unavailable\"");
+			else if(frames != (long)connectionCounts[c] * FRAMES_PER_CONNECTION) {
+				fprintf(stderr, "recvbench: %s received %ld frames\n", backends[backend], frames);
+				return 1;
+			} else
+				printf(",\"frames\":%ld,\"cpu_ns_per_frame\":%.0f", frames, (double)cpuNanos / frames);
+			if(!options.commit.empty()) printf(",\"commit\":\"%s\"", options.commit.c_str());
+			printf("}\n");
+			fflush(stdout);
+		}
+	}
+	return 0;
+}
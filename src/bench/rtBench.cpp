@@ -0,0 +1,234 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Latency of frames arriving at the input thread on a busy computer, with
+// and without the low latency mode of droidpad --realtime, and with busy
+// polling (the busyPoll preference). A sender thread
+// stands in for the phone, sending timestamped frames over loopback UDP,
+// while a thread per CPU keeps every core busy. The receiving thread reports
+// how long each frame took to reach it. The real-time case is skipped if the
+// thread can't be given real-time priority (usually needs root, or
+// CAP_SYS_NICE). Busy polling also reports the share of frames caught while
+// spinning and the CPU spent on it, and is skipped with only one CPU.
+
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "timing.hpp"
+#include "realtime.hpp"
+#include "net/busyPoll.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::bench;
+
+#define FRAMES 5000
+#define FRAME_INTERVAL NANOS_PER_MILLI
+// Priority and CPU used by the real-time case
+#define BENCH_PRIORITY 50
+#define BENCH_CPU 0
+// Spin used by the busy poll case; longer than FRAME_INTERVAL, so it never sleeps
+#define BENCH_BUSY_POLL 1500
+// Memory each load thread churns through, to disturb the caches as well
+#define LOAD_BYTES (256 * 1024)
+
+static volatile bool loadRunning;
+
+static void *loadThread(void *) {
+	vector<char> memory(LOAD_BYTES);
+	unsigned int i = 0;
+	while(loadRunning) {
+		for(size_t j = 0; j < memory.size(); j += 64)
+			memory[j] += i;
+		i++;
+	}
+	sink((int64_t)memory[0]);
+	return NULL;
+}
+
+struct SenderArgs {
+	int sock;
+	struct sockaddr_in dest;
+};
+
+static void *senderThread(void *arg) {
+	SenderArgs *args = (SenderArgs *)arg;
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for(int i = 0; i < FRAMES; i++) {
+		next.tv_nsec += FRAME_INTERVAL;
+		if(next.tv_nsec >= (long)NANOS_PER_SEC) {
+			next.tv_nsec -= NANOS_PER_SEC;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		uint64_t now = monotonicNanos();
+		sendto(args->sock, &now, sizeof(now), 0, (struct sockaddr *)&args->dest, sizeof(args->dest));
+	}
+	return NULL;
+}
+
+/**
+ * Receives FRAMES frames on the calling thread, returning their latencies.
+ * Returns an empty vector on failure. If poller is given, frames are waited
+ * for with it.
+ */
+static vector<uint64_t> measure(BusyPoller *poller) {
+	vector<uint64_t> latencies;
+	latencies.reserve(FRAMES);
+
+	int recvSock = socket(AF_INET, SOCK_DGRAM, 0);
+	int sendSock = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addrLen = sizeof(addr);
+	if(recvSock < 0 || sendSock < 0 ||
+			bind(recvSock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+			getsockname(recvSock, (struct sockaddr *)&addr, &addrLen) != 0) {
+		perror("rtbench: socket");
+		if(recvSock >= 0) close(recvSock);
+		if(sendSock >= 0) close(sendSock);
+		return latencies;
+	}
+	// Frames don't arrive more than a second apart unless something is wrong
+	struct timeval timeout = { 1, 0 };
+	setsockopt(recvSock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	if(poller != NULL && !poller->Attach(recvSock, BENCH_BUSY_POLL)) {
+		fprintf(stderr, "rtbench: busy polling unavailable\n");
+		poller = NULL;
+	}
+
+	SenderArgs args;
+	args.sock = sendSock;
+	args.dest = addr;
+	pthread_t sender;
+	pthread_create(&sender, NULL, senderThread, &args);
+
+	for(int i = 0; i < FRAMES; i++) {
+		uint64_t sent;
+		if(poller != NULL && !poller->Wait(1000)) break;
+		if(recv(recvSock, &sent, sizeof(sent), 0) != sizeof(sent)) break;
+		latencies.push_back(monotonicNanos() - sent);
+	}
+
+	pthread_join(sender, NULL);
+	if(poller != NULL) poller->Detach();
+	close(recvSock);
+	close(sendSock);
+	return latencies;
+}
+
+static void report(const char *layout, vector<uint64_t> latencies, const BusyPoller *poller,
+		uint64_t elapsed, const BenchOptions &options, const char *skipped) {
+	printf("{\"suite\":\"realtime\",\"bench\":\"loopback_latency\",\"layout\":\"%s\"", layout);
+	if(skipped != NULL) {
+		printf(",\"skipped\":\"%s\"", skipped);
+	} else {
+		sort(latencies.begin(), latencies.end());
+		size_t n = latencies.size();
+		printf(",\"frames\":%lu,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu",
+				(unsigned long)n,
+				(unsigned long long)latencies[n / 2],
+				(unsigned long long)latencies[n * 99 / 100],
+				(unsigned long long)latencies[n * 999 / 1000],
+				(unsigned long long)latencies[n - 1]);
+		if(poller != NULL) {
+			const BusyPollStats &stats = poller->GetStats();
+			printf(",\"spin_hit_pct\":%.1f,\"spin_cpu_pct\":%.1f",
+					stats.waits > 0 ? (double)stats.spinHits * 100 / stats.waits : 0.0,
+					(double)stats.spinNanos * 100 / elapsed);
+		}
+	}
+	if(!options.commit.empty()) printf(",\"commit\":\"%s\"", options.commit.c_str());
+	printf("}\n");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	if(!options.Parse(argc, argv, "Latency of loopback frames on a loaded computer, with and without real-time scheduling."))
+		return 0;
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if(cpus < 1) cpus = 1;
+	loadRunning = true;
+	vector<pthread_t> load(cpus);
+	for(long i = 0; i < cpus; i++)
+		pthread_create(&load[i], NULL, loadThread, NULL);
+
+	// Real-time cases go last, as memory stays locked afterwards
+	const char *layouts[] = { "default", "busy-poll", "realtime", "realtime+busy-poll" };
+	bool realtimeSet = false, realtimeFailed = false;
+	for(int i = 0; i < 4; i++) {
+		bool busyPoll = i == 1 || i == 3;
+		if(!options.filter.empty() && string("loopback_latency").find(options.filter) == string::npos &&
+				string(layouts[i]).find(options.filter) == string::npos)
+			continue;
+		if(busyPoll && cpus < 2) {
+			// The spinning thread would starve the sender
+			report(layouts[i], vector<uint64_t>(), NULL, 0, options, "busy polling needs a spare CPU");
+			continue;
+		}
+		if(i >= 2 && !realtimeSet && !realtimeFailed) {
+			realtimeSet = realtime::setPriority(BENCH_PRIORITY);
+			realtimeFailed = !realtimeSet;
+			if(realtimeSet) {
+				realtime::setAffinity(BENCH_CPU);
+				if(!realtime::lockMemory())
+					fprintf(stderr, "rtbench: couldn't lock memory\n");
+			}
+		}
+		if(i >= 2 && realtimeFailed) {
+			report(layouts[i], vector<uint64_t>(), NULL, 0, options, "real-time priority unavailable");
+			continue;
+		}
+		BusyPoller poller;
+		uint64_t start = monotonicNanos();
+		vector<uint64_t> latencies = measure(busyPoll ? &poller : NULL);
+		uint64_t elapsed = monotonicNanos() - start;
+		if(latencies.empty()) {
+			loadRunning = false;
+			return 1;
+		}
+		report(layouts[i], latencies, busyPoll ? &poller : NULL, elapsed, options, NULL);
+	}
+
+	loadRunning = false;
+	for(long i = 0; i < cpus; i++)
+		pthread_join(load[i], NULL);
+	return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Cost of publishing frames to the shared memory output and of reading them
+// back with libdpshm, and how long a reader polling the segment takes to see
+// each frame. The publisher changes every axis together, so the reader also
+// checks that it never sees a frame half written.
+
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "timing.hpp"
+#include "types.hpp"
+#include "net/dataDecode.hpp"
+#include "output/shmOutputMgr.hpp"
+#include "shm/dpshm.h"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::bench;
+using namespace droidpad::decode;
+
+#define BENCH_AXES 6
+#define BENCH_BUTTONS 12
+
+#define LATENCY_FRAMES 5000
+#define LATENCY_INTERVAL (200 * NANOS_PER_MICRO)
+
+static DPJSData benchFrame(int value) {
+	DPJSData data;
+	data.axes.assign(BENCH_AXES, value);
+	data.buttons.assign(BENCH_BUTTONS, value & 1);
+	return data;
+}
+
+class PublishCase : public BenchCase {
+	public:
+		PublishCase(SharedMemoryOutputManager &mgr) : BenchCase("SendJSData", "shm-js-6a-12b"), mgr(mgr) { }
+		void Run(long iterations) {
+			DPJSData data = benchFrame(0);
+			for(long i = 0; i < iterations; i++) {
+				data.axes[0] = i;
+				mgr.SendJSData(data);
+			}
+		}
+	private:
+		SharedMemoryOutputManager &mgr;
+};
+
+class ReadCase : public BenchCase {
+	public:
+		ReadCase(const dpshm_reader &reader) : BenchCase("dpshm_read", "js-6a-12b"), reader(reader) { }
+		void Run(long iterations) {
+			dpshm_state state;
+			for(long i = 0; i < iterations; i++) {
+				dpshm_read(&reader, &state);
+				sink((int64_t)state.axes[0]);
+			}
+		}
+	private:
+		const dpshm_reader &reader;
+};
+
+static void *publishFrames(void *arg) {
+	SharedMemoryOutputManager *mgr = (SharedMemoryOutputManager *)arg;
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for(int i = 1; i <= LATENCY_FRAMES; i++) {
+		next.tv_nsec += LATENCY_INTERVAL;
+		if(next.tv_nsec >= (long)NANOS_PER_SEC) {
+			next.tv_nsec -= NANOS_PER_SEC;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		mgr->SendJSData(benchFrame(i));
+	}
+	return NULL;
+}
+
+/**
+ * Polls the segment while frames are published, recording how long after
+ * publishing each one was seen. Frames which are replaced before being seen
+ * are missed. Returns the number of inconsistent reads in torn.
+ */
+static vector<uint64_t> pollLatency(SharedMemoryOutputManager &mgr, const dpshm_reader &reader, long &torn) {
+	// With one CPU, the publisher only runs when the reader gives way
+	bool yield = sysconf(_SC_NPROCESSORS_ONLN) < 2;
+	vector<uint64_t> latencies;
+	latencies.reserve(LATENCY_FRAMES);
+	torn = 0;
+
+	dpshm_state state;
+	dpshm_read(&reader, &state);
+	uint64_t lastFrame = state.frame;
+	pthread_t publisher;
+	pthread_create(&publisher, NULL, publishFrames, &mgr);
+	for(;;) {
+		if(dpshm_read(&reader, &state) != 0) break;
+		if(state.frame != lastFrame) {
+			latencies.push_back(monotonicNanos() - state.time);
+			lastFrame = state.frame;
+			for(int i = 1; i < state.numAxes; i++)
+				if(state.axes[i] != state.axes[0]) torn++;
+			if(state.axes[0] == LATENCY_FRAMES) break;
+		}
+		if(yield) sched_yield();
+	}
+	pthread_join(publisher, NULL);
+	return latencies;
+}
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	if(!options.Parse(argc, argv, "Publishing and reading frames through the shared memory output."))
+		return 0;
+
+	char session[32];
+	snprintf(session, sizeof(session), "shmbench-%d", (int)getpid());
+	SharedMemoryOutputManager mgr(MODE_JS, BENCH_AXES, BENCH_BUTTONS, session, NULL);
+	dpshm_reader reader;
+	if(!mgr.IsPublishing() || dpshm_open(&reader, session) != 0) {
+		fprintf(stderr, "shmbench: couldn't create a shared memory segment\n");
+		return 1;
+	}
+
+	vector<BenchCase *> cases;
+	cases.push_back(new PublishCase(mgr));
+	cases.push_back(new ReadCase(reader));
+	runAll(cases, options, "shm");
+	for(size_t i = 0; i < cases.size(); i++)
+		delete cases[i];
+
+	if(options.filter.empty() || string("poll_latency").find(options.filter) != string::npos) {
+		long torn;
+		vector<uint64_t> latencies = pollLatency(mgr, reader, torn);
+		sort(latencies.begin(), latencies.end());
+		size_t n = latencies.size();
+		printf("{\"suite\":\"shm\",\"bench\":\"poll_latency\",\"layout\":\"js-6a-12b\"");
+		if(n > 0)
+			printf(",\"frames\":%lu,\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu,\"torn\":%ld",
+					(unsigned long)n,
+					(unsigned long long)latencies[n / 2],
+					(unsigned long long)latencies[n * 99 / 100],
+					(unsigned long long)latencies[n - 1], torn);
+		if(!options.commit.empty()) printf(",\"commit\":\"%s\"", options.commit.c_str());
+		printf("}\n");
+		if(torn > 0) {
+			fprintf(stderr, "shmbench: %ld reads saw a frame half written\n", torn);
+			return 1;
+		}
+	}
+
+	dpshm_close(&reader);
+	return 0;
+}
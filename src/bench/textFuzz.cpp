@@ -0,0 +1,164 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Differential check of the text protocol parser. Feeds generated frames,
+// and random mutations of them, to both getTextData and the original
+// getTextDataReference, and reports any line they disagree on.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <string>
+#include <vector>
+
+#include <wx/string.h>
+
+#include "types.hpp"
+#include "net/dataDecode.hpp"
+#include "frameGenerator.hpp"
+#include "textReference.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::bench;
+using namespace droidpad::decode;
+using namespace droidpad::sim;
+
+// Characters which mean something to the parser, plus a few that don't
+static const char mutationChars[] = "[]{};,ACST0123456789.-+e <>";
+
+static const int modes[] = { MODE_JS, MODE_MOUSE, MODE_ABSMOUSE, MODE_SLIDE };
+#define NUM_MODES (sizeof(modes) / sizeof(int))
+
+/**
+ * Lines as real phones send them, across modes, layouts and times.
+ */
+static void buildCorpus(vector<string> &corpus, unsigned int seed) {
+	for(size_t m = 0; m < NUM_MODES; m++) {
+		for(int axes = 0; axes <= 4; axes += 2) {
+			for(int buttons = 0; buttons <= 12; buttons += 4) {
+				SimLayout layout;
+				layout.mode = modes[m];
+				layout.accel = axes != 2;
+				layout.gyro = buttons == 4;
+				layout.axes = axes;
+				layout.buttons = buttons;
+				layout.shape = SHAPE_RANDOM;
+				FrameGenerator gen(layout, seed++);
+				for(int i = 0; i < 8; i++) {
+					gen.Step(i / 7.0);
+					string line = gen.TextFrame();
+					corpus.push_back(line.substr(0, line.size() - 1));
+				}
+			}
+		}
+	}
+	corpus.push_back("");
+	corpus.push_back("<STOP>");
+	corpus.push_back("[]");
+	corpus.push_back("[;;]");
+	corpus.push_back("[{1.5e3,-0,+7};{A 99999999999,-99999999999};{T ,};{C};1;0;]");
+}
+
+static string mutate(const string &line) {
+	string ret = line;
+	int count = 1 + rand() % 4;
+	for(int i = 0; i < count; i++) {
+		size_t pos = ret.empty() ? 0 : rand() % (ret.size() + 1);
+		char c = mutationChars[rand() % (sizeof(mutationChars) - 1)];
+		switch(rand() % 3) {
+			case 0:
+				ret.insert(pos, 1, c);
+				break;
+			case 1:
+				if(pos < ret.size()) ret.erase(pos, 1);
+				break;
+			case 2:
+				if(pos < ret.size()) ret[pos] = c;
+				break;
+		}
+	}
+	return ret;
+}
+
+static bool sameData(const DPJSData &a, const DPJSData &b) {
+	return a.axes == b.axes &&
+		a.touchpadAxes == b.touchpadAxes &&
+		a.buttons == b.buttons &&
+		a.connectionClosed == b.connectionClosed &&
+		a.containsAccel == b.containsAccel &&
+		a.containsGyro == b.containsGyro &&
+		a.reset == b.reset;
+}
+
+static void usage(const char *name) {
+	printf("Usage: %s [--iterations=N] [--seed=N]\n", name);
+	printf("Checks getTextData against the original parser.\n");
+}
+
+int main(int argc, char **argv) {
+	long iterations = 1000000;
+	unsigned int seed = 1;
+
+	static const struct option longOptions[] = {
+		{ "iterations",	required_argument,	NULL, 'n' },
+		{ "seed",	required_argument,	NULL, 's' },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int opt;
+	while((opt = getopt_long(argc, argv, "n:s:h", longOptions, NULL)) != -1) {
+		switch(opt) {
+			case 'n':
+				iterations = atol(optarg);
+				break;
+			case 's':
+				seed = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 1;
+		}
+	}
+	srand(seed);
+
+	vector<string> corpus;
+	buildCorpus(corpus, seed);
+
+	long checked = 0, mismatches = 0;
+	for(long i = 0; i < iterations; i++) {
+		const string &base = corpus[i % corpus.size()];
+		// Check each line unchanged once, then mutated
+		string line = i < (long)corpus.size() ? base : mutate(base);
+		DPJSData fast = getTextData(line.data(), line.size());
+		DPJSData reference = getTextDataReference(wxString(line.c_str(), wxConvUTF8));
+		checked++;
+		if(!sameData(fast, reference)) {
+			if(mismatches < 10) fprintf(stderr, "Mismatch: %s\n", line.c_str());
+			mismatches++;
+		}
+	}
+
+	printf("{\"suite\":\"textfuzz\",\"seed\":%u,\"lines\":%ld,\"mismatches\":%ld}\n",
+			seed, checked, mismatches);
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The original text protocol parser, from before getTextData. Slow, but
+// kept to check the fast one against and to compare their speeds.
+
+#include "textReference.hpp"
+
+#include <sstream>
+#include <locale>
+#include <wx/tokenzr.h>
+
+#include "types.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::decode;
+
+const DPJSData droidpad::bench::getTextDataReference(wxString line) {
+	DPJSData data;
+
+	if(line.find(wxT("<STOP>")) != wxNOT_FOUND) {
+		data.connectionClosed = true;
+		return data;
+	} else data.connectionClosed = false;
+
+	int start = line.Find(wxT("[")) + 1;
+	int end = line.Find(wxT("]"));
+
+	locale cLocale("C");
+
+	wxStringTokenizer tk(line(start, end - start), wxT(";"));
+	while(tk.HasMoreTokens()) {
+		wxString t = tk.GetNextToken();
+		start = 2;
+		end = t.Find(wxT("}"));
+		int pos;
+		wxStringTokenizer valTk;
+		if(t.StartsWith(wxT("{"))) { // Axis of some sort
+
+			switch(t[1]) {
+				case 'A': // 2way axis
+				case 'S': // 1way axis
+					if(end < start) break; // Malformed?
+					// cout << t(start, end - start).mb_str() << endl;
+					valTk = wxStringTokenizer(t(start, end - start), wxT(","));
+
+					while(valTk.HasMoreTokens()) {
+						{
+							int value = 0;
+							istringstream inNum(string(valTk.GetNextToken().mb_str()));
+							inNum.imbue(cLocale);
+							inNum >> value;
+							data.axes.push_back(value);
+						}
+					}
+
+					break;
+				case 'C': // 1way touchpad
+				case 'T': // 2way touchpad
+					if(end < start) break; // Malformed?
+					// cout << t(start, end - start).mb_str() << endl;
+					valTk = wxStringTokenizer(t(start, end - start), wxT(","));
+
+					pos = 0;
+					while(valTk.HasMoreTokens()) {
+						{
+							int value = 0;
+							istringstream inNum(string(valTk.GetNextToken().mb_str()));
+							inNum.imbue(cLocale);
+							inNum >> value;
+							if(pos == 1) // 'y' axis on 2way pad
+								value = -value;
+							data.touchpadAxes.push_back(value);
+						}
+						pos++;
+					}
+
+					break;
+				default: // Must be a raw JS
+					start = 1;
+					if(end < start) break; // Malformed?
+					valTk = wxStringTokenizer(t(start, end - start), wxT(","));
+					if(valTk.CountTokens() == 3) { // Else something wrong / malformed
+						int i = 0;
+						float x = 0, y = 0, z = 0;
+						while(valTk.HasMoreTokens()) {
+							{
+								float value;
+								istringstream inNum(string(valTk.GetNextToken().mb_str()));
+								inNum.imbue(cLocale);
+								switch(i) {
+									case 0: inNum >> x; break;
+									case 1: inNum >> y; break;
+									case 2: inNum >> z; break;
+								}
+								i++;
+							}
+						}
+						Vec2 a = accelToAxes(x, y, z);
+
+						data.axes.push_back(a.x);
+						data.axes.push_back(a.y);
+						data.containsAccel = true;
+					}
+					break;
+			}
+		}
+		else { // Must be a button.
+			data.buttons.push_back(t == wxT("1"));
+		}
+	}
+
+	return data;
+}
@@ -0,0 +1,37 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_TEXT_REFERENCE_H
+#define DP_TEXT_REFERENCE_H
+
+#include <wx/string.h>
+
+#include "net/dataDecode.hpp"
+
+namespace droidpad {
+	namespace bench {
+		/**
+		 * The original wx based text parser, which getTextData must agree
+		 * with.
+		 */
+		const decode::DPJSData getTextDataReference(wxString line);
+	}
+}
+
+#endif
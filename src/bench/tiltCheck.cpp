@@ -0,0 +1,123 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Behaviour check of the tilt filter. A real rotation, seen by both the gyro
+// and the accelerometer, should be followed at once; a change seen only by
+// the accelerometer, as its noise or drift in the gyro would be, should be
+// followed with TILT_FILTER_TIME_CONSTANT. Frames without a gyro should be
+// passed through untouched.
+
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+
+#include <vector>
+
+#include "types.hpp"
+#include "timing.hpp"
+#include "net/dataDecode.hpp"
+#include "net/tiltFilter.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::decode;
+
+// Frames a second
+#define RATE 100
+#define FRAME_TIME (NANOS_PER_SEC / RATE)
+// Size of the steps, in radians
+#define STEP 0.5f
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double value) {
+	printf("  %-56s %9.4f  %s\n", what, value, ok ? "ok" : "FAILED");
+	if(!ok) failures++;
+}
+
+/**
+ * A frame from a phone tilted by accelAngle about its y axis, whose gyro has
+ * turned by gyroAngle.
+ */
+static RawBinaryHeader frame(float accelAngle, float gyroAngle, bool gyro = true) {
+	RawBinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	header.flags = HEADER_FLAG_HAS_ACCEL | (gyro ? HEADER_FLAG_HAS_GYRO : 0);
+	header.axis.ax = sin(accelAngle);
+	header.axis.az = cos(accelAngle);
+	// The accelerometer's x tilt is the gyro's y angle, in the opposite sense
+	header.axis.gy = -gyroAngle;
+	return header;
+}
+
+/**
+ * Starts level, then steps the accelerometer to STEP at time 0, with the
+ * gyro following if rotate. Returns the tilt after each frame from then.
+ */
+static vector<float> stepResponse(bool rotate, int frames) {
+	TiltFilter filter;
+	uint64_t time = FRAME_TIME;
+	for(int i = 0; i < RATE; i++, time += FRAME_TIME)
+		filter.Update(frame(0, 0), time);
+	vector<float> tilt;
+	for(int i = 0; i < frames; i++, time += FRAME_TIME) {
+		filter.Update(frame(STEP, rotate ? STEP : 0), time);
+		tilt.push_back(filter.GetAngles().x);
+	}
+	return tilt;
+}
+
+int main(int argc, char **argv) {
+	printf("Rotation seen by gyro and accelerometer:\n");
+	vector<float> tilt = stepResponse(true, RATE);
+	check(fabs(tilt[0] - STEP) < 0.001f, "error after one frame (rad)", tilt[0] - STEP);
+	check(fabs(tilt.back() - STEP) < 0.001f, "error after 1s (rad)", tilt.back() - STEP);
+
+	printf("Step seen by the accelerometer alone:\n");
+	int tauFrames = (int)(TILT_FILTER_TIME_CONSTANT * RATE + 0.5f);
+	tilt = stepResponse(false, tauFrames * 5);
+	float atTau = tilt[tauFrames - 1] / STEP;
+	// A first order filter reaches 1 - 1/e after one time constant
+	check(fabs(atTau - (1 - exp(-1.0))) < 0.02f, "fraction after one time constant", atTau);
+	float first = tilt[0] / STEP;
+	check(first > 0 && first < 0.05f, "fraction after one frame", first);
+	float atFive = tilt.back() / STEP;
+	check(atFive > 0.99f && atFive <= 1.0001f, "fraction after five time constants", atFive);
+	bool monotonic = true;
+	for(size_t i = 1; i < tilt.size(); i++)
+		if(tilt[i] < tilt[i - 1]) monotonic = false;
+	check(monotonic, "rises without overshoot", monotonic);
+
+	printf("Frames without a gyro:\n");
+	TiltFilter filter;
+	uint64_t time = FRAME_TIME;
+	for(int i = 0; i < RATE; i++, time += FRAME_TIME)
+		filter.Update(frame(0.2f, 0.2f), time);
+	const int axes[] = { 1234, -567, 89, 0 };
+	DPJSData data;
+	data.axes.assign(axes, axes + 4);
+	RawBinaryHeader noGyro = frame(STEP, 0, false);
+	filter.Apply(noGyro, time, data);
+	check(vector<int>(axes, axes + 4) == data.axes, "axes unchanged", 0);
+	check(fabs(filter.GetAngles().x - 0.2f) < 0.001f, "filter state unchanged (rad)", filter.GetAngles().x);
+
+	printf("{\"suite\":\"tiltcheck\",\"failures\":%d}\n", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,384 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Cost of secure connections: the time taken by the handshake, and the CPU
+// cost of receiving each DPAD frame, for each TLS version and cipher the
+// computer may use. Frames are decrypted by OpenSSL or, where the kernel
+// supports it, by kernel TLS. A phone is simulated on a loopback TCP
+// connection; only the receiving thread's CPU time is counted.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include "bench.hpp"
+#include "timing.hpp"
+#include "net/protocol.hpp"
+#include "frameGenerator.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::decode;
+using namespace droidpad::bench;
+using namespace droidpad::sim;
+
+#define FRAMES_PER_REPEAT 20000
+
+/**
+ * A protocol version and cipher to connect with.
+ */
+struct TlsConfig {
+	const char *name;
+	int version;
+	// A cipher list up to TLS 1.2, or ciphersuites for TLS 1.3
+	const char *ciphers;
+};
+
+static const TlsConfig configs[] = {
+	// What TLSv1_server_method negotiated with the app
+	{ "TLSv1.0",	TLS1_VERSION,	"PSK-AES256-CBC-SHA" },
+	{ "TLSv1.2",	TLS1_2_VERSION,	"PSK-AES128-GCM-SHA256" },
+	{ "TLSv1.2",	TLS1_2_VERSION,	"PSK-CHACHA20-POLY1305" },
+#ifdef TLS1_3_VERSION
+	{ "TLSv1.3",	TLS1_3_VERSION,	"TLS_AES_128_GCM_SHA256" },
+	{ "TLSv1.3",	TLS1_3_VERSION,	"TLS_CHACHA20_POLY1305_SHA256" },
+#endif
+};
+#define NUM_CONFIGS (sizeof(configs) / sizeof(TlsConfig))
+
+static const char pskIdentity[] = "tlsbench";
+static const unsigned char pskKey[16] = {
+	0x44, 0x72, 0x6f, 0x69, 0x64, 0x50, 0x61, 0x64,
+	0x20, 0x62, 0x65, 0x6e, 0x63, 0x68, 0x21, 0x00,
+};
+
+static unsigned int serverPsk(SSL *ssl, const char *identity, unsigned char *psk, unsigned int maxPskLen) {
+	if(strcmp(identity, pskIdentity) != 0 || maxPskLen < sizeof(pskKey)) return 0;
+	memcpy(psk, pskKey, sizeof(pskKey));
+	return sizeof(pskKey);
+}
+
+static unsigned int clientPsk(SSL *ssl, const char *hint, char *identity, unsigned int maxIdentityLen,
+		unsigned char *psk, unsigned int maxPskLen) {
+	if(sizeof(pskIdentity) > maxIdentityLen || maxPskLen < sizeof(pskKey)) return 0;
+	strcpy(identity, pskIdentity);
+	memcpy(psk, pskKey, sizeof(pskKey));
+	return sizeof(pskKey);
+}
+
+#ifdef TLS1_3_VERSION
+// Makes a TLS 1.3 session from the PSK, as SecureConnection does
+static SSL_SESSION *pskSession(SSL *ssl) {
+	const unsigned char aes128GcmSha256[] = { 0x13, 0x01 };
+	const SSL_CIPHER *cipher = SSL_CIPHER_find(ssl, aes128GcmSha256);
+	SSL_SESSION *session = SSL_SESSION_new();
+	if(cipher == NULL || session == NULL ||
+			!SSL_SESSION_set1_master_key(session, pskKey, sizeof(pskKey)) ||
+			!SSL_SESSION_set_cipher(session, cipher) ||
+			!SSL_SESSION_set_protocol_version(session, TLS1_3_VERSION)) {
+		SSL_SESSION_free(session);
+		return NULL;
+	}
+	return session;
+}
+
+static int serverPskSession(SSL *ssl, const unsigned char *identity, size_t identityLength, SSL_SESSION **session) {
+	*session = NULL;
+	if(string((const char *)identity, identityLength) != pskIdentity) return 1;
+	return (*session = pskSession(ssl)) != NULL;
+}
+
+static int clientPskSession(SSL *ssl, const EVP_MD *md,
+		const unsigned char **id, size_t *idLen, SSL_SESSION **session) {
+	*id = (const unsigned char *)pskIdentity;
+	*idLen = strlen(pskIdentity);
+	return (*session = pskSession(ssl)) != NULL;
+}
+#endif
+
+static SSL_CTX *createContext(const TlsConfig &config, bool server) {
+	SSL_CTX *ctx = SSL_CTX_new(server ? TLS_server_method() : TLS_client_method());
+	SSL_CTX_set_min_proto_version(ctx, config.version);
+	SSL_CTX_set_max_proto_version(ctx, config.version);
+	SSL_CTX_set_security_level(ctx, 0);
+#ifdef TLS1_3_VERSION
+	if(config.version == TLS1_3_VERSION) {
+		SSL_CTX_set_ciphersuites(ctx, config.ciphers);
+		if(server) {
+			SSL_CTX_set_psk_find_session_callback(ctx, serverPskSession);
+			SSL_CTX_set_num_tickets(ctx, 0);
+		} else
+			SSL_CTX_set_psk_use_session_callback(ctx, clientPskSession);
+		return ctx;
+	}
+#endif
+	SSL_CTX_set_cipher_list(ctx, config.ciphers);
+	if(server) SSL_CTX_set_psk_server_callback(ctx, serverPsk);
+	else SSL_CTX_set_psk_client_callback(ctx, clientPsk);
+	return ctx;
+}
+
+static uint64_t threadCpuNanos() {
+	struct rusage usage;
+	getrusage(RUSAGE_THREAD, &usage);
+	return ((uint64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * NANOS_PER_SEC +
+		((uint64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * NANOS_PER_MICRO;
+}
+
+/**
+ * Makes a connected pair of loopback TCP sockets. Kernel TLS only works on TCP.
+ */
+static bool tcpPair(int fds[2]) {
+	int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	if(listenFd < 0 ||
+			bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+			listen(listenFd, 1) < 0 ||
+			getsockname(listenFd, (struct sockaddr *)&addr, &len) < 0) {
+		perror("tlsbench: listen");
+		if(listenFd >= 0) close(listenFd);
+		return false;
+	}
+	fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+	if(connect(fds[1], (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("tlsbench: connect");
+		close(listenFd);
+		return false;
+	}
+	fds[0] = accept(listenFd, NULL, NULL);
+	close(listenFd);
+	int one = 1;
+	setsockopt(fds[1], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fds[0] >= 0;
+}
+
+/**
+ * The simulated phone: does the client side of the handshake, then sends
+ * one record per frame.
+ */
+class Phone {
+	public:
+		SSL *ssl;
+		string frame;
+		long frames;
+		bool ok;
+
+		static void *run(void *arg) {
+			Phone *phone = (Phone *)arg;
+			phone->ok = SSL_connect(phone->ssl) == 1;
+			for(long i = 0; phone->ok && i < phone->frames; i++)
+				if(SSL_write(phone->ssl, phone->frame.data(), phone->frame.size()) != (int)phone->frame.size())
+					phone->ok = false;
+			return NULL;
+		}
+};
+
+/**
+ * One connection's receiving side, which reads frames the way SecureConnection does.
+ */
+class Receiver {
+	public:
+		Receiver(SSL *ssl, int fd, bool kernel) : ssl(ssl), fd(fd), kernel(kernel) { }
+
+		bool ReadFully(char *buf, size_t length) {
+			while(length > 0) {
+				int read;
+				if(kernel) {
+					read = recv(fd, buf, length, 0);
+					if(read < 0 && errno == EINTR) continue;
+					if(read < 0 && errno == EIO) read = SSL_read(ssl, buf, length);
+				} else
+					read = SSL_read(ssl, buf, length);
+				if(read < 1) return false;
+				buf += read;
+				length -= read;
+			}
+			return true;
+		}
+
+		bool ReadFrame() {
+			RawBinaryHeader header;
+			if(!ReadFully((char *)&header, sizeof(BinarySignature))) return false;
+			if(!ReadFully((char *)&header + sizeof(BinarySignature),
+						sizeof(RawBinaryHeader) - sizeof(BinarySignature)))
+				return false;
+			size_t elementsSize = sizeof(RawBinaryElement) * ntohl(header.numElements);
+			if(elementsSize > sizeof(elements)) return false;
+			if(!ReadFully(elements, elementsSize)) return false;
+			sink((int64_t)elements[0]);
+			return true;
+		}
+
+	private:
+		SSL *ssl;
+		int fd;
+		bool kernel;
+		char elements[64 * sizeof(RawBinaryElement)];
+};
+
+class TlsResult {
+	public:
+		TlsResult() : ok(false), kernelRx(false) { }
+		bool ok, kernelRx;
+		string cipher;
+		uint64_t handshakeNanos, cpuNanos, wallNanos;
+};
+
+/**
+ * Sends and receives frames over a new connection.
+ */
+static TlsResult runConnection(const TlsConfig &config, bool kernelTls, const string &frame, long frames) {
+	TlsResult result;
+	int fds[2];
+	if(!tcpPair(fds)) return result;
+
+	SSL_CTX *serverCtx = createContext(config, true);
+	SSL_CTX *clientCtx = createContext(config, false);
+#ifdef SSL_OP_ENABLE_KTLS
+	if(kernelTls) SSL_CTX_set_options(serverCtx, SSL_OP_ENABLE_KTLS);
+#endif
+
+	SSL *server = SSL_new(serverCtx);
+	SSL_set_fd(server, fds[0]);
+	Phone phone;
+	phone.ssl = SSL_new(clientCtx);
+	SSL_set_fd(phone.ssl, fds[1]);
+	phone.frame = frame;
+	phone.frames = frames;
+	pthread_t thread;
+	uint64_t handshakeStart = monotonicNanos();
+	pthread_create(&thread, NULL, Phone::run, &phone);
+
+	if(SSL_accept(server) == 1) {
+		result.handshakeNanos = monotonicNanos() - handshakeStart;
+		result.cipher = SSL_get_cipher_name(server);
+		result.kernelRx = BIO_get_ktls_recv(SSL_get_rbio(server));
+		Receiver receiver(server, fds[0], result.kernelRx);
+		uint64_t cpuStart = threadCpuNanos(), wallStart = monotonicNanos();
+		long received = 0;
+		while(received < frames && receiver.ReadFrame())
+			received++;
+		result.cpuNanos = threadCpuNanos() - cpuStart;
+		result.wallNanos = monotonicNanos() - wallStart;
+		result.ok = received == frames;
+	} else
+		ERR_print_errors_fp(stderr);
+	pthread_join(thread, NULL);
+	result.ok = result.ok && phone.ok;
+
+	SSL_free(server);
+	SSL_free(phone.ssl);
+	SSL_CTX_free(serverCtx);
+	SSL_CTX_free(clientCtx);
+	close(fds[0]);
+	close(fds[1]);
+	return result;
+}
+
+static void runCase(const char *name, const TlsConfig &config, bool kernelTls,
+		const SimLayout &layout, const char *layoutName, const BenchOptions &options) {
+	if(!options.filter.empty() &&
+			string(name).find(options.filter) == string::npos &&
+			string(layoutName).find(options.filter) == string::npos &&
+			string(config.name).find(options.filter) == string::npos &&
+			string(config.ciphers).find(options.filter) == string::npos)
+		return;
+
+	FrameGenerator gen(layout, 1);
+	gen.Step(0.25);
+	string frame = gen.BinaryFrame();
+
+	vector<double> handshake, cpu, wall;
+	TlsResult result;
+	for(int i = 0; i < options.repeats; i++) {
+		result = runConnection(config, kernelTls, frame, FRAMES_PER_REPEAT);
+		if(!result.ok) {
+			fprintf(stderr, "tlsbench: %s with %s %s failed\n", name, config.name, config.ciphers);
+			exit(1);
+		}
+		if(kernelTls && !result.kernelRx) break;
+		handshake.push_back(result.handshakeNanos);
+		cpu.push_back((double)result.cpuNanos / FRAMES_PER_REPEAT);
+		wall.push_back((double)result.wallNanos / FRAMES_PER_REPEAT);
+	}
+
+	printf("{\"suite\":\"tls\",\"bench\":\"%s\",\"layout\":\"%s\",\"version\":\"%s\",\"cipher\":\"%s\",\"kernel_tls\":%s",
+			name, layoutName, config.name, result.cipher.c_str(), result.kernelRx ? "true" : "false");
+	if(kernelTls && !result.kernelRx) {
+		// Most often the tls module isn't loaded (modprobe tls)
+		printf(",\"skipped\":\"kernel TLS unavailable\"");
+	} else {
+		sort(handshake.begin(), handshake.end());
+		sort(cpu.begin(), cpu.end());
+		sort(wall.begin(), wall.end());
+		printf(",\"handshake_ns\":%.0f,\"cpu_ns_per_frame\":%.2f,\"min_cpu_ns_per_frame\":%.2f,"
+				"\"wall_ns_per_frame\":%.2f,\"frames\":%d,\"repeats\":%d",
+				handshake[handshake.size() / 2], cpu[cpu.size() / 2], cpu[0], wall[wall.size() / 2],
+				FRAMES_PER_REPEAT, options.repeats);
+	}
+	if(!options.commit.empty()) printf(",\"commit\":\"%s\"", options.commit.c_str());
+	printf("}\n");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	if(!options.Parse(argc, argv, "Handshake time and CPU cost of receiving frames over TLS, for each protocol version and cipher."))
+		return 0;
+
+	SSL_library_init();
+	SSL_load_error_strings();
+
+	SimLayout js, absmouse;
+	absmouse.SetMode("absmouse");
+	absmouse.gyro = true;
+
+	for(size_t i = 0; i < NUM_CONFIGS; i++) {
+		runCase("SSL_read", configs[i], false, js, "js", options);
+		runCase("SSL_read", configs[i], false, absmouse, "absmouse", options);
+		// The kernel can't decrypt CBC ciphers
+		if(configs[i].version >= TLS1_2_VERSION) {
+			runCase("recv(kTLS)", configs[i], true, js, "js", options);
+			runCase("recv(kTLS)", configs[i], true, absmouse, "absmouse", options);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Time from connecting to having a usable output device on Linux: probing
+// for uinput, the shell-out that setup used to make on every connect, and
+// creating a device from scratch or taking it from the pool. The device
+// cases are skipped unless uinput can be opened (usually needs root).
+
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "timing.hpp"
+#include "output/linux/dpinput.h"
+#include "output/linux/uinputPool.hpp"
+#include "output/linux/platformSettings.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::bench;
+
+#define BENCH_AXES 6
+#define BENCH_BUTTONS 12
+
+static vector<dpAxisInfo> benchAxes() {
+	vector<dpAxisInfo> axes(BENCH_AXES);
+	for(size_t i = 0; i < axes.size(); i++) {
+		axes[i].code = dpinput_axisCode(TYPE_JS, i);
+		axes[i].min = -AXIS_SIZE;
+		axes[i].max = AXIS_SIZE;
+		axes[i].fuzz = SLIDER_FUZZ;
+		axes[i].flat = 0;
+		axes[i].resolution = 0;
+	}
+	return axes;
+}
+
+class ProbeCase : public BenchCase {
+	public:
+		// Only a successful probe is cached
+		ProbeCase(bool cached) : BenchCase("dpinput_checkUInput", cached ? "cached" : "failed") { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((int64_t)dpinput_checkUInput());
+		}
+};
+
+class ShellProbeCase : public BenchCase {
+	public:
+		ShellProbeCase() : BenchCase("system(modprobe)", "every-connect") { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++)
+				sink((int64_t)system("modprobe uinput 2>/dev/null"));
+		}
+};
+
+class CreateDeviceCase : public BenchCase {
+	public:
+		CreateDeviceCase() : BenchCase("dpinput_setup", "js-6a-12b"), axes(benchAxes()) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++) {
+				dpInfo info;
+				info.axisMin = -AXIS_SIZE;
+				info.axisMax = AXIS_SIZE;
+				info.buttonNum = BENCH_BUTTONS;
+				info.axisNum = axes.size();
+				info.axisInfo = &axes[0];
+				if(dpinput_setup(&info, TYPE_JS) < 0) {
+					fprintf(stderr, "uinputbench: dpinput_setup failed\n");
+					exit(1);
+				}
+				dpinput_close(&info);
+			}
+		}
+	private:
+		vector<dpAxisInfo> axes;
+};
+
+class PoolCase : public BenchCase {
+	public:
+		PoolCase() : BenchCase("UInputPool::Acquire", "js-6a-12b"), axes(benchAxes()) { }
+		void Run(long iterations) {
+			for(long i = 0; i < iterations; i++) {
+				dpInfo *info = UInputPool::Acquire(TYPE_JS, BENCH_BUTTONS, axes);
+				if(info == NULL) {
+					fprintf(stderr, "uinputbench: UInputPool::Acquire failed\n");
+					exit(1);
+				}
+				UInputPool::Release(info);
+			}
+		}
+	private:
+		vector<dpAxisInfo> axes;
+};
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	if(!options.Parse(argc, argv, "Time taken to probe for uinput and to get an output device."))
+		return 0;
+
+	// Once it has succeeded the probe does no work, so the first is timed on its own
+	uint64_t start = monotonicNanos();
+	int result = dpinput_checkUInput();
+	uint64_t firstProbe = monotonicNanos() - start;
+	printf("{\"suite\":\"uinput\",\"bench\":\"dpinput_checkUInput\",\"layout\":\"first\",\"ns_per_op\":%llu,\"result\":%d",
+			(unsigned long long)firstProbe, result);
+	if(!options.commit.empty()) printf(",\"commit\":\"%s\"", options.commit.c_str());
+	printf("}\n");
+	fflush(stdout);
+
+	vector<BenchCase *> cases;
+	cases.push_back(new ProbeCase(result == CHECKRESULT_SUCCESS));
+	cases.push_back(new ShellProbeCase);
+	if(result == CHECKRESULT_SUCCESS) {
+		cases.push_back(new CreateDeviceCase);
+		cases.push_back(new PoolCase);
+	} else
+		fprintf(stderr, "uinputbench: uinput unavailable, skipping device creation\n");
+	runAll(cases, options, "uinput");
+
+	UInputPool::Clear();
+	for(size_t i = 0; i < cases.size(); i++)
+		delete cases[i];
+	return 0;
+}
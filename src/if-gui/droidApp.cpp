@@ -36,9 +36,11 @@ using namespace std;
 #include "log.hpp"
 #include "setup.hpp"
 #include "help.hpp"
+#include "timing.hpp"
 
 #ifdef OS_LINUX
 #include "output/linux/dpinput.h"
+#include "output/linux/uinputPool.hpp"
 #endif
 
 using namespace droidpad;
@@ -128,6 +130,9 @@ bool DroidApp::OnInit()
 }
 
 int DroidApp::OnExit() {
+#ifdef OS_LINUX
+	UInputPool::Clear();
+#endif
 	logOut.close();
 	return 0;
 }
@@ -145,11 +150,23 @@ bool DroidApp::OnCmdLineParsed(wxCmdLineParser& parser) {
 	runSetup = parser.Found(wxT("s"));
 	showGettingStarted = parser.Found(wxT("g"));
 	runRemove = parser.Found(wxT("u"));
+	parser.Found(wxT("c"), &Data::capturePath);
+	parser.Found(wxT("r"), &Data::replayPath);
+	Data::replayMaxSpeed = parser.Found(wxT("f"));
+	parser.Found(wxT("d"), &Data::outputDumpPath);
+	Data::recordOutput = parser.Found(wxT("o")) || !Data::outputDumpPath.IsEmpty();
+	parser.Found(wxT("m"), &Data::shmOutput);
+	Data::kernelTls = parser.Found(wxT("k"));
+	long realtimeValue;
+	if(parser.Found(wxT("t"), &realtimeValue)) Data::realtimePriority = realtimeValue;
+	if(parser.Found(wxT("p"), &realtimeValue)) Data::realtimeCpu = realtimeValue;
+	Data::receiveLoop = parser.Found(wxT("l"));
 #ifdef DEBUG
 	Data::noAdb = parser.Found(wxT("a"));
 #endif
 
-	if(!parser.Found(wxT("n"))) { // If user didn't request no root, check.
+	// Root is only needed for uinput, which isn't used when recording output.
+	if(!parser.Found(wxT("n")) && !Data::recordOutput) { // If user didn't request no root, check.
 		requestNecessaryPermissions();
 	}
 
@@ -160,7 +177,12 @@ void DroidApp::requestNecessaryPermissions() {
 #ifdef OS_LINUX
 	LOGV("Checking if permissions needed");
 	if(isAdmin()) return; // We should be fine if sudo / su.
-	if(dpinput_checkUInput() == CHECKRESULT_PERMS) { // Checking permissions
+	// Timed, as it may load the uinput module during startup
+	uint64_t start = monotonicNanos();
+	int probe = dpinput_checkUInput();
+	LOGVwx(wxString::Format(wxT("Probed for uinput in %d us"),
+				(int)((monotonicNanos() - start) / NANOS_PER_MICRO)));
+	if(probe == CHECKRESULT_PERMS) { // Checking permissions
 		LOGV("Getting elevated permissions");
 		wxString args;
 		if(argc > 1) {
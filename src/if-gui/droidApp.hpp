@@ -67,6 +67,26 @@ static const wxCmdLineEntryDesc dp_cmdLineDesc [] =
 		wxCMD_LINE_VAL_NONE, wxCMD_LINE_PARAM_OPTIONAL  },
 	{ wxCMD_LINE_SWITCH, wxT("g"), wxT("getting-started"), wxT("view the getting started guide"),
 		wxCMD_LINE_VAL_NONE, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_OPTION, wxT("c"), wxT("capture"), wxT("save everything received from the phone to a capture file"),
+		wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_OPTION, wxT("r"), wxT("replay"), wxT("offer a capture file to be played back as a device"),
+		wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_SWITCH, wxT("f"), wxT("replay-fast"), wxT("play back captures as fast as possible"),
+		wxCMD_LINE_VAL_NONE, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_SWITCH, wxT("o"), wxT("record-output"), wxT("record output in memory instead of sending it to the system"),
+		wxCMD_LINE_VAL_NONE, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_OPTION, wxT("d"), wxT("output-dump"), wxT("write recorded output to a file (implies --record-output)"),
+		wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_OPTION, wxT("m"), wxT("shm-output"), wxT("also publish output to shared memory, as /dev/shm/droidpad-<name>"),
+		wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_SWITCH, wxT("k"), wxT("kernel-tls"), wxT("let the kernel decrypt secure connections, where supported"),
+		wxCMD_LINE_VAL_NONE, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_OPTION, wxT("t"), wxT("realtime"), wxT("run input at this real-time priority (1-99), with memory locked"),
+		wxCMD_LINE_VAL_NUMBER, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_OPTION, wxT("p"), wxT("pin-cpu"), wxT("with --realtime, keep input on this CPU"),
+		wxCMD_LINE_VAL_NUMBER, wxCMD_LINE_PARAM_OPTIONAL  },
+	{ wxCMD_LINE_SWITCH, wxT("l"), wxT("receive-loop"), wxT("receive from all phones on one thread, on Linux"),
+		wxCMD_LINE_VAL_NONE, wxCMD_LINE_PARAM_OPTIONAL  },
 #ifdef DEBUG
 	{ wxCMD_LINE_SWITCH, wxT("a"), wxT("no-adb"), wxT("don't run adb at all (for debugging)"),
 		wxCMD_LINE_VAL_NONE, wxCMD_LINE_PARAM_OPTIONAL  },
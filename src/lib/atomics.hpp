@@ -0,0 +1,45 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_ATOMICS_H
+#define DP_ATOMICS_H
+
+// Memory ordered loads and stores for lock-free structures shared between
+// threads. Uses the __atomic builtins where available, otherwise the older
+// __sync builtins, which only offer full barriers.
+
+#ifdef __ATOMIC_ACQUIRE
+#define LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STORE_RELAXED(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define ADD_RELAXED(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#else
+#define LOAD_ACQUIRE(p) ({ __typeof__(*(p)) _v = *(volatile __typeof__(*(p)) *)(p); __sync_synchronize(); _v; })
+#define STORE_RELEASE(p, v) do { __sync_synchronize(); *(volatile __typeof__(*(p)) *)(p) = (v); } while(0)
+#define LOAD_RELAXED(p) (*(volatile __typeof__(*(p)) *)(p))
+#define STORE_RELAXED(p, v) do { *(volatile __typeof__(*(p)) *)(p) = (v); } while(0)
+#define ADD_RELAXED(p, v) __sync_fetch_and_add((p), (v))
+#define FENCE_ACQUIRE() __sync_synchronize()
+#define FENCE_RELEASE() __sync_synchronize()
+#endif
+
+#endif
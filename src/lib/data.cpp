@@ -34,6 +34,8 @@
 #include <boost/random/uniform_int_distribution.hpp>
 
 #include "log.hpp"
+#include "net/socketOptions.hpp"
+#include "output/relativeMotion.hpp"
 
 using namespace std;
 using namespace droidpad;
@@ -46,6 +48,19 @@ wxChar Data::blackKey = 'b';
 wxChar Data::whiteKey = 'w';
 boost::uuids::uuid Data::computerUuid;
 bool Data::secureSupported = false;
+int Data::connectionTimeout = DEFAULT_CONNECTION_TIMEOUT;
+int Data::busyPoll = 0;
+int Data::mouseAcceleration = DEFAULT_MOUSE_ACCELERATION;
+wxString Data::capturePath = wxT("");
+wxString Data::replayPath = wxT("");
+bool Data::replayMaxSpeed = false;
+bool Data::recordOutput = false;
+wxString Data::outputDumpPath = wxT("");
+wxString Data::shmOutput = wxT("");
+bool Data::kernelTls = false;
+int Data::realtimePriority = 0;
+int Data::realtimeCpu = -1;
+bool Data::receiveLoop = false;
 #ifdef DEBUG
 bool Data::noAdb = false;
 #endif
@@ -192,6 +207,15 @@ void Data::loadPreferences() {
 	// secureSupported
 	config->Read(wxT("secureSupported"), &secureSupported, false);
 
+	// connectionTimeout
+	config->Read(wxT("connectionTimeout"), &connectionTimeout, DEFAULT_CONNECTION_TIMEOUT);
+
+	// busyPoll
+	config->Read(wxT("busyPoll"), &busyPoll, 0);
+
+	// mouseAcceleration
+	config->Read(wxT("mouseAcceleration"), &mouseAcceleration, DEFAULT_MOUSE_ACCELERATION);
+
 	// blackKey & whiteKey
 	wxString black, white;
 	config->Read(wxT("blackKey"), &black, wxT("b"));
@@ -249,6 +273,9 @@ void Data::savePreferences() {
 	config->Write(wxT("computerUuid"),
 			wxString(computerUuidString().c_str(), wxConvUTF8));
 	config->Write(wxT("secureSupported"), secureSupported);
+	config->Write(wxT("connectionTimeout"), connectionTimeout);
+	config->Write(wxT("busyPoll"), busyPoll);
+	config->Write(wxT("mouseAcceleration"), mouseAcceleration);
 
 	config->Write(wxT("blackKey"), (wxString)blackKey);
 	config->Write(wxT("whiteKey"), (wxString)whiteKey);
@@ -99,6 +99,15 @@ namespace droidpad
 
 			static bool secureSupported;
 
+			// Time after which a silent phone is treated as lost, in ms; 0 to wait forever
+			static int connectionTimeout;
+
+			// Time to spin waiting for each packet before sleeping, in us; 0 to never spin
+			static int busyPoll;
+
+			// Extra speed given to fast mouse movements, in percent; 0 for none
+			static int mouseAcceleration;
+
 			/**
 			 * Maps buttons and axes to where the user wants them.
 			 */
@@ -114,6 +123,30 @@ namespace droidpad
 
 			static void savePreferences();
 
+			/**
+			 * Runtime options, not saved
+			 */
+			// If set, everything received from the phone is saved here
+			static wxString capturePath;
+			// If set, a capture file to offer for playback as a device
+			static wxString replayPath;
+			// Play back as fast as possible, rather than at the recorded speed
+			static bool replayMaxSpeed;
+			// Record output in memory instead of sending it to the system
+			static bool recordOutput;
+			// If set, recorded output is also written here
+			static wxString outputDumpPath;
+			// If set, output is also published to shared memory under this session name
+			static wxString shmOutput;
+			// Let the kernel decrypt secure connections, where it can
+			static bool kernelTls;
+			// Real-time priority for the input threads; 0 to run them normally
+			static int realtimePriority;
+			// CPU to pin the input threads to, or -1 for any
+			static int realtimeCpu;
+			// Receive plain connections on one shared thread, on Linux
+			static bool receiveLoop;
+
 #ifdef DEBUG
 			/**
 			 * Runtime debug options
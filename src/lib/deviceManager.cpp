@@ -127,7 +127,7 @@ void DeviceManager::Start(int device)
 		AddPendingEvent(evt);
 		return;
 	}
-	mainThread = new MainThread(*this, newDevice);
+	mainThread = new MainThread(*this, newDevice, adb);
 	mainThread->Create();
 	mainThread->Run();
 	state = DP_STATE_STARTING;
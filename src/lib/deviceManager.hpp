@@ -40,7 +40,6 @@ namespace droidpad {
 	}
 
 	class DeviceManager : public wxEvtHandler {
-		friend class MainThread;
 		public:
 			DeviceManager(DroidPadCallbacks &callbacks);
 			~DeviceManager();
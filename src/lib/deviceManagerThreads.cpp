@@ -21,6 +21,7 @@
 
 #include "net/deviceDiscover.hpp"
 #include "deviceManager.hpp"
+#include "data.hpp"
 #include "log.hpp"
 
 #include <wx/thread.h>
@@ -94,6 +95,15 @@ void* DeviceFinder::Entry()
 		custom.name = wxT("");
 		devs.push_back(custom);
 
+		if(!Data::replayPath.IsEmpty()) {
+			AndroidDevice replay;
+			replay.type = DEVICE_REPLAY;
+			replay.usbId = Data::replayPath;
+			replay.name = wxT("");
+			replay.secureSupported = false;
+			devs.push_back(replay);
+		}
+
 		vector<wxString> usbDevices = adb.getDeviceIds();
 		for(int i = 0; i < usbDevices.size(); i++) {
 			AndroidDevice dev;
@@ -41,6 +41,8 @@ AndroidDevice::operator wxString() const {
 			return wxString::Format(_("Wifi: %s (%s:%d) %s"), name.c_str(), ip.c_str(), port, secureSupported ? _("(Secure)") : _("(Insecure)"));
 		case DEVICE_CUSTOMHOST:
 			return wxString(_("Custom device"));
+		case DEVICE_REPLAY:
+			return wxString(_("Replay: ")) + usbId;
 	}
 }
 
@@ -30,6 +30,8 @@
 #define DEVICE_USB 1
 #define DEVICE_NET 2
 #define DEVICE_CUSTOMHOST 3
+// Plays back a capture file. usbId holds the path.
+#define DEVICE_REPLAY 4
 
 namespace droidpad {
 	class AndroidDevice : public wxClientData {
@@ -4,12 +4,15 @@
 #include <string>
 #include <algorithm>
 
+#ifndef BASE64_NO_WX
 #include <wx/string.h>
+#endif
 //#include "ext/hexdump.h"
 
 std::string base64_encode(unsigned char const* , unsigned int len);
 std::string base64_decode(std::string const& s);
 
+#ifndef BASE64_NO_WX
 // Added for wxWidgets compatibility
 inline wxString base64_encode(wxString in) {
 	unsigned char *data = new unsigned char[in.Length()];
@@ -39,6 +42,8 @@ inline std::string base64_encode2uri(wxString in) {
 	return result;
 }
 
+#endif
+
 /**
  * Encodes as URI-safe B64.
  */
@@ -19,14 +19,20 @@
  */
 #include "mainThread.hpp"
 
-#include "deviceManager.hpp"
 #include "include/outputMgr.hpp"
 #include "output/outputSmoothBuffer.hpp"
+#include "output/recordingOutputMgr.hpp"
+#ifdef OS_LINUX
+#include "output/shmOutputMgr.hpp"
+#include "net/loopConnection.hpp"
+#endif
 #include "net/secureConnection.hpp"
+#include "net/replayConnection.hpp"
 
 #include "events.hpp"
 #include "log.hpp"
 #include "data.hpp"
+#include "realtime.hpp"
 
 #include <string>
 #include <iostream>
@@ -35,20 +41,24 @@ using namespace std;
 using namespace droidpad;
 using namespace droidpad::decode;
 
-MainThread::MainThread(DeviceManager &parent, AndroidDevice &device) :
+MainThread::MainThread(wxEvtHandler &parent, AndroidDevice &device, AdbManager *adb) :
 	parent(parent),
+	adb(adb),
 	device(device),
 	running(true),
 	mgr(NULL),
-	deleteOutputManager(true)
+	deleteOutputManager(true),
+	capture(NULL)
 {
-	if(device.secureSupported) {
-		LOGV("Starting a secure communication with the device");
-		conn = new SecureConnection(device);
-	} else {
-		LOGV("Starting an INSECURE communication with the device");
-		conn = new DPConnection(device);
+	if(!Data::capturePath.IsEmpty()) {
+		try {
+			capture = new capture::CaptureWriter(string(Data::capturePath.mb_str()));
+			LOGVwx(wxT("Capturing to ") + Data::capturePath);
+		} catch(runtime_error &e) {
+			LOGWwx(wxString::FromAscii(e.what()));
+		}
 	}
+	conn = createConnection();
 }
 
 MainThread::~MainThread() {
@@ -58,8 +68,13 @@ MainThread::~MainThread() {
 void* MainThread::Entry()
 {
 	LOGV("Starting DroidPad");
+	if(Data::realtimePriority > 0)
+		realtime::enterLowLatency("Input thread", Data::realtimePriority, Data::realtimeCpu);
 	bool connectAgain = false;
 	bool setupDone = true;
+	// Read while setting up the joystick, and sent once it exists
+	DPJSData firstInput;
+	bool haveFirstInput = false;
 	do { // connectAgain
 		int setupResult;
 		if((setupResult = setup()) != SETUP_SUCCESS) {
@@ -67,10 +82,7 @@ void* MainThread::Entry()
 				LOGW("Failed to reconnect, retrying...");
 				wxMilliSleep(300);
 				delete conn; // Reset
-				if(device.secureSupported)
-					conn = new SecureConnection(device);
-				else
-					conn = new DPConnection(device);
+				conn = createConnection();
 				continue;
 			} else {
 				setupDone = false;
@@ -84,24 +96,33 @@ void* MainThread::Entry()
 		if(setupDone) { // Skip this if fail - only run on first time.
 			const ModeSetting &mode = conn->GetMode();
 			if(mode.supportsBinary) conn->RequestBinary();
+			if(mode.supportsDelta) conn->RequestDelta();
 			if(!connectAgain) {
 				try { // Setup outputmanager
 					LOGV("Setting up OutputManager");
 
 					switch(mode.type) {
 						case MODE_JS:
+							// Which axes come from the sensors is only known from
+							// what the phone sends, so wait for its first input.
+							if(!waitForInput(firstInput))
+								throw runtime_error("Connection closed before any input was sent");
+							haveFirstInput = true;
+							mgr = createOutputManager(mode.type, mode.numRawAxes * 2 + mode.numAxes, mode.numButtons,
+									firstInput.accelAxes, firstInput.gyroAxes);
+							break;
 						case MODE_SLIDE:
-							mgr = new OutputManager(mode.type, mode.numRawAxes * 2 + mode.numAxes, mode.numButtons);
+							mgr = createOutputManager(mode.type, mode.numRawAxes * 2 + mode.numAxes, mode.numButtons);
 							break;
 						case MODE_ABSMOUSE: {
 							deleteOutputManager = false;
-							OutputManager *innerMgr = new OutputManager(mode.type, 2 + mode.numAxes, mode.numButtons);
+							IOutputManager *innerMgr = createOutputManager(mode.type, 2 + mode.numAxes, mode.numButtons);
 							mgr = new OutputSmoothBuffer(innerMgr, mode.type, 2 + mode.numAxes, mode.numButtons);
 							break;
 								    }
 						case MODE_MOUSE:
 							deleteOutputManager = false;
-							OutputManager *innerMgr = new OutputManager(mode.type, mode.numRawAxes * 2 + mode.numAxes, mode.numButtons);
+							IOutputManager *innerMgr = createOutputManager(mode.type, mode.numRawAxes * 2 + mode.numAxes, mode.numButtons);
 							mgr = new OutputSmoothBuffer(innerMgr, mode.type, mode.numRawAxes * 2 + mode.numAxes, mode.numButtons);
 							break;
 					}
@@ -120,6 +141,14 @@ void* MainThread::Entry()
 					finish();
 					return NULL;
 				}
+				catch(runtime_error &e) { // While waiting for input
+					LOGEwx(wxString::FromAscii(e.what()));
+					DMEvent evt(dpTHREAD_ERROR, THREAD_ERROR_CONNECT_FAIL);
+					parent.AddPendingEvent(evt);
+
+					finish();
+					return NULL;
+				}
 
 				DMEvent evt(dpTHREAD_STARTED, 0);
 				parent.AddPendingEvent(evt);
@@ -132,11 +161,17 @@ void* MainThread::Entry()
 		DMEvent evt(dpTHREAD_NOTIFICATION, THREAD_INFO_CONNECTED);
 		parent.AddPendingEvent(evt);
 
+		if(haveFirstInput) {
+			sendData(firstInput);
+			haveFirstInput = false;
+		}
 		while(running) {
 			if(setupDone) {
 				switch(loop()) {
 					case LOOP_CONNLOST: {
 					        LOGV("Loop sent connlost");
+						// Don't leave buttons held or the stick deflected while reconnecting
+						neutraliseOutput();
 						connectAgain = true; // Try to reconnect.
 						running = false; // Exit loop
 						DMEvent evt(dpTHREAD_NOTIFICATION, THREAD_WARNING_CONNECTION_LOST); // This is now just a warning, not an error.
@@ -157,6 +192,48 @@ void* MainThread::Entry()
 		}
 	} while(connectAgain);
 	finish();
+	return NULL;
+}
+
+Connection *MainThread::createConnection()
+{
+	Connection *ret;
+	if(device.type == DEVICE_REPLAY) {
+		LOGV("Replaying a capture");
+		ret = new ReplayConnection(device.usbId, !Data::replayMaxSpeed);
+	} else if(device.secureSupported) {
+		LOGV("Starting a secure communication with the device");
+		ret = new SecureConnection(device);
+	} else {
+		LOGV("Starting an INSECURE communication with the device");
+		ret = NULL;
+#ifdef OS_LINUX
+		if(Data::receiveLoop) ret = new LoopConnection(device);
+#endif
+		if(ret == NULL) ret = new DPConnection(device);
+	}
+	ret->SetCapture(capture);
+	return ret;
+}
+
+IOutputManager *MainThread::createOutputManager(int type, int numAxes, int numButtons, uint32_t accelAxes, uint32_t gyroAxes)
+{
+	IOutputManager *mgr;
+	if(Data::recordOutput) {
+		LOGV("Recording output instead of sending it to the system");
+		mgr = new RecordingOutputManager(type, numAxes, numButtons, NULL,
+				string(Data::outputDumpPath.mb_str()));
+	} else {
+		mgr = new OutputManager(type, numAxes, numButtons, accelAxes, gyroAxes);
+	}
+#ifdef OS_LINUX
+	if(!Data::shmOutput.IsEmpty()) {
+		LOGVwx(wxT("Publishing output to shared memory as ") + Data::shmOutput);
+		return new SharedMemoryOutputManager(type, numAxes, numButtons,
+				string(Data::shmOutput.mb_str()), mgr);
+	}
+#endif
+	return mgr;
 }
 
 void MainThread::stop()
@@ -168,7 +245,7 @@ void MainThread::stop()
 int MainThread::setup()
 {
 	// TODO: Only this on first time round?
-	if(device.type == DEVICE_USB) parent.adb->forwardDevice(string(device.usbId.mb_str()), device.port);
+	if(device.type == DEVICE_USB) adb->forwardDevice(string(device.usbId.mb_str()), device.port);
 	// TODO: Display more fitting errors. Perhaps LOGE displays errors to user in some cases?
 	switch(conn->Start()) {
 		case Connection::START_AUTHERROR:
@@ -192,6 +269,15 @@ int MainThread::setup()
 
 }
 
+bool MainThread::waitForInput(DPJSData &data)
+{
+	do {
+		data = conn->GetData();
+		if(data.connectionClosed) return false;
+	} while(data.noInput);
+	return true;
+}
+
 int MainThread::loop()
 {
 	try {
@@ -200,24 +286,8 @@ int MainThread::loop()
 			LOGV("Received message from device indicating that connection was closed.");
 			return LOOP_FINISHED;
 		}
-		switch(conn->GetMode().type) {
-			case MODE_JS:
-				data.reorder(Data::buttonOrder, Data::axisOrder);
-				mgr->SendJSData(data);
-				break;
-			case MODE_MOUSE:
-				mgr->SendMouseData(DPMouseData(data, prevData));
-				break;
-			case MODE_ABSMOUSE: {
-				DPTouchData touchData = DPTouchData(data, prevData, prevAbsData);
-				mgr->SendTouchData(touchData);
-				prevAbsData = touchData;
-					    } break;
-			case MODE_SLIDE:
-				mgr->SendSlideData(DPSlideData(data, prevData));
-				break;
-		}
-		prevData = data;
+		// Control messages, such as pongs, leave the output and prevData alone
+		if(!data.noInput) sendData(data);
 	} catch(runtime_error e) {
 		printf("GetData failed: %s\n", e.what());
 		return LOOP_CONNLOST;
@@ -225,6 +295,45 @@ int MainThread::loop()
 	return LOOP_OK;
 }
 
+void MainThread::sendData(DPJSData &data)
+{
+	switch(conn->GetMode().type) {
+		case MODE_JS:
+			data.reorder(Data::buttonOrder, Data::axisOrder);
+			mgr->SendJSData(data);
+			break;
+		case MODE_MOUSE:
+			mgr->SendMouseData(DPMouseData(data, prevData));
+			if(!data.contacts.empty()) mgr->SendTouchContacts(data.contacts);
+			break;
+		case MODE_ABSMOUSE: {
+			DPTouchData touchData = DPTouchData(data, prevData, prevAbsData);
+			mgr->SendTouchData(touchData);
+			prevAbsData = touchData;
+			if(!data.contacts.empty()) mgr->SendTouchContacts(data.contacts);
+				    } break;
+		case MODE_SLIDE:
+			mgr->SendSlideData(DPSlideData(data, prevData));
+			break;
+	}
+	prevData = data;
+}
+
+void MainThread::neutraliseOutput()
+{
+	if(mgr == NULL) return;
+	DPJSData neutral = prevData;
+	neutral.buttons.assign(neutral.buttons.size(), false);
+	for(vector<TouchContact>::iterator it = neutral.contacts.begin(); it != neutral.contacts.end(); it++)
+		it->down = false;
+	// Centre the axes, stopping relative mouse movement. The absolute mouse
+	// keeps its position.
+	if(conn->GetMode().type != MODE_ABSMOUSE)
+		neutral.axes.assign(neutral.axes.size(), 0);
+	neutral.reset = false;
+	sendData(neutral);
+}
+
 void MainThread::finish()
 {
 	if(mgr != NULL) {
@@ -232,6 +341,8 @@ void MainThread::finish()
 		if(deleteOutputManager) delete mgr;
 	}
 	delete conn;
+	delete capture; // Flushes anything left
+	capture = NULL;
 
 	DMEvent evt(dpTHREAD_FINISH, 0);
 	parent.AddPendingEvent(evt);
@@ -21,27 +21,31 @@
 #define DP_MAIN_THREAD_H
 
 #include <wx/thread.h>
+#include <wx/event.h>
 #include "droidpadCallbacks.hpp"
 #include "include/adb.hpp"
 #include "output/IOutputMgr.hpp"
 #include "net/connection.hpp"
 
 namespace droidpad {
-	class DeviceManager;
-
 	/**
 	  * Main thread - connects & does all the magick.
 	  */
 	class MainThread : public wxThread
 	{
 		public:
-			MainThread(DeviceManager &parent, AndroidDevice &device);
+			/**
+			 * parent - Sent the thread's DMEvents
+			 * adb - Used to forward USB devices; may be NULL for others
+			 */
+			MainThread(wxEvtHandler &parent, AndroidDevice &device, AdbManager *adb);
 			~MainThread();
 			void* Entry();
 
 			void stop();
 		private:
-			DeviceManager &parent;
+			wxEvtHandler &parent;
+			AdbManager *adb;
 			AndroidDevice device; // If this is a reference then stack gets smashed sometimes
 
 			// The implementation changes per platform here
@@ -49,6 +53,19 @@ namespace droidpad {
 			bool deleteOutputManager;
 
 			Connection *conn;
+			/**
+			 * Creates the right type of connection for device.
+			 */
+			Connection *createConnection();
+			/**
+			 * Creates the output manager for the platform, or a recording one if
+			 * that was asked for.
+			 */
+			IOutputManager *createOutputManager(int type, int numAxes, int numButtons,
+					uint32_t accelAxes = 0, uint32_t gyroAxes = 0);
+
+			// Only present if a capture was requested
+			capture::CaptureWriter *capture;
 
 			decode::DPJSData prevData;
 			decode::DPTouchData prevAbsData;
@@ -71,10 +88,23 @@ namespace droidpad {
 				LOOP_CONNLOST
 			};
 
+			/**
+			 * Reads until the phone sends some input. Returns false if it
+			 * closed the connection instead.
+			 */
+			bool waitForInput(decode::DPJSData &data);
 			/**
 			 * Returns LOOP_*
 			 */
 			int loop();
+			/**
+			 * Sends data to the output manager, according to the mode.
+			 */
+			void sendData(decode::DPJSData &data);
+			/**
+			 * Releases all buttons and centres axes, when the phone is lost.
+			 */
+			void neutraliseOutput();
 			void finish();
 	};
 }
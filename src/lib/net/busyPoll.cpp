@@ -0,0 +1,155 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "busyPoll.hpp"
+
+#include <string.h>
+
+#ifdef OS_LINUX
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#elif defined(OS_WIN32)
+#include <winsock2.h>
+#endif
+
+#include "log.hpp"
+#include "timing.hpp"
+
+using namespace droidpad;
+using namespace std;
+
+vector<SocketOption> droidpad::getBusyPollOptions(int micros) {
+	vector<SocketOption> options;
+	options.push_back(SocketOption(IPPROTO_TCP, TCP_NODELAY, 1));
+#ifdef TCP_QUICKACK
+	options.push_back(SocketOption(IPPROTO_TCP, TCP_QUICKACK, 1));
+#endif
+#ifdef SO_BUSY_POLL
+	options.push_back(SocketOption(SOL_SOCKET, SO_BUSY_POLL, micros));
+#endif
+#ifdef SO_PREFER_BUSY_POLL
+	options.push_back(SocketOption(SOL_SOCKET, SO_PREFER_BUSY_POLL, 1));
+#endif
+	return options;
+}
+
+BusyPoller::BusyPoller() :
+	fd(-1),
+	epollFd(-1),
+	spinNanos(0)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+BusyPoller::~BusyPoller() {
+	Detach();
+}
+
+bool BusyPoller::Attach(int fd, int spinMicros) {
+	Detach();
+#ifdef OS_LINUX
+	// Raising SO_BUSY_POLL past net.core.busy_read needs CAP_NET_ADMIN, so
+	// the kernel may only spin for less, or not at all; the spin here still
+	// works either way.
+	if(!setSocketOptions(fd, getBusyPollOptions(spinMicros)))
+		LOGV("Kernel busy polling not available, spinning in user space only");
+
+	epollFd = epoll_create(1);
+	if(epollFd < 0) return false;
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+		close(epollFd);
+		epollFd = -1;
+		return false;
+	}
+	this->fd = fd;
+	spinNanos = spinMicros * NANOS_PER_MICRO;
+	memset(&stats, 0, sizeof(stats));
+	return true;
+#else
+	return false;
+#endif
+}
+
+void BusyPoller::Detach() {
+#ifdef OS_LINUX
+	if(epollFd >= 0) close(epollFd);
+#endif
+	epollFd = -1;
+	fd = -1;
+}
+
+bool BusyPoller::Readable() const {
+#ifdef OS_LINUX
+	char c;
+	int result = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+	return result >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+#else
+	return true;
+#endif
+}
+
+void BusyPoller::QuickAck() const {
+#ifdef TCP_QUICKACK
+	// The kernel clears this whenever it decides to delay acks again
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+#endif
+}
+
+bool BusyPoller::Wait(int timeout) {
+	if(fd < 0) return true;
+	stats.waits++;
+
+	uint64_t start = monotonicNanos(), now = start;
+	do {
+		if(Readable()) {
+			stats.spinHits++;
+			stats.spinNanos += monotonicNanos() - start;
+			QuickAck();
+			return true;
+		}
+		now = monotonicNanos();
+	} while(now - start < spinNanos);
+	stats.spinNanos += now - start;
+
+#ifdef OS_LINUX
+	// Nothing yet, so sleep until something arrives
+	if(timeout > 0) {
+		timeout -= (now - start) / NANOS_PER_MILLI;
+		if(timeout < 1) timeout = 1;
+	}
+	struct epoll_event event;
+	int result;
+	do {
+		result = epoll_wait(epollFd, &event, 1, timeout);
+	} while(result < 0 && errno == EINTR);
+	if(result == 0) return false;
+	QuickAck();
+#endif
+	return true;
+}
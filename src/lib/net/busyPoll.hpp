@@ -0,0 +1,89 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_BUSY_POLL_H
+#define DP_BUSY_POLL_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "socketOptions.hpp"
+
+namespace droidpad {
+	/**
+	 * How a BusyPoller's waits went, to weigh the CPU spent against the
+	 * wakeups saved.
+	 */
+	typedef struct {
+		// Calls to Wait
+		uint64_t waits;
+		// Waits where data arrived while spinning
+		uint64_t spinHits;
+		// Time spent spinning, all of it on a CPU
+		uint64_t spinNanos;
+	} BusyPollStats;
+
+	/**
+	 * Options for busy polling a socket for up to micros: SO_BUSY_POLL and
+	 * SO_PREFER_BUSY_POLL where the kernel has them, and TCP_NODELAY and
+	 * TCP_QUICKACK so that neither end holds back small packets.
+	 */
+	std::vector<SocketOption> getBusyPollOptions(int micros);
+
+	/**
+	 * Waits for data on a socket by spinning on a non-blocking recv for a
+	 * while, and only then sleeping in epoll. When packets come often, as
+	 * frames do, most arrive while spinning, saving the time taken to wake a
+	 * sleeping thread, at the cost of keeping a CPU busy. Only on Linux.
+	 */
+	class BusyPoller {
+		public:
+			BusyPoller();
+			~BusyPoller();
+
+			/**
+			 * Starts polling fd, spinning for up to spinMicros each wait. The
+			 * socket itself stays blocking. Returns false if polling isn't
+			 * possible here.
+			 */
+			bool Attach(int fd, int spinMicros);
+			void Detach();
+			inline bool IsAttached() const { return fd >= 0; }
+
+			/**
+			 * Waits until fd can be read without blocking, or timeout ms
+			 * pass (-1 to wait forever). Returns false on timeout.
+			 */
+			bool Wait(int timeout);
+
+			inline const BusyPollStats &GetStats() const { return stats; }
+
+		private:
+			int fd, epollFd;
+			uint64_t spinNanos;
+			BusyPollStats stats;
+
+			// Whether the next read won't block: there is data, the end of
+			// the stream, or an error
+			bool Readable() const;
+			void QuickAck() const;
+	};
+};
+
+#endif
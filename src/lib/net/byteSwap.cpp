@@ -0,0 +1,138 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "byteSwap.hpp"
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SWAP_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SWAP_BIG_ENDIAN
+#endif
+
+using namespace droidpad::decode;
+
+static void ntohWordsScalar(void *dest, const void *src, size_t words) {
+#ifdef SWAP_BIG_ENDIAN
+	memmove(dest, src, words * 4);
+#else
+	const uint8_t *in = (const uint8_t *)src;
+	uint8_t *out = (uint8_t *)dest;
+	for(size_t i = 0; i < words; i++, in += 4, out += 4) {
+		uint32_t word;
+		memcpy(&word, in, 4);
+#ifdef __GNUC__
+		word = __builtin_bswap32(word);
+#else
+		word = (word >> 24) | ((word >> 8) & 0xff00) |
+			((word << 8) & 0xff0000) | (word << 24);
+#endif
+		memcpy(out, &word, 4);
+	}
+#endif
+}
+
+#if defined(SWAP_X86) && !defined(SWAP_BIG_ENDIAN)
+// Reverses the bytes of each 32-bit word, for pshufb
+#define WORD_SWAP_MASK_128 \
+	_mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3)
+
+__attribute__((target("ssse3")))
+static void ntohWordsSSSE3(void *dest, const void *src, size_t words) {
+	const __m128i mask = WORD_SWAP_MASK_128;
+	const char *in = (const char *)src;
+	char *out = (char *)dest;
+	size_t i = 0;
+	// One RawBinaryElement per iteration
+	for(; i + 4 <= words; i += 4, in += 16, out += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)in);
+		_mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(v, mask));
+	}
+	ntohWordsScalar(out, in, words - i);
+}
+
+__attribute__((target("avx2")))
+static void ntohWordsAVX2(void *dest, const void *src, size_t words) {
+	// pshufb on 256 bits works within each 128-bit lane, so the mask repeats
+	const __m256i mask = _mm256_broadcastsi128_si256(WORD_SWAP_MASK_128);
+	const char *in = (const char *)src;
+	char *out = (char *)dest;
+	size_t i = 0;
+	// Two elements per iteration
+	for(; i + 8 <= words; i += 8, in += 32, out += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)in);
+		_mm256_storeu_si256((__m256i *)out, _mm256_shuffle_epi8(v, mask));
+	}
+	if(i + 4 <= words) {
+		__m128i v = _mm_loadu_si128((const __m128i *)in);
+		_mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(v, WORD_SWAP_MASK_128));
+		i += 4, in += 16, out += 16;
+	}
+	ntohWordsScalar(out, in, words - i);
+}
+#define SWAP_VECTOR
+#endif
+
+SwapKernel droidpad::decode::getSwapKernel(int kernel) {
+	switch(kernel) {
+		case SWAP_SCALAR:
+			return ntohWordsScalar;
+#ifdef SWAP_VECTOR
+		case SWAP_SSSE3:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("ssse3") ? ntohWordsSSSE3 : NULL;
+		case SWAP_AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") ? ntohWordsAVX2 : NULL;
+#endif
+		default:
+			return NULL;
+	}
+}
+
+const char *droidpad::decode::getSwapKernelName(int kernel) {
+	switch(kernel) {
+		case SWAP_SCALAR:	return "scalar";
+		case SWAP_SSSE3:	return "ssse3";
+		case SWAP_AVX2:		return "avx2";
+		default:		return "unknown";
+	}
+}
+
+static int chooseSwapKernel() {
+	for(int kernel = SWAP_KERNELS - 1; kernel > SWAP_SCALAR; kernel--)
+		if(getSwapKernel(kernel)) return kernel;
+	return SWAP_SCALAR;
+}
+
+static const int activeKernel = chooseSwapKernel();
+static const SwapKernel activeSwap = getSwapKernel(activeKernel);
+
+int droidpad::decode::getActiveSwapKernel() {
+	return activeKernel;
+}
+
+void droidpad::decode::ntohWords(void *dest, const void *src, size_t words) {
+	activeSwap(dest, src, words);
+}
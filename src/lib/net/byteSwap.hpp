@@ -0,0 +1,59 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_BYTE_SWAP_H
+#define DP_BYTE_SWAP_H
+
+#include <stddef.h>
+
+namespace droidpad {
+	namespace decode {
+		/**
+		 * Converts an array of 32-bit words from network to host byte order.
+		 * src and dest may be the same, but mustn't otherwise overlap.
+		 */
+		void ntohWords(void *dest, const void *src, size_t words);
+
+		typedef void (*SwapKernel)(void *dest, const void *src, size_t words);
+
+		/**
+		 * The implementations ntohWords chooses between. The fastest one the
+		 * CPU supports is picked when the program starts.
+		 */
+		enum {
+			SWAP_SCALAR = 0,
+			SWAP_SSSE3,
+			SWAP_AVX2,
+			SWAP_KERNELS,
+		};
+
+		/**
+		 * Returns the given implementation, or NULL if this build or CPU
+		 * can't run it. Used to compare them.
+		 */
+		SwapKernel getSwapKernel(int kernel);
+		const char *getSwapKernelName(int kernel);
+		/**
+		 * The implementation in use by ntohWords.
+		 */
+		int getActiveSwapKernel();
+	};
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "capture.hpp"
+
+#include <string.h>
+#include "mathUtil.hpp"
+#include "timing.hpp"
+#include "log.hpp"
+
+#ifdef OS_WIN32
+#include <winsock2.h>
+#endif
+
+using namespace droidpad;
+using namespace droidpad::capture;
+using namespace std;
+
+// Records longer than this can't be described by CaptureRecordHeader.length
+#define MAX_RECORD_LENGTH 0xFFFF
+
+CaptureWriter::CaptureWriter(const string &path) throw (runtime_error) :
+	used(0),
+	lastTime(monotonicNanos()),
+	remainder(0),
+	failed(false)
+{
+	file = fopen(path.c_str(), "wb");
+	if(!file) throw runtime_error("Couldn't open capture file for writing");
+
+	CaptureFileHeader header;
+	memset(&header, 0, sizeof(CaptureFileHeader));
+	memcpy(header.magic, CAPTURE_MAGIC, 4);
+	header.version = CAPTURE_VERSION;
+	HTON(header.version);
+	Append(&header, sizeof(CaptureFileHeader));
+}
+
+CaptureWriter::~CaptureWriter() {
+	Flush();
+	fclose(file);
+}
+
+void CaptureWriter::Write(int type, const char *data, size_t length, uint64_t timestamp) {
+	Write(type, data, length, NULL, 0, timestamp);
+}
+
+void CaptureWriter::Write(int type, const char *first, size_t firstLength,
+		const char *second, size_t secondLength, uint64_t timestamp) {
+	if(firstLength + secondLength > MAX_RECORD_LENGTH) {
+		LOGW("Capture record too long, skipping");
+		return;
+	}
+
+	// Deltas are stored in microseconds; carry the rounding over so that
+	// long captures don't drift.
+	uint64_t elapsed = (timestamp > lastTime ? timestamp - lastTime : 0) + remainder;
+	lastTime = timestamp;
+	remainder = elapsed % NANOS_PER_MICRO;
+	uint64_t delta = elapsed / NANOS_PER_MICRO;
+
+	CaptureRecordHeader header;
+	header.delta = delta > 0xFFFFFFFF ? 0xFFFFFFFF : delta;
+	header.length = firstLength + secondLength;
+	header.type = type;
+	header.reserved = 0;
+	HTON(header.delta);
+	header.length = htons(header.length);
+
+	Append(&header, sizeof(CaptureRecordHeader));
+	Append(first, firstLength);
+	if(second) Append(second, secondLength);
+}
+
+void CaptureWriter::Append(const void *data, size_t length) {
+	if(used + length > CAPTURE_BUFFER_SIZE) Flush();
+	memcpy(buffer + used, data, length);
+	used += length;
+}
+
+void CaptureWriter::Flush() {
+	if(used == 0) return;
+	if(fwrite(buffer, 1, used, file) != used && !failed) {
+		failed = true; // Only warn once
+		LOGW("Failed to write to capture file");
+	}
+	fflush(file);
+	used = 0;
+}
+
+CaptureReader::CaptureReader(const string &path) throw (runtime_error) :
+	time(0)
+{
+	file = fopen(path.c_str(), "rb");
+	if(!file) throw runtime_error("Couldn't open capture file");
+
+	CaptureFileHeader header;
+	if(fread(&header, sizeof(CaptureFileHeader), 1, file) != 1 ||
+			memcmp(header.magic, CAPTURE_MAGIC, 4) != 0) {
+		fclose(file);
+		throw runtime_error("Not a DroidPad capture file");
+	}
+	NTOH(header.version);
+	if(header.version != CAPTURE_VERSION) {
+		fclose(file);
+		throw runtime_error("Unsupported capture file version");
+	}
+}
+
+CaptureReader::~CaptureReader() {
+	fclose(file);
+}
+
+bool CaptureReader::Next(CaptureRecord &record) throw (runtime_error) {
+	CaptureRecordHeader header;
+	if(fread(&header, sizeof(CaptureRecordHeader), 1, file) != 1)
+		return false;
+	NTOH(header.delta);
+	header.length = ntohs(header.length);
+
+	time += (uint64_t)header.delta * NANOS_PER_MICRO;
+	record.type = header.type;
+	record.time = time;
+	record.data.resize(header.length);
+	if(header.length > 0 && fread(&record.data[0], header.length, 1, file) != 1)
+		throw runtime_error("Capture file truncated");
+	return true;
+}
@@ -0,0 +1,135 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_CAPTURE_H
+#define DP_CAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <stdexcept>
+
+#define CAPTURE_MAGIC "DPCP"
+#define CAPTURE_VERSION 1
+
+// Records are gathered in memory and written out in chunks of this size.
+#define CAPTURE_BUFFER_SIZE 65536
+
+namespace droidpad {
+	namespace capture {
+		/**
+		 * Types of record in a capture file
+		 */
+		enum {
+			// A binary DINF connection info block, as received
+			RECORD_INFO = 1,
+			// A binary DPAD header followed by its elements, as received
+			RECORD_FRAME,
+			// A line of the text protocol, without the trailing newline
+			RECORD_TEXT,
+			// A DPD2 delta frame, as received
+			RECORD_DELTA,
+		};
+
+		/**
+		 * Start of every capture file. All fields are in network byte order.
+		 */
+		typedef struct {
+			char magic[4];
+			uint32_t version;
+			uint32_t reserved[2];
+		} CaptureFileHeader;
+
+		/**
+		 * Precedes each record. All fields are in network byte order.
+		 */
+		typedef struct {
+			// Microseconds since the previous record (or since the file was opened)
+			uint32_t delta;
+			uint16_t length;
+			uint8_t type;
+			uint8_t reserved;
+		} CaptureRecordHeader;
+
+		class CaptureRecord {
+			public:
+				int type;
+				// Monotonic receive time, in nanoseconds since the capture was opened
+				uint64_t time;
+				std::string data;
+		};
+
+		/**
+		 * Writes the raw bytes received from the phone to a capture file.
+		 * Records are buffered, so this is cheap enough to call from the receive loop.
+		 * Not thread safe - each connection should be read from one thread anyway.
+		 */
+		class CaptureWriter {
+			public:
+				CaptureWriter(const std::string &path) throw (std::runtime_error);
+				~CaptureWriter();
+
+				/**
+				 * Appends a record. timestamp is from monotonicNanos().
+				 */
+				void Write(int type, const char *data, size_t length, uint64_t timestamp);
+				/**
+				 * Appends a record made of two pieces, eg. a header and its elements.
+				 */
+				void Write(int type, const char *first, size_t firstLength,
+						const char *second, size_t secondLength, uint64_t timestamp);
+
+				/**
+				 * Writes any buffered records out to the file.
+				 */
+				void Flush();
+			private:
+				FILE *file;
+				char buffer[CAPTURE_BUFFER_SIZE];
+				size_t used;
+
+				// Time of the last record, as passed to Write.
+				uint64_t lastTime;
+				// Fractional microseconds not yet accounted for in the deltas.
+				uint64_t remainder;
+				bool failed;
+
+				void Append(const void *data, size_t length);
+		};
+
+		/**
+		 * Reads records back from a capture file.
+		 */
+		class CaptureReader {
+			public:
+				CaptureReader(const std::string &path) throw (std::runtime_error);
+				~CaptureReader();
+
+				/**
+				 * Reads the next record. Returns false at the end of the file.
+				 */
+				bool Next(CaptureRecord &record) throw (std::runtime_error);
+			private:
+				FILE *file;
+				uint64_t time;
+		};
+	};
+};
+
+#endif
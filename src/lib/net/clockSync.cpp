@@ -0,0 +1,130 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "clockSync.hpp"
+
+#include <string.h>
+
+// Skew is only estimated from exchanges spanning at least this long
+#define SKEW_MIN_SPAN (2 * NANOS_PER_SEC)
+// Phone clocks are assumed to be no worse than this, in parts per million
+#define SKEW_MAX_PPM 500
+
+using namespace droidpad::decode;
+
+ClockSync::ClockSync() :
+	numSamples(0),
+	nextSample(0),
+	referenceTime(0),
+	offset(0),
+	skew(0),
+	roundTrip(0)
+{ }
+
+void ClockSync::AddExchange(uint64_t localSend, uint64_t remoteReceive,
+		uint64_t remoteSend, uint64_t localReceive) {
+	// Nonsense exchanges, such as replies from a previous connection
+	if(localReceive < localSend || remoteSend < remoteReceive) return;
+	uint64_t remoteTime = remoteSend - remoteReceive;
+	uint64_t localTime = localReceive - localSend;
+	if(remoteTime > localTime) return;
+
+	Sample &sample = samples[nextSample];
+	sample.local = localSend + localTime / 2;
+	sample.offset = ((int64_t)(remoteReceive - localSend) + (int64_t)(remoteSend - localReceive)) / 2;
+	sample.delay = localTime - remoteTime;
+	nextSample = (nextSample + 1) % CLOCK_SYNC_SAMPLES;
+	if(numSamples < CLOCK_SYNC_SAMPLES) numSamples++;
+
+	// The offset is taken from the best exchange
+	const Sample *best = &samples[0];
+	uint64_t earliest = samples[0].local, latest = samples[0].local;
+	for(int i = 1; i < numSamples; i++) {
+		if(samples[i].delay < best->delay) best = &samples[i];
+		if(samples[i].local < earliest) earliest = samples[i].local;
+		if(samples[i].local > latest) latest = samples[i].local;
+	}
+	referenceTime = best->local;
+	offset = best->offset;
+	roundTrip = best->delay;
+
+	// Skew is fitted through the good exchanges, by least squares
+	if(latest - earliest < SKEW_MIN_SPAN) return;
+	uint64_t threshold = best->delay * 2 + 100 * NANOS_PER_MICRO;
+	double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+	for(int i = 0; i < numSamples; i++) {
+		if(samples[i].delay > threshold) continue;
+		double x = (double)(int64_t)(samples[i].local - referenceTime);
+		double y = (double)(samples[i].offset - offset);
+		n++;
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+	}
+	double denominator = n * sxx - sx * sx;
+	if(n < 3 || denominator <= 0) return;
+	skew = (n * sxy - sx * sy) / denominator;
+	if(skew > SKEW_MAX_PPM / 1e6) skew = SKEW_MAX_PPM / 1e6;
+	if(skew < -SKEW_MAX_PPM / 1e6) skew = -SKEW_MAX_PPM / 1e6;
+}
+
+uint64_t ClockSync::ToLocal(uint64_t remoteTime) const {
+	// Near enough the local time to work out the drift since the reference
+	uint64_t local = remoteTime - offset;
+	double drift = skew * (double)(int64_t)(local - referenceTime);
+	return local - (int64_t)drift;
+}
+
+FrameTimingStats::FrameTimingStats() {
+	memset(this, 0, sizeof(FrameTimingStats));
+}
+
+FrameTimer::FrameTimer() :
+	haveSequence(false),
+	lastSequence(0)
+{ }
+
+uint64_t FrameTimer::Frame(const RawBinaryHeader &header, uint64_t receiveTime, const ClockSync &clock) {
+	stats.frames++;
+	if(!(header.flags & HEADER_FLAG_TIMESTAMPED)) return 0;
+
+	uint32_t sequence = header.raw.rx;
+	if(haveSequence) {
+		uint32_t step = sequence - lastSequence;
+		if(step == 0 || step > 0x80000000) {
+			stats.reordered++;
+		} else {
+			stats.lost += step - 1;
+			lastSequence = sequence;
+		}
+	} else {
+		lastSequence = sequence;
+		haveSequence = true;
+	}
+
+	if(!clock.IsSynced()) return 0;
+	uint64_t sendTime = clock.ToLocal(joinMicros(header.raw.ry, header.raw.rz));
+	uint64_t latency = receiveTime > sendTime ? receiveTime - sendTime : 0;
+	if(stats.latencyFrames == 0 || latency < stats.minLatency) stats.minLatency = latency;
+	if(latency > stats.maxLatency) stats.maxLatency = latency;
+	stats.totalLatency += latency;
+	stats.latencyFrames++;
+	return sendTime;
+}
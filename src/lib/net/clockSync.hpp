@@ -0,0 +1,128 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_CLOCK_SYNC_H
+#define DP_CLOCK_SYNC_H
+
+#include <stdint.h>
+
+#include "net/protocol.hpp"
+#include "timing.hpp"
+
+// Exchanges kept to estimate the clock offset from
+#define CLOCK_SYNC_SAMPLES 16
+// Pings are sent this often once synchronised, and more often before
+#define PING_INTERVAL (1000 * NANOS_PER_MILLI)
+#define PING_INTERVAL_INITIAL (100 * NANOS_PER_MILLI)
+
+namespace droidpad {
+	namespace decode {
+		/**
+		 * Estimates the offset and skew between the phone's clock and ours from
+		 * ping exchanges, as NTP does: the exchanges with the shortest round
+		 * trip give the most accurate offsets, since they had the least time
+		 * to be delayed asymmetrically.
+		 */
+		class ClockSync {
+			public:
+				ClockSync();
+
+				/**
+				 * Adds a ping exchange. Local times are monotonicNanos, remote
+				 * times the phone's clock in nanoseconds.
+				 */
+				void AddExchange(uint64_t localSend, uint64_t remoteReceive,
+						uint64_t remoteSend, uint64_t localReceive);
+
+				inline bool IsSynced() const { return numSamples > 0; }
+
+				/**
+				 * Converts a time on the phone's clock to our clock.
+				 */
+				uint64_t ToLocal(uint64_t remoteTime) const;
+
+				// Remote minus local, in nanoseconds, at the reference time
+				inline int64_t GetOffset() const { return offset; }
+				// Change in offset per nanosecond
+				inline double GetSkew() const { return skew; }
+				// Round trip of the exchange the offset came from
+				inline uint64_t GetRoundTrip() const { return roundTrip; }
+
+			private:
+				typedef struct {
+					// Midpoint of the exchange
+					uint64_t local;
+					int64_t offset;
+					uint64_t delay;
+				} Sample;
+
+				Sample samples[CLOCK_SYNC_SAMPLES];
+				int numSamples, nextSample;
+
+				uint64_t referenceTime;
+				int64_t offset;
+				double skew;
+				uint64_t roundTrip;
+		};
+
+		class FrameTimingStats {
+			public:
+				FrameTimingStats();
+
+				uint64_t frames;
+				// Frames missing from the sequence, and frames arriving after a later one
+				uint64_t lost, reordered;
+				// One way latency, in nanoseconds, of frames sent once the clocks
+				// were synchronised
+				uint64_t latencyFrames, totalLatency, minLatency, maxLatency;
+		};
+
+		/**
+		 * Follows the sequence numbers and send times of timestamped frames.
+		 */
+		class FrameTimer {
+			public:
+				FrameTimer();
+
+				/**
+				 * Records a frame, given in host byte order, which arrived at
+				 * receiveTime. Returns when it was sent on our clock, or 0 if the
+				 * frame isn't timestamped or the clocks aren't synchronised yet.
+				 */
+				uint64_t Frame(const RawBinaryHeader &header, uint64_t receiveTime, const ClockSync &clock);
+
+				inline const FrameTimingStats &GetStats() const { return stats; }
+				inline void ResetStats() { stats = FrameTimingStats(); }
+
+			private:
+				bool haveSequence;
+				uint32_t lastSequence;
+				FrameTimingStats stats;
+		};
+
+		/**
+		 * Joins the two halves of a timestamp, giving nanoseconds.
+		 */
+		inline uint64_t joinMicros(uint32_t high, uint32_t low) {
+			return (((uint64_t)high << 32) | low) * 1000;
+		}
+	};
+};
+
+#endif
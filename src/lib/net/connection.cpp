@@ -23,18 +23,144 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include "include/platformSettings.hpp"
 #include "hexdump.h"
 
 #include "log.hpp"
+#include "timing.hpp"
+#include "mathUtil.hpp"
+#include "data.hpp"
+#include "socketOptions.hpp"
 
 using namespace droidpad;
 using namespace droidpad::decode;
 using namespace std;
 
+Connection::Connection() :
+	capture(NULL),
+	connectionTimeout(Data::connectionTimeout),
+	nextPingId(0),
+	nextPingTime(0),
+	nextStatsTime(0),
+	nextHeartbeatTime(0),
+	busyPoll(Data::busyPoll),
+	prevPollStatsTime(0)
+{
+	memset(pings, 0, sizeof(pings));
+	memset(&prevPollStats, 0, sizeof(prevPollStats));
+}
+
+// Interval between timing statistics in the log
+#define TIMING_STATS_INTERVAL (10 * NANOS_PER_SEC)
+
+void Connection::LimitTimeoutToHeartbeats() {
+	if(connectionTimeout > 0 && !mode.supportsHeartbeat) {
+		LOGV("Phone doesn't accept heartbeats, so waiting for it without a timeout");
+		connectionTimeout = 0;
+	}
+}
+
+const DPJSData Connection::NoInput() {
+	DPJSData data;
+	data.noInput = true;
+	return data;
+}
+
+const DPJSData Connection::DecodeFrame(const RawBinaryHeader &header, const vector<RawBinaryElement> &elems) {
+	uint64_t receiveTime = monotonicNanos();
+	DPJSData data = decodePlan.Decode(header, elems);
+	data.senderTime = frameTimer.Frame(header, receiveTime, clockSync);
+
+	// Only phones which say what their gyro values are get the fused tilt
+	if(mode.supportsGyroAngles)
+		tiltFilter.Apply(header, data.senderTime != 0 ? data.senderTime : receiveTime, data);
+
+	const FrameTimingStats &stats = frameTimer.GetStats();
+	if(receiveTime >= nextStatsTime && stats.latencyFrames > 0) {
+		if(nextStatsTime != 0)
+			LOGVwx(wxString::Format(wxT("Frames: %.0f, %.0f lost, %.0f reordered; latency %.2fms (%.2f - %.2fms)"),
+					(double)stats.frames, (double)stats.lost, (double)stats.reordered,
+					(double)stats.totalLatency / stats.latencyFrames / NANOS_PER_MILLI,
+					(double)stats.minLatency / NANOS_PER_MILLI,
+					(double)stats.maxLatency / NANOS_PER_MILLI));
+		nextStatsTime = receiveTime + TIMING_STATS_INTERVAL;
+	}
+	if(poller.IsAttached() && receiveTime >= prevPollStatsTime + TIMING_STATS_INTERVAL) {
+		const BusyPollStats &pollStats = poller.GetStats();
+		uint64_t waits = pollStats.waits - prevPollStats.waits;
+		if(prevPollStatsTime != 0 && waits > 0)
+			LOGVwx(wxString::Format(wxT("Busy poll: %.0f%% of packets caught spinning, %.1fus spun per packet, %.1f%% of a CPU"),
+					(double)(pollStats.spinHits - prevPollStats.spinHits) * 100 / waits,
+					(double)(pollStats.spinNanos - prevPollStats.spinNanos) / waits / NANOS_PER_MICRO,
+					(double)(pollStats.spinNanos - prevPollStats.spinNanos) * 100 / (receiveTime - prevPollStatsTime)));
+		prevPollStats = pollStats;
+		prevPollStatsTime = receiveTime;
+	}
+	return data;
+}
+
+void Connection::StartBusyPoll(int fd) {
+	if(busyPoll <= 0) return;
+	if(fd >= 0 && poller.Attach(fd, busyPoll))
+		LOGVwx(wxString::Format(wxT("Busy polling for up to %dus per packet"), busyPoll));
+	else
+		LOGW("Busy polling isn't available, waiting for packets as normal");
+}
+
+bool Connection::BusyWait() {
+	if(poller.Wait(connectionTimeout > 0 ? connectionTimeout : -1)) return true;
+	LOGVwx(wxString::Format(wxT("Nothing received from the phone for %dms"), connectionTimeout));
+	return false;
+}
+
+void Connection::PingIfDue() throw (runtime_error) {
+	uint64_t now = monotonicNanos();
+	if(now < nextPingTime) return;
+	// Ping more often at first, to synchronise quickly
+	nextPingTime = now + (nextPingId < CLOCK_SYNC_SAMPLES / 2 ? PING_INTERVAL_INITIAL : PING_INTERVAL);
+
+	uint32_t id = nextPingId++;
+	pings[id % PINGS_OUTSTANDING].id = id;
+	pings[id % PINGS_OUTSTANDING].time = now;
+	SendPing(id);
+}
+
+void Connection::HeartbeatIfDue() throw (runtime_error) {
+	if(!mode.supportsHeartbeat || connectionTimeout <= 0) return;
+	uint64_t now = monotonicNanos();
+	if(now < nextHeartbeatTime) return;
+	nextHeartbeatTime = now + connectionTimeout * NANOS_PER_MILLI / HEARTBEATS_PER_TIMEOUT;
+	SendHeartbeat();
+}
+
+void Connection::HandlePong(const char *data) {
+	uint64_t now = monotonicNanos();
+	BinaryPong pong;
+	memcpy(&pong, data, sizeof(BinaryPong));
+	NTOH(pong.id);
+	NTOH(pong.receiveHigh);
+	NTOH(pong.receiveLow);
+	NTOH(pong.sendHigh);
+	NTOH(pong.sendLow);
+
+	if(pings[pong.id % PINGS_OUTSTANDING].id != pong.id || pings[pong.id % PINGS_OUTSTANDING].time == 0)
+		return; // Too old, or never sent
+	uint64_t sent = pings[pong.id % PINGS_OUTSTANDING].time;
+	pings[pong.id % PINGS_OUTSTANDING].time = 0;
+	clockSync.AddExchange(sent,
+			joinMicros(pong.receiveHigh, pong.receiveLow),
+			joinMicros(pong.sendHigh, pong.sendLow), now);
+}
+
 ModeSetting::ModeSetting() :
 	initialised(false),
 	supportsBinary(false),
+	supportsDelta(false),
+	supportsTimestamps(false),
+	supportsHeartbeat(false),
+	supportsGyroAngles(false),
 	type(MODE_JS),
 	numRawAxes(0),
 	numAxes(0),
@@ -47,10 +173,11 @@ DPConnection::DPConnection(AndroidDevice &device) :
 	addr.Hostname(device.ip);
 	addr.Service(device.port);
 	
-	SetTimeout(10);
+	SetTimeout(CONN_WX_TIMEOUT);
 }
 
 DPConnection::~DPConnection() {
+	poller.Detach();
 	SendMessage("<STOP>\n");
 	LOGV("Sent Stop message to server");
 	Close();
@@ -65,27 +192,61 @@ int DPConnection::Start()
 		LOGEwx(wxT("Error getting mode info: ") + wxString(err.what(), wxConvUTF8));
 		return START_HANDSHAKEERROR;
 	}
+	LimitTimeoutToHeartbeats();
+	if(connectionTimeout > 0) {
+		vector<SocketOption> options = getLivenessOptions(connectionTimeout);
+		for(vector<SocketOption>::iterator it = options.begin(); it != options.end(); it++)
+			SetOption(it->level, it->name, &it->value, sizeof(int));
+	}
+	StartBusyPoll(SocketFd());
 	return START_SUCCESS;
 }
 
+int DPConnection::SocketFd() {
+#if wxCHECK_VERSION(2, 9, 0)
+	return GetSocket();
+#else
+	// wx 2.8 doesn't give out the socket
+	return -1;
+#endif
+}
+
 void DPConnection::SendMessage(string message) {
 	Write(message.c_str(), message.length());
 }
 
 wxString DPConnection::GetLine() throw (runtime_error) {
+	return wxString(GetRawLine().c_str(), wxConvUTF8);
+}
+
+string DPConnection::GetRawLine() throw (runtime_error) {
+	size_t returnPosition = WaitForLine();
+	string ret = inData.substr(0, returnPosition);
+	inData.erase(0, returnPosition + 1); // Trim old stuff off
+	return ret;
+}
+
+size_t DPConnection::WaitForLine() throw (runtime_error) {
 	size_t returnPosition;
 	while((returnPosition = inData.find('\n')) == string::npos) {
 		if(!ParseFromNet()) throw runtime_error("Connection closed");
 	}
-	wxString ret = wxString(inData.substr(0, returnPosition).c_str(), wxConvUTF8);
-	inData = inData.substr(returnPosition + 1); // Trim old stuff off
-	return ret;
+	if(capture) capture->Write(capture::RECORD_TEXT, inData.data(), returnPosition, monotonicNanos());
+	return returnPosition;
 }
 
 /**
  * Returns true if the parse was successful.
  */
 bool DPConnection::ParseFromNet() {
+	// Once the mode is known the phone streams continuously, so a silence
+	// means it has gone. The wx timeout is in whole seconds, so isn't used.
+	if(poller.IsAttached()) {
+		if(!BusyWait()) return false;
+	} else if(mode.initialised && connectionTimeout > 0 && !WaitForRead(0, connectionTimeout)) {
+		LOGVwx(wxString::Format(wxT("Nothing received from the phone for %dms"), connectionTimeout));
+		return false;
+	}
 	memset(buffer, 0, CONN_BUFFER_SIZE);
 	Read(buffer, CONN_BUFFER_SIZE);
 	inData.append(buffer, LastCount());
@@ -99,34 +260,34 @@ char DPConnection::PeekChar() throw (runtime_error) {
 	return inData[0];
 }
 
-string DPConnection::GetBytes(size_t n) {
+void DPConnection::WaitForBytes(size_t n) throw (runtime_error) {
 	while(inData.length() < n) {
 		if(!ParseFromNet()) throw runtime_error("Connection closed");
 	}
+}
+
+string DPConnection::GetBytes(size_t n) {
+	WaitForBytes(n);
 	string ret = inData.substr(0, n);
-	inData = inData.substr(n); // Trim old stuff off
+	inData.erase(0, n); // Trim old stuff off
 	return ret;
 }
 
-const ModeSetting &DPConnection::GetMode() throw (runtime_error)
+void ModeSetting::ParseSettingsLine(const wxString &line) throw (runtime_error)
 {
-	if(mode.initialised) return mode;
-	wxString line = GetLine();
-	cout << "Settings line: " << line.mb_str() << endl;
-
 	int mp1 = line.Find(wxT("<MODE>")) + 6;
 	int mp2 = line.Find(wxT("</MODE>"));
 	if(mp1 == wxNOT_FOUND || mp2 == wxNOT_FOUND) throw runtime_error("Couldn't parse settings - Mode");
 	wxString dpMode = line.Mid(mp1, mp2 - mp1);
 
 	if(dpMode.StartsWith(wxT("mouse"))) {
-		mode.type = MODE_MOUSE;
+		type = MODE_MOUSE;
 	} else if(dpMode.StartsWith(wxT("slide"))) {
-		mode.type = MODE_SLIDE;
+		type = MODE_SLIDE;
 	} else if(dpMode.StartsWith(wxT("absmouse"))) {
-		mode.type = MODE_ABSMOUSE;
+		type = MODE_ABSMOUSE;
 	} else {
-		mode.type = MODE_JS;
+		type = MODE_JS;
 	}
 
 	int sp1 = line.Find(wxT("<MODESPEC>")) + 10;
@@ -138,21 +299,48 @@ const ModeSetting &DPConnection::GetMode() throw (runtime_error)
 	if(!tkz.HasMoreTokens()) throw runtime_error("Couldn't parse settings - Specs are wrong length (0)");
 	long numRawAxes;
 	tkz.GetNextToken().ToLong(&numRawAxes);
-	mode.numRawAxes = numRawAxes;
+	this->numRawAxes = numRawAxes;
 
 	if(!tkz.HasMoreTokens()) throw runtime_error("Couldn't parse settings - Specs are wrong length (1)");
 	long numAxes;
 	tkz.GetNextToken().ToLong(&numAxes);
-	mode.numAxes = numAxes;
+	this->numAxes = numAxes;
 
 	if(!tkz.HasMoreTokens()) throw runtime_error("Couldn't parse settings - Specs are wrong length (2)");
 	long numButtons;
 	tkz.GetNextToken().ToLong(&numButtons);
-	mode.numButtons = numButtons;
+	this->numButtons = numButtons;
 
-	mode.supportsBinary = line.Contains(wxT("<SUPPORTSBINARY>"));
+	supportsBinary = line.Contains(wxT("<SUPPORTSBINARY>"));
+	supportsDelta = supportsBinary && line.Contains(wxT("<SUPPORTSDELTA>"));
+	supportsTimestamps = supportsBinary && line.Contains(wxT("<SUPPORTSTIMESTAMPS>"));
+	supportsHeartbeat = line.Contains(wxT("<SUPPORTSHEARTBEAT>"));
+	supportsGyroAngles = supportsBinary && line.Contains(wxT("<SUPPORTSGYROANGLES>"));
 
-	mode.initialised = true;
+	initialised = true;
+}
+
+void ModeSetting::SetConnectionInfo(const BinaryConnectionInfo &info)
+{
+	type = info.modeType;
+	numRawAxes = info.rawDevices;
+	numAxes = info.axes;
+	numButtons = info.buttons;
+	supportsBinary = true;
+	supportsDelta = info.capabilities & CAPABILITY_DELTA;
+	supportsTimestamps = info.capabilities & CAPABILITY_TIMESTAMPS;
+	supportsHeartbeat = info.capabilities & CAPABILITY_HEARTBEAT;
+	supportsGyroAngles = info.capabilities & CAPABILITY_GYRO_ANGLES;
+	initialised = true;
+}
+
+const ModeSetting &DPConnection::GetMode() throw (runtime_error)
+{
+	if(mode.initialised) return mode;
+	wxString line = GetLine();
+	cout << "Settings line: " << line.mb_str() << endl;
+
+	mode.ParseSettingsLine(line);
 	return mode;
 }
 
@@ -172,25 +360,53 @@ AXES LAYOUTS
 */
 const DPJSData DPConnection::GetData() throw (runtime_error)
 {
+	HeartbeatIfDue();
+	if(mode.supportsTimestamps) PingIfDue();
 	char first = PeekChar();
 	switch(first) {
-		case '[': // Indicates text
+		case '[': { // Indicates text
 #ifdef DEBUG
 			LOGM("WARNING: still using old message format!");
 #endif
-			return getTextData(GetLine());
-		case 'D': { // Binary header begins "DPAD"
-			RawBinaryHeader header = getBinaryHeader(GetBytes(sizeof(RawBinaryHeader)).c_str());
+			// Parsed straight from the receive buffer
+			size_t length = WaitForLine();
+			DPJSData data = getTextData(inData.data(), length);
+			inData.erase(0, length + 1);
+			return data;
+		}
+		case 'D': { // Binary header begins "DPAD", delta frames "DPD2"
+			WaitForBytes(sizeof(BinarySignature));
+			if(((BinarySignature *)inData.data())->isPong()) {
+				WaitForBytes(sizeof(BinaryPong));
+				HandlePong(inData.data());
+				inData.erase(0, sizeof(BinaryPong));
+				return NoInput();
+			}
+			if(((BinarySignature *)inData.data())->isDeltaFrame()) {
+				WaitForBytes(sizeof(DeltaFrameHeader));
+				size_t length = getDeltaFrameLength(inData.data());
+				WaitForBytes(length);
+				if(capture) capture->Write(capture::RECORD_DELTA, inData.data(), length, monotonicNanos());
+				RawBinaryHeader header;
+				vector<RawBinaryElement> elems;
+				bool decoded = deltaDecoder.Decode(inData.data(), length, header, elems);
+				inData.erase(0, length);
+				if(!decoded) {
+					LOGW("Couldn't decode delta frame, waiting for keyframe");
+					return NoInput();
+				}
+				return DecodeFrame(header, elems);
+			}
+			string headerData = GetBytes(sizeof(RawBinaryHeader));
+			RawBinaryHeader header = getBinaryHeader(headerData.c_str());
 			int remainingSize = sizeof(RawBinaryElement) * header.numElements;
 
 			// Iterate through data, parsing each element.
 			string elemData = GetBytes(remainingSize);
-			const char *start = elemData.c_str();
-			vector<RawBinaryElement> elems;
-			for(const char *elem = start; elem < start + remainingSize; elem += sizeof(RawBinaryElement)) {
-				elems.push_back(getBinaryElement(elem));
-			}
-			return getBinaryData(header, elems);
+			if(capture) capture->Write(capture::RECORD_FRAME,
+					headerData.c_str(), headerData.size(),
+					elemData.c_str(), elemData.size(), monotonicNanos());
+			return DecodeFrame(header, getBinaryElements(elemData.c_str(), header.numElements));
 			  }
 		case '<': // Config settings. Parse line, then ignore.
 			GetLine();
@@ -203,10 +419,25 @@ const DPJSData DPConnection::GetData() throw (runtime_error)
 #endif
 			  break;
 	}
-	return DPJSData();
+	return NoInput();
 }
 
 void DPConnection::RequestBinary() throw (std::runtime_error) {
 	SendMessage("<BINARY>\n");
 	LOGV("Binary request sent to server");
 }
+
+void DPConnection::RequestDelta() throw (std::runtime_error) {
+	SendMessage("<DELTA>\n");
+	LOGV("Delta request sent to server");
+}
+
+void DPConnection::SendHeartbeat() throw (std::runtime_error) {
+	SendMessage("<HEARTBEAT>\n");
+}
+
+void DPConnection::SendPing(uint32_t id) throw (std::runtime_error) {
+	char message[32];
+	snprintf(message, sizeof(message), "<PING>%u</PING>\n", id);
+	SendMessage(message);
+}
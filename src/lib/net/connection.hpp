@@ -27,11 +27,22 @@
 #include <stdint.h>
 
 #include "dataDecode.hpp"
+#include "deltaFrame.hpp"
+#include "clockSync.hpp"
+#include "tiltFilter.hpp"
+#include "busyPoll.hpp"
+#include "capture.hpp"
 #include "droidpadCallbacks.hpp"
 
 // Small buffer to allow faster reading & less overflow?
 #define CONN_BUFFER_SIZE 64
 
+// Timeout of wx socket operations, in seconds
+#define CONN_WX_TIMEOUT 10
+
+// Pings awaiting a reply; older ones are forgotten
+#define PINGS_OUTSTANDING 8
+
 namespace droidpad {
 	class ModeSetting {
 		public:
@@ -42,13 +53,32 @@ namespace droidpad {
 			int numButtons;
 
 			bool supportsBinary;
+			// Whether DPD2 delta frames can be requested
+			bool supportsDelta;
+			// Whether the phone answers pings
+			bool supportsTimestamps;
+			// Whether heartbeats can be sent to the phone
+			bool supportsHeartbeat;
+			// Whether the gyro angles can be fused into the tilt
+			bool supportsGyroAngles;
 
 			ModeSetting();
+
+			/**
+			 * Reads the mode from a text protocol settings line, ie.
+			 * <MODE>...</MODE><MODESPEC>...</MODESPEC>
+			 */
+			void ParseSettingsLine(const wxString &line) throw (std::runtime_error);
+			/**
+			 * Reads the mode from a binary DINF block.
+			 */
+			void SetConnectionInfo(const decode::BinaryConnectionInfo &info);
 	};
 
 	// Interface for a connection of some type
 	class Connection {
 		public:
+			Connection();
 			virtual int Start() = 0;
 			inline virtual ~Connection() { }
 
@@ -56,6 +86,22 @@ namespace droidpad {
 			virtual const decode::DPJSData GetData() throw (std::runtime_error) = 0;
 
 			virtual void RequestBinary() throw (std::runtime_error) = 0;
+			/**
+			 * Asks the phone to send delta frames. Only valid if the mode
+			 * says it supports them.
+			 */
+			virtual void RequestDelta() throw (std::runtime_error) = 0;
+
+			/**
+			 * Sets a writer which all data received from the phone is copied to.
+			 * Ownership is not taken; NULL stops capturing.
+			 */
+			inline void SetCapture(capture::CaptureWriter *writer) { capture = writer; }
+
+			/**
+			 * Sequence and latency statistics of timestamped frames.
+			 */
+			inline const decode::FrameTimingStats &GetTimingStats() const { return frameTimer.GetStats(); }
 
 			enum {
 				START_SUCCESS = 0,
@@ -67,6 +113,80 @@ namespace droidpad {
 		protected:
 
 			ModeSetting mode;
+
+			/**
+			 * Returned by GetData when what was received isn't input.
+			 */
+			static const decode::DPJSData NoInput();
+
+			capture::CaptureWriter *capture;
+
+			// Decodes binary frames from this phone
+			decode::DecodePlan decodePlan;
+			decode::DeltaDecoder deltaDecoder;
+
+			decode::ClockSync clockSync;
+			decode::FrameTimer frameTimer;
+			decode::TiltFilter tiltFilter;
+
+			/**
+			 * Decodes a binary frame, filling in when it was sent if it is timestamped.
+			 */
+			const decode::DPJSData DecodeFrame(const decode::RawBinaryHeader &header,
+					const std::vector<decode::RawBinaryElement> &elems);
+
+			/**
+			 * Sends a ping if one is due. Should only be called if the phone
+			 * supports timestamps.
+			 */
+			void PingIfDue() throw (std::runtime_error);
+			virtual void SendPing(uint32_t id) throw (std::runtime_error) = 0;
+			/**
+			 * Handles a DPNG reply, as received.
+			 */
+			void HandlePong(const char *pong);
+
+			// Time after which a silent phone is treated as lost, in ms; 0 to wait forever
+			int connectionTimeout;
+			/**
+			 * Called once the mode is known. Only phones which take
+			 * heartbeats are known to keep sending while idle, so others
+			 * are waited for forever.
+			 */
+			void LimitTimeoutToHeartbeats();
+			/**
+			 * Sends a heartbeat if one is due and the phone accepts them.
+			 */
+			void HeartbeatIfDue() throw (std::runtime_error);
+			virtual void SendHeartbeat() throw (std::runtime_error) = 0;
+
+			// Time to spin waiting for each packet, in us; 0 not to. Taken
+			// when the connection is made, so each session can differ.
+			int busyPoll;
+			// Attached to the socket once streaming starts, if busyPoll is set
+			BusyPoller poller;
+			/**
+			 * Starts busy polling fd, if this session should.
+			 */
+			void StartBusyPoll(int fd);
+			/**
+			 * Waits for data with the poller, for up to connectionTimeout.
+			 * Returns false if nothing arrived in time.
+			 */
+			bool BusyWait();
+
+		private:
+			struct {
+				uint32_t id;
+				uint64_t time;
+			} pings[PINGS_OUTSTANDING];
+			uint32_t nextPingId;
+			uint64_t nextPingTime;
+			uint64_t nextStatsTime;
+			uint64_t nextHeartbeatTime;
+			// Poller statistics when they were last logged
+			BusyPollStats prevPollStats;
+			uint64_t prevPollStatsTime;
 	};
 
 	class DPConnection : private wxSocketClient, public Connection {
@@ -76,16 +196,39 @@ namespace droidpad {
 
 			virtual int Start();
 
+		protected:
+			// Received, and not yet parsed
+			std::string inData;
+
+			/**
+			 * Receives more into inData. Returns false if the connection
+			 * was lost.
+			 */
+			virtual bool ParseFromNet();
+
+			/**
+			 * The socket, or -1 if wx can't give it out.
+			 */
+			int SocketFd();
+
 		private:
 			wxIPV4address addr;
 
-			std::string inData;
 			char buffer[CONN_BUFFER_SIZE];
 
 			void SendMessage(std::string message);
 
 			wxString GetLine() throw (std::runtime_error);
-			bool ParseFromNet();
+			std::string GetRawLine() throw (std::runtime_error);
+			/**
+			 * Waits until inData holds a whole line, and returns the position
+			 * of its newline. The line is left in inData.
+			 */
+			size_t WaitForLine() throw (std::runtime_error);
+			/**
+			 * Waits until inData holds at least n bytes.
+			 */
+			void WaitForBytes(size_t n) throw (std::runtime_error);
 
 			/**
 			 * Returns the first character from the buffer, to check if the data is binary or text
@@ -101,6 +244,11 @@ namespace droidpad {
 			virtual const decode::DPJSData GetData() throw (std::runtime_error);
 
 			virtual void RequestBinary() throw (std::runtime_error);
+			virtual void RequestDelta() throw (std::runtime_error);
+
+		protected:
+			virtual void SendPing(uint32_t id) throw (std::runtime_error);
+			virtual void SendHeartbeat() throw (std::runtime_error);
 	};
 };
 
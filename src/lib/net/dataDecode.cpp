@@ -28,8 +28,10 @@
 
 #include "data.hpp"
 #include "mathUtil.hpp"
+#include "byteSwap.hpp"
 
-#include <wx/tokenzr.h>
+#include <limits.h>
+#include <float.h>
 
 #ifdef OS_LINUX
 #include <arpa/inet.h>
@@ -47,7 +49,11 @@ using namespace std;
 using namespace droidpad;
 using namespace droidpad::decode;
 
-Vec2 droidpad::decode::accelToAxes(float x, float y, float z) {
+Vec2 droidpad::decode::accelToAngles(float x, float y, float z) {
+	return Vec2(atan2(x, sqrt(y * y + z * z)), atan2(y, z));
+}
+
+Vec2 droidpad::decode::anglesToAxes(const Vec2 &angles) {
 	// Here, we multiply each axis by a constant determined by the user.
 	// This effectively sets the range - the constant = 360 / (user range)
 	if(Data::tweaks.tilt[0].totalAngle == 0)
@@ -56,13 +62,13 @@ Vec2 droidpad::decode::accelToAxes(float x, float y, float z) {
 		Data::tweaks.tilt[1].totalAngle = 120;
 
 	float rangex = (float)360 / (float)Data::tweaks.tilt[0].totalAngle;
-	float ax = atan2(x, sqrt(y * y + z * z)) / M_PI;
+	float ax = angles.x / M_PI;
 	ax *= rangex;
 	trim(ax, -1, 1);
 	ax = applyGamma(ax, (float)-Data::tweaks.tilt[0].gamma / GAMMA_RANGE);
 
 	float rangey = (float)360 / (float)Data::tweaks.tilt[1].totalAngle;
-	float ay = atan2(y, z) / M_PI;
+	float ay = angles.y / M_PI;
 	ay *= rangey;
 	trim(ay, -1, 1);
 	ay = applyGamma(ay, (float)-Data::tweaks.tilt[1].gamma / GAMMA_RANGE);
@@ -70,26 +76,77 @@ Vec2 droidpad::decode::accelToAxes(float x, float y, float z) {
 	return Vec2(-ax * AXIS_SIZE, -ay * AXIS_SIZE);
 }
 
-float droidpad::decode::applyGamma(float value, float gamma) {
-	// Power applied to value must be in the range 1/n to n,
-	// where n is around 10.
-	float G = pow(GAMMA_CONST, gamma);
+Vec2 droidpad::decode::accelToAxes(float x, float y, float z) {
+	return anglesToAxes(accelToAngles(x, y, z));
+}
+
+// Power applied to value must be in the range 1/n to n,
+// where n is around 10.
+static inline float gammaExponent(float gamma) {
+	return pow(GAMMA_CONST, gamma);
+}
+
+static inline float applyGammaExponent(float value, float G) {
 	return sign(value) * pow(abs(value), G);
 }
 
+float droidpad::decode::applyGamma(float value, float gamma) {
+	return applyGammaExponent(value, gammaExponent(gamma));
+}
+
+/**
+ * The tweak which a slider written to axis dest takes its gamma from, which
+ * is that of the axis before it. NULL if there isn't one, as the phone can
+ * send more sliders than there are tweaks.
+ */
+static inline const int32_t *sliderGammaTweak(size_t dest) {
+	if(dest < 1 || dest > NUM_AXIS) return NULL;
+	return &Data::tweaks.onScreen[dest - 1].gamma;
+}
+
+/**
+ * Records in mask that the axis at index came from a sensor.
+ */
+static inline void markAxis(uint32_t &mask, size_t index) {
+	if(index < 32) mask |= 1u << index;
+}
+
+TouchContact::TouchContact() :
+	x(0),
+	y(0),
+	down(false)
+{ }
+
+TouchContact::TouchContact(int x, int y, bool down) :
+	x(x),
+	y(y),
+	down(down)
+{ }
+
 DPJSData::DPJSData() :
 	connectionClosed(false),
-	reset(false)
+	containsAccel(false),
+	containsGyro(false),
+	accelAxes(0),
+	gyroAxes(0),
+	reset(false),
+	noInput(false),
+	senderTime(0)
 { }
 
 DPJSData::DPJSData(const DPJSData& old) :
 	axes(old.axes),
 	touchpadAxes(old.touchpadAxes),
 	buttons(old.buttons),
-	connectionClosed(connectionClosed),
-	containsAccel(containsAccel),
-	containsGyro(containsGyro),
-	reset(reset)
+	contacts(old.contacts),
+	connectionClosed(old.connectionClosed),
+	containsAccel(old.containsAccel),
+	containsGyro(old.containsGyro),
+	accelAxes(old.accelAxes),
+	gyroAxes(old.gyroAxes),
+	reset(old.reset),
+	noInput(old.noInput),
+	senderTime(old.senderTime)
 { }
 
 void DPJSData::reorder(std::vector<int> bmap, std::vector<int> amap) {
@@ -108,41 +165,61 @@ void DPJSData::reorder(std::vector<int> bmap, std::vector<int> amap) {
 	}
 
 	vector<int> newAxes(axes.size());
+	uint32_t newAccelAxes = 0, newGyroAxes = 0;
 	for(int i = 0; i < axes.size(); i++) {
-		if(i >= amap.size()) { // Map doesn't do this part
-			newAxes[i] = axes[i];
-		} else {
-			int destination = amap[i];
-			if(destination >= newAxes.size()) { // Mapped to invalid space
-				// Do nothing
-			} else {
-				newAxes[destination] = axes[i];
-			}
+		int destination = i;
+		if(i < amap.size()) {
+			destination = amap[i];
+			if(destination < 0 || destination >= newAxes.size()) continue; // Mapped to invalid space
 		}
+		newAxes[destination] = axes[i];
+		if(i < 32 && (accelAxes & (1u << i))) markAxis(newAccelAxes, destination);
+		if(i < 32 && (gyroAxes & (1u << i))) markAxis(newGyroAxes, destination);
 	}
 	buttons = newButtons;
 	axes = newAxes;
+	accelAxes = newAccelAxes;
+	gyroAxes = newGyroAxes;
+}
+
+// Rounds towards minus infinity, so that positions either side of zero
+// are as far apart as anywhere else.
+static inline int floorDiv(int value, int divisor) {
+	return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+// The scroll wheel trackpad moves 50 units for each 120th of a notch. Both
+// deltas are differences of positions, so nothing is lost between frames.
+static inline void getScroll(int position, int prevPosition, int &scrollDelta, int &incrementalScrollDelta) {
+	scrollDelta = floorDiv(position, 50) - floorDiv(prevPosition, 50);
+	incrementalScrollDelta = (floorDiv(position, 50 * 120) - floorDiv(prevPosition, 50 * 120)) * 120;
 }
 
 DPMouseData::DPMouseData() :
 	x(0),
 	y(0),
 	scrollDelta(0),
+	incrementalScrollDelta(0),
 	bLeft(false),
 	bMiddle(false),
-	bRight(false)
+	bRight(false),
+	senderTime(0)
 { }
 
 DPMouseData::DPMouseData(const DPMouseData& old) :
 	x(old.x),
 	y(old.y),
 	scrollDelta(old.scrollDelta),
+	incrementalScrollDelta(old.incrementalScrollDelta),
 	bLeft(old.bLeft),
 	bMiddle(old.bMiddle),
-	bRight(old.bRight)
+	bRight(old.bRight),
+	senderTime(old.senderTime)
 { }
 
-DPMouseData::DPMouseData(const DPJSData& rawData, const DPJSData& prevData) {
+DPMouseData::DPMouseData(const DPJSData& rawData, const DPJSData& prevData) :
+	senderTime(rawData.senderTime)
+{
 	if(rawData.axes.size() < 2) {
 		x = 0;
 		y = 0;
@@ -151,18 +228,14 @@ DPMouseData::DPMouseData(const DPJSData& rawData, const DPJSData& prevData) {
 		y = -rawData.axes[1];
 	}
 	if(rawData.touchpadAxes.size() == 1 && prevData.touchpadAxes.size() == 1) {
-		incrementalScrollDelta = rawData.touchpadAxes[0] / (50 * 120) - prevData.touchpadAxes[0] / (50 * 120); // Scroll is last.
-		incrementalScrollDelta *= 120;
-		scrollDelta = rawData.touchpadAxes[0] / 50 - prevData.touchpadAxes[0] / 50;
+		getScroll(rawData.touchpadAxes[0], prevData.touchpadAxes[0], scrollDelta, incrementalScrollDelta); // Scroll is last.
 	} else if(rawData.touchpadAxes.size() >= 3 && prevData.touchpadAxes.size() >= 3) {
 		x = rawData.touchpadAxes[0] - prevData.touchpadAxes[0];
 		y = rawData.touchpadAxes[1] - prevData.touchpadAxes[1];
 		x *= 10;
 		y *= 10;
 
-		incrementalScrollDelta = rawData.touchpadAxes[2] / (50 * 120) - prevData.touchpadAxes[2] / (50 * 120); // Scroll is last.
-		incrementalScrollDelta *= 120;
-		scrollDelta = rawData.touchpadAxes[2] / 50 - prevData.touchpadAxes[2] / 50;
+		getScroll(rawData.touchpadAxes[2], prevData.touchpadAxes[2], scrollDelta, incrementalScrollDelta); // Scroll is last.
 	} else {
 		scrollDelta = 0;
 		incrementalScrollDelta = 0;
@@ -180,9 +253,11 @@ DPMouseData::DPMouseData(const DPJSData& rawData, const DPJSData& prevData) {
 
 DPTouchData::DPTouchData() :
 	scrollDelta(0),
+	incrementalScrollDelta(0),
 	bLeft(false),
 	bMiddle(false),
-	bRight(false)
+	bRight(false),
+	senderTime(0)
 { }
 
 DPTouchData::DPTouchData(const DPTouchData& old) :
@@ -193,10 +268,15 @@ DPTouchData::DPTouchData(const DPTouchData& old) :
 	bMiddle(old.bMiddle),
 	bRight(old.bRight),
 	xOffset(old.xOffset),
-	yOffset(old.yOffset)
+	yOffset(old.yOffset),
+	senderTime(old.senderTime)
 { }
 
-DPTouchData::DPTouchData(const DPJSData& rawData, const DPJSData& prevData, const DPTouchData& prevAbsData) {
+DPTouchData::DPTouchData(const DPJSData& rawData, const DPJSData& prevData, const DPTouchData& prevAbsData) :
+	scrollDelta(0),
+	incrementalScrollDelta(0),
+	senderTime(rawData.senderTime)
+{
 	if(rawData.containsAccel && rawData.containsGyro) {
 		x = rawData.axes[2]; // Gyro
 		if(rawData.reset)
@@ -215,9 +295,7 @@ DPTouchData::DPTouchData(const DPJSData& rawData, const DPJSData& prevData, cons
 	// y -= yOffset;
 
 	if(rawData.touchpadAxes.size() == 1 && prevData.touchpadAxes.size() == 1) {
-		incrementalScrollDelta = rawData.touchpadAxes[0] / (50 * 120) - prevData.touchpadAxes[0] / (50 * 120);
-		incrementalScrollDelta *= 120;
-		scrollDelta = rawData.touchpadAxes[0] / 50 - prevData.touchpadAxes[0] / 50;
+		getScroll(rawData.touchpadAxes[0], prevData.touchpadAxes[0], scrollDelta, incrementalScrollDelta);
 	}
 
 	if(rawData.buttons.size() >= 3) {
@@ -240,7 +318,8 @@ DPSlideData::DPSlideData() :
 	white(false),
 	black(false),
 	beginning(false),
-	end(false)
+	end(false),
+	senderTime(0)
 { }
 DPSlideData::DPSlideData(const DPSlideData& old) :
 	next(old.next),
@@ -250,10 +329,13 @@ DPSlideData::DPSlideData(const DPSlideData& old) :
 	white(old.white),
 	black(old.black),
 	beginning(old.beginning),
-	end(old.end)
+	end(old.end),
+	senderTime(old.senderTime)
 {
 }
-DPSlideData::DPSlideData(const DPJSData& rawData, const DPJSData& prevData) {
+DPSlideData::DPSlideData(const DPJSData& rawData, const DPJSData& prevData) :
+	senderTime(rawData.senderTime)
+{
 	if(rawData.buttons.size() >= 8) {
 		next	= rawData.buttons[0];
 		prev	= rawData.buttons[1];
@@ -268,104 +350,251 @@ DPSlideData::DPSlideData(const DPJSData& rawData, const DPJSData& prevData) {
 	}
 }
 
-const DPJSData droidpad::decode::getTextData(wxString line) {
-	DPJSData data;
+/*
+ * Text protocol parsing over raw bytes.
+ *
+ * This gives exactly the same results as the original parser, which used
+ * wxStringTokenizer and an istringstream per number (kept in the benchmarks
+ * as getTextDataReference), but in one pass and
+ * without allocating. The helpers below reproduce the corner cases of those:
+ * how the tokenizer treats empty tokens, and how istream reads numbers.
+ */
 
-	if(line.find(wxT("<STOP>")) != wxNOT_FOUND) {
-		data.connectionClosed = true;
-		return data;
-	} else data.connectionClosed = false;
+static inline bool isTextSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
 
-	int start = line.Find(wxT("[")) + 1;
-	int end = line.Find(wxT("]"));
+/**
+ * Splits [begin,end) on delim as wxStringTokenizer does by default: empty tokens
+ * are returned, except at the end, and a string of only delimiters gives one
+ * empty token. Call Next until it returns false.
+ */
+class TextTokenizer {
+	public:
+		TextTokenizer(const char *begin, const char *end, char delim) :
+			pos(begin),
+			end(end),
+			delim(delim),
+			lastReal(NULL)
+		{
+			for(const char *p = end; p > begin; p--) {
+				if(p[-1] != delim) {
+					lastReal = p - 1;
+					break;
+				}
+			}
+			onlyDelims = lastReal == NULL && begin != end;
+		}
+
+		bool Next(const char *&tokBegin, const char *&tokEnd) {
+			if(onlyDelims) {
+				onlyDelims = false;
+				tokBegin = tokEnd = pos;
+				return true;
+			}
+			if(lastReal == NULL || pos > lastReal) return false;
+			tokBegin = pos;
+			while(pos < end && *pos != delim) pos++;
+			tokEnd = pos;
+			pos++;
+			return true;
+		}
 
-	locale cLocale("C");
+		int Count() const {
+			TextTokenizer copy(*this);
+			const char *b, *e;
+			int count = 0;
+			while(copy.Next(b, e)) count++;
+			return count;
+		}
+
+	private:
+		const char *pos, *end;
+		char delim;
+		// Last non-delimiter character, or NULL if there are none
+		const char *lastReal;
+		bool onlyDelims;
+};
+
+/**
+ * Reads an int as 'istream >> int' does in the C locale: leading whitespace
+ * and a sign are accepted, reading stops at the first non-digit, a value out
+ * of range is clamped, and 0 is given if there are no digits.
+ */
+static int parseTextInt(const char *p, const char *end) {
+	while(p < end && isTextSpace(*p)) p++;
+	bool negative = false;
+	if(p < end && (*p == '+' || *p == '-')) {
+		negative = *p == '-';
+		p++;
+	}
+	if(p == end || *p < '0' || *p > '9') return 0;
+
+	// Only needs to be big enough to tell that INT_MAX has been passed
+	uint64_t magnitude = 0;
+	for(; p < end && *p >= '0' && *p <= '9'; p++) {
+		if(magnitude <= (uint64_t)INT_MAX + 1)
+			magnitude = magnitude * 10 + (*p - '0');
+	}
+	if(negative) {
+		if(magnitude > (uint64_t)INT_MAX + 1) return INT_MIN;
+		return (int)(0 - magnitude);
+	}
+	if(magnitude > INT_MAX) return INT_MAX;
+	return magnitude;
+}
+
+// Powers of ten which are exact as floats
+static const float exactPowersOf10[] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+};
+#define MAX_EXACT_POWER_OF_10 10
+// Largest mantissa which is exact as a float
+#define MAX_EXACT_FLOAT_MANTISSA (1 << 24)
+
+/**
+ * Reads a float as 'istream >> float' does in the C locale.
+ * Plain decimals with few enough digits are converted directly: when both the
+ * digits and the power of ten are exact floats, a single float division is
+ * correctly rounded, so the result is the same as strtof's. Anything else
+ * (exponents, long numbers, malformed input) goes through an istringstream.
+ */
+static float parseTextFloat(const char *begin, const char *end) {
+#if FLT_EVAL_METHOD == 0
+	const char *p = begin;
+	while(p < end && isTextSpace(*p)) p++;
+	bool negative = false;
+	if(p < end && (*p == '+' || *p == '-')) {
+		negative = *p == '-';
+		p++;
+	}
+	uint32_t mantissa = 0;
+	int digits = 0, fractionDigits = 0;
+	bool exact = true;
+	for(; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+		mantissa = mantissa * 10 + (*p - '0');
+		if(mantissa >= MAX_EXACT_FLOAT_MANTISSA) {
+			exact = false;
+			break;
+		}
+	}
+	if(exact && p < end && *p == '.') {
+		for(p++; p < end && *p >= '0' && *p <= '9'; p++, digits++, fractionDigits++) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if(mantissa >= MAX_EXACT_FLOAT_MANTISSA || fractionDigits >= MAX_EXACT_POWER_OF_10) {
+				exact = false;
+				break;
+			}
+		}
+	}
+	// istream would also read an exponent, or fail if there were no digits.
+	if(exact && digits > 0 && (p == end || (*p != 'e' && *p != 'E'))) {
+		float value = (float)mantissa / exactPowersOf10[fractionDigits];
+		return negative ? -value : value;
+	}
+#endif
+	float value = 0;
+	istringstream inNum(string(begin, end));
+	inNum.imbue(locale::classic());
+	inNum >> value;
+	return value;
+}
 
-	wxStringTokenizer tk(line(start, end - start), wxT(";"));
-	while(tk.HasMoreTokens()) {
-		wxString t = tk.GetNextToken();
-		start = 2;
-		end = t.Find(wxT("}"));
-		int pos;
-		wxStringTokenizer valTk;
-		if(t.StartsWith(wxT("{"))) { // Axis of some sort
+void droidpad::decode::getTextData(const char *line, size_t length, DPJSData &data) {
+	data.axes.clear();
+	data.touchpadAxes.clear();
+	data.contacts.clear();
+	data.buttons.clear();
+	data.connectionClosed = false;
+	data.containsAccel = false;
+	data.containsGyro = false;
+	data.accelAxes = data.gyroAxes = 0;
+	data.reset = false;
+	data.noInput = false;
+	data.senderTime = 0;
+
+	const char *lineEnd = line + length;
+	// Equivalent to searching for "<STOP>"
+	for(const char *p = line; p + 6 <= lineEnd; p++) {
+		if(p[0] == '<' && memcmp(p, "<STOP>", 6) == 0) {
+			data.connectionClosed = true;
+			return;
+		}
+	}
 
-			switch(t[1]) {
+	// Tokens are between the first '[' and the first ']'. With no '[', parsing
+	// starts at the beginning; if ']' is missing or comes first, it goes to the end.
+	const char *open = (const char *)memchr(line, '[', length);
+	const char *start = open ? open + 1 : line;
+	const char *close = (const char *)memchr(line, ']', length);
+	const char *end = (close && close >= start) ? close : lineEnd;
+
+	TextTokenizer tk(start, end, ';');
+	const char *t, *tEnd;
+	while(tk.Next(t, tEnd)) {
+		size_t tLen = tEnd - t;
+		const char *closeBrace = (const char *)memchr(t, '}', tLen);
+		if(tLen > 0 && t[0] == '{') { // Axis of some sort
+			char kind = tLen > 1 ? t[1] : '\0';
+			switch(kind) {
 				case 'A': // 2way axis
 				case 'S': // 1way axis
-					if(end < start) break; // Malformed?
-					// cout << t(start, end - start).mb_str() << endl;
-					valTk = wxStringTokenizer(t(start, end - start), wxT(","));
-
-					while(valTk.HasMoreTokens()) {
-						{
-							int value;
-							istringstream inNum(string(valTk.GetNextToken().mb_str()));
-							inNum.imbue(cLocale);
-							inNum >> value;
-							data.axes.push_back(value);
-						}
-					}
-
-					break;
 				case 'C': // 1way touchpad
-				case 'T': // 2way touchpad
-					if(end < start) break; // Malformed?
-					// cout << t(start, end - start).mb_str() << endl;
-					valTk = wxStringTokenizer(t(start, end - start), wxT(","));
-
-					pos = 0;
-					while(valTk.HasMoreTokens()) {
-						{
-							int value;
-							istringstream inNum(string(valTk.GetNextToken().mb_str()));
-							inNum.imbue(cLocale);
-							inNum >> value;
+				case 'T': { // 2way touchpad
+					if(!closeBrace || closeBrace < t + 2) break; // Malformed?
+					bool touchpad = kind == 'C' || kind == 'T';
+					TextTokenizer valTk(t + 2, closeBrace, ',');
+					const char *v, *vEnd;
+					int pos = 0;
+					while(valTk.Next(v, vEnd)) {
+						int value = parseTextInt(v, vEnd);
+						if(touchpad) {
 							if(pos == 1) // 'y' axis on 2way pad
-								value = -value;
+								value = (int)(0u - (unsigned int)value);
 							data.touchpadAxes.push_back(value);
-						}
+						} else data.axes.push_back(value);
 						pos++;
 					}
-
 					break;
-				default: // Must be a raw JS
-					start = 1;
-					if(end < start) break; // Malformed?
-					valTk = wxStringTokenizer(t(start, end - start), wxT(","));
-					if(valTk.CountTokens() == 3) { // Else something wrong / malformed
-						int i = 0;
-						float x, y, z;
-						while(valTk.HasMoreTokens()) {
-							{
-								float value;
-								istringstream inNum(string(valTk.GetNextToken().mb_str()));
-								inNum.imbue(cLocale);
-								switch(i) {
-									case 0: inNum >> x; break;
-									case 1: inNum >> y; break;
-									case 2: inNum >> z; break;
-								}
-								i++;
-							}
-						}
-						Vec2 a = accelToAxes(x, y, z);
-
+						  }
+				default: { // Must be a raw JS
+					if(!closeBrace || closeBrace < t + 1) break; // Malformed?
+					TextTokenizer valTk(t + 1, closeBrace, ',');
+					if(valTk.Count() == 3) { // Else something wrong / malformed
+						float xyz[3];
+						const char *v, *vEnd;
+						for(int i = 0; valTk.Next(v, vEnd); i++)
+							xyz[i] = parseTextFloat(v, vEnd);
+						Vec2 a = accelToAxes(xyz[0], xyz[1], xyz[2]);
+
+						markAxis(data.accelAxes, data.axes.size());
+						markAxis(data.accelAxes, data.axes.size() + 1);
 						data.axes.push_back(a.x);
 						data.axes.push_back(a.y);
 						data.containsAccel = true;
 					}
 					break;
+					 }
 			}
 		}
 		else { // Must be a button.
-			data.buttons.push_back(t == wxT("1"));
+			data.buttons.push_back(tLen == 1 && t[0] == '1');
 		}
 	}
+}
 
+const DPJSData droidpad::decode::getTextData(const char *line, size_t length) {
+	DPJSData data;
+	getTextData(line, length, data);
 	return data;
 }
 
+const DPJSData droidpad::decode::getTextData(wxString line) {
+	wxCharBuffer buf = line.mb_str(wxConvUTF8);
+	const char *str = buf.data();
+	return getTextData(str, str ? strlen(str) : 0);
+}
+
 const BinaryConnectionInfo droidpad::decode::getBinaryConnectionInfo(const char *binaryInfo) {
 	BinaryConnectionInfo info;
 	memcpy(&info, binaryInfo, sizeof(BinaryConnectionInfo));
@@ -373,27 +602,18 @@ const BinaryConnectionInfo droidpad::decode::getBinaryConnectionInfo(const char
 	NTOH(info.rawDevices);
 	NTOH(info.axes);
 	NTOH(info.buttons);
+	NTOH(info.capabilities);
 	return info;
 }
 
 const RawBinaryHeader droidpad::decode::getBinaryHeader(const char *binaryHeader) {
 	RawBinaryHeader header;
-	memcpy(&header, binaryHeader, sizeof(RawBinaryHeader));
+	memcpy(&header.sig, binaryHeader, sizeof(BinarySignature));
 	
-	// Flip round various endianness issues
-	NTOH(header.numElements);
-	NTOH(header.flags);
-
-	NTOH(header.raw.ax);
-	NTOH(header.raw.ay);
-	NTOH(header.raw.az);
-	NTOH(header.raw.gx);
-	NTOH(header.raw.gy);
-	NTOH(header.raw.gz);
-	NTOH(header.raw.gzn);
-	NTOH(header.raw.rx);
-	NTOH(header.raw.ry);
-	NTOH(header.raw.rz);
+	// Flip round various endianness issues. Everything after the signature is
+	// a 32-bit word.
+	ntohWords(&header.numElements, binaryHeader + sizeof(BinarySignature),
+			(sizeof(RawBinaryHeader) - sizeof(BinarySignature)) / 4);
 
 #if 0
 #ifdef DEBUG
@@ -407,22 +627,34 @@ const RawBinaryHeader droidpad::decode::getBinaryHeader(const char *binaryHeader
 
 const RawBinaryElement droidpad::decode::getBinaryElement(const char *binaryElement) {
 	RawBinaryElement elem;
-	memcpy(&elem, binaryElement, sizeof(RawBinaryElement));
+	ntohWords(&elem, binaryElement, sizeof(RawBinaryElement) / 4);
+	return elem;
+}
 
-	NTOH(elem.flags);
-	NTOH(elem.raw.data1);
-	NTOH(elem.raw.data2);
-	NTOH(elem.raw.data3);
+const vector<RawBinaryElement> droidpad::decode::getBinaryElements(const char *binaryElements, int numElements) {
+	if(numElements <= 0) return vector<RawBinaryElement>();
+	// Elements are all 32-bit words, so the whole block is swapped in one go
+	vector<RawBinaryElement> elems(numElements);
+	ntohWords(&elems[0], binaryElements, numElements * sizeof(RawBinaryElement) / 4);
+	return elems;
+}
 
-	return elem;
+// A contact trackpad element as a contact, scaled to the axis range with y up.
+static inline TouchContact getContact(const RawBinaryElement &elem) {
+	return TouchContact((int64_t)elem.integer.data1 * AXIS_SIZE / 16384,
+			-(int64_t)elem.integer.data2 * AXIS_SIZE / 16384,
+			elem.integer.data3 != 0);
 }
 
-const DPJSData droidpad::decode::getBinaryData(const RawBinaryHeader header, std::vector<RawBinaryElement> elems) {
-	DPJSData ret;
-	ret.connectionClosed = header.flags & HEADER_FLAG_STOP;
+/**
+ * Adds the axes which come from the header's sensor values.
+ */
+static void getHeaderAxes(const RawBinaryHeader &header, DPJSData &ret) {
 	// TODO: Add support for gyro when modes are implemented
 	if(header.flags & HEADER_FLAG_HAS_ACCEL) {
 		Vec2 accel = accelToAxes(header.axis.ax, header.axis.ay, header.axis.az);
+		markAxis(ret.accelAxes, ret.axes.size());
+		markAxis(ret.accelAxes, ret.axes.size() + 1);
 		ret.axes.push_back(accel.x);
 		ret.axes.push_back(accel.y);
 		ret.containsAccel = true;
@@ -431,6 +663,7 @@ const DPJSData droidpad::decode::getBinaryData(const RawBinaryHeader header, std
 	if((header.flags & HEADER_FLAG_HAS_GYRO) && !(header.flags & HEADER_FLAG_HAS_ACCEL)) {
 		// Range on each side of the centre
 		float pointingAngleRange = (float)Data::tweaks.rotation[0].totalAngle * DEG_TO_RAD / 2;
+		markAxis(ret.gyroAxes, ret.axes.size());
 		ret.axes.push_back(header.axis.gz / pointingAngleRange * AXIS_SIZE); // Put z-component
 		ret.containsGyro = true;
 	}
@@ -438,10 +671,17 @@ const DPJSData droidpad::decode::getBinaryData(const RawBinaryHeader header, std
 	if((header.flags & HEADER_FLAG_HAS_GYRO) && (header.flags & HEADER_FLAG_HAS_ACCEL)) {
 		// Range on each side of the centre
 		float pointingAngleRange = (float)Data::tweaks.rotation[0].totalAngle * DEG_TO_RAD / 2;
+		markAxis(ret.gyroAxes, ret.axes.size());
 		ret.axes.push_back(header.axis.gzn / pointingAngleRange * AXIS_SIZE);
 		ret.containsGyro = true;
 		ret.containsAccel = true;
 	}
+}
+
+const DPJSData droidpad::decode::getBinaryData(const RawBinaryHeader header, std::vector<RawBinaryElement> elems) {
+	DPJSData ret;
+	ret.connectionClosed = header.flags & HEADER_FLAG_STOP;
+	getHeaderAxes(header, ret);
 
 	for(vector<RawBinaryElement>::iterator it = elems.begin(); it != elems.end(); it++) {
 		if(it->flags & ITEM_FLAG_BUTTON) {
@@ -451,21 +691,23 @@ const DPJSData droidpad::decode::getBinaryData(const RawBinaryHeader header, std
 			if(it->flags & ITEM_FLAG_HAS_X_AXIS) {
 				// Rearrange axis between -1 and 1
 				float num = (float)it->integer.data1 / 16384;
-				int pos = ret.axes.size() - 1;
-				num = applyGamma(num, (float)-Data::tweaks.onScreen[pos].gamma / GAMMA_RANGE);
+				const int32_t *tweak = sliderGammaTweak(ret.axes.size());
+				num = applyGamma(num, tweak ? (float)-*tweak / GAMMA_RANGE : 0);
 				num *= AXIS_SIZE;
 				ret.axes.push_back(num);
 			}
 			if(it->flags & ITEM_FLAG_HAS_Y_AXIS) {
 				// Rearrange axis between -1 and 1
 				float num = (float)it->integer.data2 / 16384;
-				int pos = ret.axes.size() - 1;
-				num = applyGamma(num, (float)-Data::tweaks.onScreen[pos].gamma / GAMMA_RANGE);
+				const int32_t *tweak = sliderGammaTweak(ret.axes.size());
+				num = applyGamma(num, tweak ? (float)-*tweak / GAMMA_RANGE : 0);
 				num *= AXIS_SIZE;
 				ret.axes.push_back(num);
 			}
 		}
-		if(it->flags & ITEM_FLAG_TRACKPAD) {
+		if(it->flags & ITEM_FLAG_TRACKPAD && it->flags & ITEM_FLAG_HAS_CONTACT) {
+			ret.contacts.push_back(getContact(*it));
+		} else if(it->flags & ITEM_FLAG_TRACKPAD) {
 			if(it->flags & ITEM_FLAG_HAS_X_AXIS)
 				ret.touchpadAxes.push_back(it->integer.data1);
 			if(it->flags & ITEM_FLAG_HAS_Y_AXIS)
@@ -478,3 +720,153 @@ const DPJSData droidpad::decode::getBinaryData(const RawBinaryHeader header, std
 	}
 	return ret;
 }
+
+// Header flags which change the axes a frame decodes to
+#define PLAN_HEADER_FLAGS (HEADER_FLAG_HAS_ACCEL | HEADER_FLAG_HAS_GYRO)
+
+DecodePlan::DecodePlan() :
+	built(false),
+	headerFlags(0),
+	numAxes(0),
+	numButtons(0),
+	numTouchpadAxes(0),
+	numContacts(0),
+	builds(0)
+{ }
+
+bool DecodePlan::Matches(const RawBinaryHeader &header, const vector<RawBinaryElement> &elems) const {
+	if(!built) return false;
+	if((header.flags & PLAN_HEADER_FLAGS) != headerFlags) return false;
+	if(elems.size() != elementFlags.size()) return false;
+	for(size_t i = 0; i < elems.size(); i++)
+		if(elems[i].flags != elementFlags[i]) return false;
+	return true;
+}
+
+void DecodePlan::Build(const RawBinaryHeader &header, const vector<RawBinaryElement> &elems) {
+	headerFlags = header.flags & PLAN_HEADER_FLAGS;
+	elementFlags.resize(elems.size());
+	steps.clear();
+	gammas.clear();
+
+	// Axes from the header come first
+	DPJSData headerData;
+	getHeaderAxes(header, headerData);
+	numAxes = headerData.axes.size();
+	numButtons = numTouchpadAxes = numContacts = 0;
+
+	// Same tests, in the same order, as getBinaryData
+	for(size_t i = 0; i < elems.size(); i++) {
+		int32_t flags = elementFlags[i] = elems[i].flags;
+		Step step;
+		step.element = i;
+		step.gamma = 0;
+		if(flags & ITEM_FLAG_BUTTON) {
+			step.kind = STEP_BUTTON;
+			step.dest = numButtons++;
+			steps.push_back(step);
+		}
+		if(flags & ITEM_FLAG_SLIDER) {
+			for(int axis = 0; axis < 2; axis++) {
+				if(!(flags & (axis == 0 ? ITEM_FLAG_HAS_X_AXIS : ITEM_FLAG_HAS_Y_AXIS))) continue;
+				step.kind = axis == 0 ? STEP_SLIDER_X : STEP_SLIDER_Y;
+				step.dest = numAxes++;
+				step.gamma = gammas.size();
+				SliderGamma gamma;
+				gamma.source = sliderGammaTweak(step.dest);
+				gamma.value = gamma.source ? *gamma.source : 0;
+				gamma.exponent = gammaExponent((float)-gamma.value / GAMMA_RANGE);
+				gammas.push_back(gamma);
+				steps.push_back(step);
+			}
+		}
+		if(flags & ITEM_FLAG_TRACKPAD && flags & ITEM_FLAG_HAS_CONTACT) {
+			step.kind = STEP_CONTACT;
+			step.dest = numContacts++;
+			steps.push_back(step);
+		} else if(flags & ITEM_FLAG_TRACKPAD) {
+			if(flags & ITEM_FLAG_HAS_X_AXIS) {
+				step.kind = STEP_TRACKPAD_X;
+				step.dest = numTouchpadAxes++;
+				steps.push_back(step);
+			}
+			if(flags & ITEM_FLAG_HAS_Y_AXIS) {
+				step.kind = STEP_TRACKPAD_Y;
+				step.dest = numTouchpadAxes++;
+				steps.push_back(step);
+			}
+		}
+		if(flags & ITEM_FLAG_BUTTON && flags & ITEM_FLAG_IS_RESET) {
+			step.kind = STEP_RESET;
+			steps.push_back(step);
+		}
+	}
+
+	built = true;
+	builds++;
+}
+
+const DPJSData DecodePlan::Decode(const RawBinaryHeader &header, const vector<RawBinaryElement> &elems) {
+	DPJSData data;
+	Decode(header, elems, data);
+	return data;
+}
+
+void DecodePlan::Decode(const RawBinaryHeader &header, const vector<RawBinaryElement> &elems, DPJSData &data) {
+	if(!Matches(header, elems)) Build(header, elems);
+
+	data.connectionClosed = header.flags & HEADER_FLAG_STOP;
+	data.containsAccel = data.containsGyro = false;
+	data.accelAxes = data.gyroAxes = 0;
+	data.reset = false;
+	data.noInput = false;
+	data.senderTime = 0;
+	data.axes.clear();
+	data.touchpadAxes.clear();
+	getHeaderAxes(header, data);
+	data.axes.resize(numAxes);
+	data.buttons.resize(numButtons);
+	data.touchpadAxes.resize(numTouchpadAxes);
+	data.contacts.resize(numContacts);
+
+	// Tweaks can be changed while connected
+	for(vector<SliderGamma>::iterator it = gammas.begin(); it != gammas.end(); it++) {
+		if(it->source != NULL && *it->source != it->value) {
+			it->value = *it->source;
+			it->exponent = gammaExponent((float)-it->value / GAMMA_RANGE);
+		}
+	}
+
+	for(vector<Step>::const_iterator it = steps.begin(); it != steps.end(); it++) {
+		const RawBinaryElement &elem = elems[it->element];
+		switch(it->kind) {
+			case STEP_BUTTON:
+				data.buttons[it->dest] = elem.raw.data1;
+				break;
+			case STEP_SLIDER_X:
+			case STEP_SLIDER_Y: {
+				// Rearrange axis between -1 and 1
+				float num = (float)(it->kind == STEP_SLIDER_X ? elem.integer.data1 : elem.integer.data2) / 16384;
+				num = applyGammaExponent(num, gammas[it->gamma].exponent);
+				num *= AXIS_SIZE;
+				data.axes[it->dest] = num;
+				break;
+			}
+			case STEP_TRACKPAD_X:
+				data.touchpadAxes[it->dest] = elem.integer.data1;
+				break;
+			case STEP_TRACKPAD_Y:
+				data.touchpadAxes[it->dest] = -elem.integer.data2;
+				break;
+			case STEP_CONTACT:
+				data.contacts[it->dest] = getContact(elem);
+				break;
+			case STEP_RESET:
+				if(elem.integer.data1) {
+					LOGV("Reset pressed");
+					data.reset = true;
+				}
+				break;
+		}
+	}
+}
@@ -21,28 +21,24 @@
 #define DP_DATADECODE_H
 
 #include "types.hpp"
+#include "net/protocol.hpp"
 #include <stdint.h>
 #include <vector>
 #include <string>
 #include <wx/string.h>
 
-#define HEADER_FLAG_HAS_ACCEL 0x1
-#define HEADER_FLAG_HAS_GYRO 0x2
-#define HEADER_FLAG_STOP 0x4
-
-#define CMD_STOP 0x1
-
-#define ITEM_FLAG_BUTTON 0x1
-#define ITEM_FLAG_TOGGLE_BUTTON (0x2 | ITEM_FLAG_BUTTON)
-#define ITEM_FLAG_SLIDER 0x4
-#define ITEM_FLAG_TRACKPAD 0x8
-#define ITEM_FLAG_HAS_X_AXIS 0x10
-#define ITEM_FLAG_HAS_Y_AXIS 0x20
-#define ITEM_FLAG_IS_RESET 0x40
-
 namespace droidpad {
 	namespace decode {
 		droidpad::Vec2 accelToAxes(float x, float y, float z);
+		/**
+		 * The tilt of the phone, in radians, from the direction of gravity:
+		 * x about the phone's y axis, and y about its x axis.
+		 */
+		droidpad::Vec2 accelToAngles(float x, float y, float z);
+		/**
+		 * Scales tilt angles to the two tilt axes, applying the user's tweaks.
+		 */
+		droidpad::Vec2 anglesToAxes(const droidpad::Vec2 &angles);
 		// Applies a gamma function, to make the middle parts of this axis
 		// more sensitive to movement.
 		// value - Input value, in the range [-1,1]
@@ -50,6 +46,19 @@ namespace droidpad {
 		// return value - value in the range [-1,1]
 		float applyGamma(float value, float gamma);
 
+		/**
+		 * A finger on a trackpad element with ITEM_FLAG_HAS_CONTACT. x and y
+		 * are scaled to the range of the axes.
+		 */
+		class TouchContact {
+			public:
+				TouchContact();
+				TouchContact(int x, int y, bool down);
+
+				int x, y;
+				bool down;
+		};
+
 		/**
 		 * Raw data returned from connection. Is castable to the other data types,
 		 * which contain data from it.
@@ -61,6 +70,8 @@ namespace droidpad {
 				std::vector<int> axes;
 				std::vector<int> touchpadAxes;
 				std::vector<bool> buttons;
+				// One for each contact trackpad, in the order sent
+				std::vector<TouchContact> contacts;
 
 				/**
 				 * If true, the connection was closed normally.
@@ -70,11 +81,33 @@ namespace droidpad {
 				bool containsAccel;
 				bool containsGyro;
 
+				/**
+				 * Bit i is set if axes[i] came from the accelerometer, or in
+				 * gyroAxes from the gyro, rather than from a slider. Only
+				 * the first 32 axes are described.
+				 */
+				uint32_t accelAxes;
+				uint32_t gyroAxes;
+
 				/**
 				 * If true, reset the axes / button (context specific)
 				 */
 				bool reset;
 
+				/**
+				 * If true, nothing was received which should be output, eg.
+				 * a control message from the phone. The rest is empty, and
+				 * must not be treated as a frame.
+				 */
+				bool noInput;
+
+				/**
+				 * When the phone sent this frame, on the monotonicNanos clock.
+				 * 0 if the phone doesn't timestamp frames, or its clock isn't
+				 * known yet.
+				 */
+				uint64_t senderTime;
+
 				/**
 				 * Reorders the axes according to the given reordering data.
 				 */
@@ -88,11 +121,20 @@ namespace droidpad {
 				DPMouseData(const DPJSData& rawData, const DPJSData& prevData);
 
 				/**
-				 * scrollDelta: down is positive, same scale as incrementalScrollDelta.
-				 * incrementalScrollDelta: increments are 120.
+				 * x, y: as decoded, the velocity in mouse units per
+				 * MOUSE_VELOCITY_PERIOD_MS; OutputSmoothBuffer turns these
+				 * into the whole pixels to move before output managers
+				 * see them.
+				 * scrollDelta: down is positive, in 120ths of a notch. Output
+				 * managers send all of it on every call.
+				 * incrementalScrollDelta: whole notches, in increments of 120.
+				 * Only sent when firstIteration is set.
 				 */
 				int x, y, scrollDelta, incrementalScrollDelta;
 				bool bLeft, bMiddle, bRight;
+
+				// As in DPJSData
+				uint64_t senderTime;
 		};
 
 		class DPTouchData : public Vec2 {
@@ -101,14 +143,14 @@ namespace droidpad {
 				DPTouchData(const DPTouchData& old);
 				DPTouchData(const DPJSData& rawData, const DPJSData& prevData, const DPTouchData& prevAbsData);
 
-				/**
-				 * scrollDelta: down is positive, same scale as incrementalScrollDelta.
-				 * incrementalScrollDelta: increments are 120.
-				 */
+				// As in DPMouseData
 				int scrollDelta, incrementalScrollDelta;
 				bool bLeft, bMiddle, bRight;
 
 				float xOffset, yOffset;
+
+				// As in DPJSData
+				uint64_t senderTime;
 		};
 
 		class DPSlideData {
@@ -118,117 +160,100 @@ namespace droidpad {
 				DPSlideData(const DPJSData& rawData, const DPJSData& prevData);
 				// Note: white & black are toggle buttons.
 				bool next, prev, start, finish, white, black, beginning, end;
+
+				// As in DPJSData
+				uint64_t senderTime;
 		};
 		
-		/**
-		 * Each binary packet begins with four bytes,
-		 * identifying the type of message.
-		 */
-		typedef struct {
-			char h[4];
-			
-			inline bool isConnectionInfo() {
-//				printf("isConnectionInfo: %02x%02x%02x%02x == %s?\n",
-//						h[0], h[1], h[2], h[3], "DINF");
-				return memcmp(h, "DINF", 4) == 0;
-			}
-			inline bool isBinaryHeader() {
-//				printf("isBinaryHeader: %02x%02x%02x%02x == %s?\n",
-//						h[0], h[1], h[2], h[3], "DPAD");
-				return memcmp(h, "DPAD", 4) == 0;
-			}
-
-			/**
-			 * Sets this as a command message
-			 */
-			inline void setCmd() {
-				h[0] = 'D';
-				h[1] = 'C';
-				h[2] = 'M';
-				h[3] = 'D';
-			}
-		} BinarySignature;
-
-		typedef struct {
-			// In this case, "DINF"
-			BinarySignature sig;
-
-			// One of:
-			// * MODE_MOUSE
-			// * MODE_SLIDE
-			// * MODE_ABSMOUSE
-			// * MODE_JS
-			int32_t modeType;
-
-			int32_t rawDevices;
-			int32_t axes;
-			int32_t buttons;
-			char reserved[32];
-		} BinaryConnectionInfo;
-
-		typedef struct {
-			// In this case, "DPAD"
-			BinarySignature sig;
-			int32_t numElements;
-			int32_t flags;
-
-			union {
-				struct {
-					// Accel
-					float ax, ay, az;
-					// Gyro, and normalised gyro
-					float gx, gy, gz, gzn;
-					// Reserved
-					float rx, ry, rz;
-				} axis;
-				struct {
-					// Accel
-					uint32_t ax, ay, az;
-					// Gyro, and normalised gyro
-					uint32_t gx, gy, gz, gzn;
-					// Reserved
-					uint32_t rx, ry, rz;
-				} raw;
-			};
-		} RawBinaryHeader;
-
-		typedef struct {
-			int32_t flags;
-			union {
-				struct {
-					uint32_t data1;
-					uint32_t data2;
-					uint32_t data3;
-				} raw;
-				struct {
-					float data1;
-					float data2;
-					float data3;
-				} floating;
-				struct {
-					int32_t data1;
-					int32_t data2;
-					int32_t data3;
-				} integer;
-			};
-		} RawBinaryElement;
-
-		// A message from the server to the phone.
-		typedef struct {
-			BinarySignature sig;
-			int32_t msg;
-		} BinaryServerMessage;
-
 		/**
 		 * Converts an input line to a DPJSData
 		 */
 		const DPJSData getTextData(wxString line);
+		/**
+		 * Converts an input line, in the raw bytes received, to a DPJSData.
+		 * length excludes the trailing newline.
+		 */
+		const DPJSData getTextData(const char *line, size_t length);
+		/**
+		 * As above, but reuses the storage in data rather than allocating new.
+		 */
+		void getTextData(const char *line, size_t length, DPJSData &data);
 
 		const BinaryConnectionInfo getBinaryConnectionInfo(const char *binaryInfo);
 		const RawBinaryHeader getBinaryHeader(const char *binaryHeader);
 		const RawBinaryElement getBinaryElement(const char *binaryElement);
+		/**
+		 * Decodes numElements consecutive elements, as sent after a RawBinaryHeader.
+		 */
+		const std::vector<RawBinaryElement> getBinaryElements(const char *binaryElements, int numElements);
 
 		const DPJSData getBinaryData(const RawBinaryHeader header, std::vector<RawBinaryElement> elems);
+
+		/**
+		 * Decodes the binary frames of one connection, giving the same results
+		 * as getBinaryData. A phone's layout doesn't change during a session,
+		 * so the element flags are only examined when the first frame arrives,
+		 * to build a list of steps; later frames just run the steps. If the
+		 * layout does change, the plan is rebuilt.
+		 */
+		class DecodePlan {
+			public:
+				DecodePlan();
+
+				const DPJSData Decode(const RawBinaryHeader &header, const std::vector<RawBinaryElement> &elems);
+				/**
+				 * As above, but reuses the storage in data rather than allocating new.
+				 */
+				void Decode(const RawBinaryHeader &header, const std::vector<RawBinaryElement> &elems, DPJSData &data);
+
+				/**
+				 * The number of times the plan has been built.
+				 */
+				inline int GetBuilds() const { return builds; }
+
+			private:
+				enum {
+					STEP_BUTTON,
+					STEP_RESET,
+					STEP_SLIDER_X,
+					STEP_SLIDER_Y,
+					STEP_TRACKPAD_X,
+					STEP_TRACKPAD_Y,
+					STEP_CONTACT,
+				};
+
+				typedef struct {
+					int kind;
+					// Index of the element read
+					int element;
+					// Index written to in axes, buttons, touchpadAxes or contacts
+					int dest;
+					// Index into gammas, for sliders
+					int gamma;
+				} Step;
+
+				typedef struct {
+					// The tweak the gamma comes from, or NULL for none
+					const int32_t *source;
+					// Its value when exponent was calculated
+					int32_t value;
+					float exponent;
+				} SliderGamma;
+
+				bool built;
+				// Layout the plan was built for
+				int32_t headerFlags;
+				std::vector<int32_t> elementFlags;
+
+				std::vector<Step> steps;
+				std::vector<SliderGamma> gammas;
+				size_t numAxes, numButtons, numTouchpadAxes, numContacts;
+
+				int builds;
+
+				bool Matches(const RawBinaryHeader &header, const std::vector<RawBinaryElement> &elems) const;
+				void Build(const RawBinaryHeader &header, const std::vector<RawBinaryElement> &elems);
+		};
 	};
 };
 
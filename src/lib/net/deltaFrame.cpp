@@ -0,0 +1,312 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "deltaFrame.hpp"
+
+#include <math.h>
+#include <limits.h>
+#include <stddef.h>
+
+using namespace std;
+using namespace droidpad::decode;
+
+// Buttons are sent as a single bit rather than their data words
+static inline bool isPackedButton(int32_t flags) {
+	return (flags & ITEM_FLAG_BUTTON) && !(flags & (ITEM_FLAG_SLIDER | ITEM_FLAG_TRACKPAD));
+}
+
+// With HEADER_FLAG_TIMESTAMPED, the reserved sensors hold integers, which are
+// sent exactly rather than quantised.
+#define FIRST_RESERVED_SENSOR 7
+
+static inline bool isRawSensor(int32_t headerFlags, int sensor) {
+	return (headerFlags & HEADER_FLAG_TIMESTAMPED) && sensor >= FIRST_RESERVED_SENSOR;
+}
+
+static inline int32_t quantiseSensor(float value) {
+	float scaled = floorf(value * DELTA_SENSOR_SCALE + 0.5f);
+	// Also catches NaN
+	if(!(scaled > INT_MIN)) return INT_MIN;
+	if(scaled >= INT_MAX) return INT_MAX;
+	return (int32_t)scaled;
+}
+
+static inline uint32_t zigzag(uint32_t delta) {
+	return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t value) {
+	return (value >> 1) ^ -(value & 1);
+}
+
+static void putVarint(string &out, uint32_t value) {
+	while(value >= 0x80) {
+		out += (char)(value | 0x80);
+		value >>= 7;
+	}
+	out += (char)value;
+}
+
+/**
+ * Reads from a frame, noting rather than overrunning if it is too short.
+ */
+class FrameReader {
+	public:
+		FrameReader(const uint8_t *data, size_t length) :
+			pos(data),
+			end(data + length),
+			ok(true)
+		{ }
+
+		uint32_t Varint() {
+			uint32_t value = 0;
+			for(int shift = 0; shift < 35; shift += 7) {
+				if(pos == end) {
+					ok = false;
+					return 0;
+				}
+				uint8_t byte = *pos++;
+				value |= (uint32_t)(byte & 0x7f) << shift;
+				if(!(byte & 0x80)) return value;
+			}
+			ok = false;
+			return 0;
+		}
+
+		/**
+		 * Returns a block of bytes, or NULL if there aren't enough.
+		 */
+		const uint8_t *Bytes(size_t length) {
+			if((size_t)(end - pos) < length) {
+				ok = false;
+				return NULL;
+			}
+			const uint8_t *ret = pos;
+			pos += length;
+			return ret;
+		}
+
+		inline bool Ok() const { return ok; }
+		inline bool AtEnd() const { return pos == end; }
+
+	private:
+		const uint8_t *pos, *end;
+		bool ok;
+};
+
+DeltaState::DeltaState() :
+	valid(false),
+	headerFlags(0)
+{
+	memset(sensors, 0, sizeof(sensors));
+}
+
+void DeltaState::SetLayout(int32_t headerFlags, const vector<RawBinaryElement> &layout) {
+	this->headerFlags = headerFlags;
+	memset(sensors, 0, sizeof(sensors));
+	elements.resize(layout.size());
+	for(size_t i = 0; i < layout.size(); i++) {
+		memset(&elements[i], 0, sizeof(RawBinaryElement));
+		elements[i].flags = layout[i].flags;
+	}
+	valid = true;
+}
+
+DeltaEncoder::DeltaEncoder(int keyframeInterval) :
+	keyframeInterval(keyframeInterval),
+	sinceKeyframe(0),
+	forceKeyframe(false),
+	sequence(0)
+{ }
+
+bool DeltaEncoder::Encode(const RawBinaryHeader &header, const vector<RawBinaryElement> &elems, string &out) {
+	// The decoder would reject the keyframe
+	if(elems.size() > DELTA_MAX_ELEMENTS) {
+		ForceKeyframe();
+		return false;
+	}
+
+	bool keyframe = forceKeyframe || !state.valid ||
+		++sinceKeyframe >= keyframeInterval ||
+		header.flags != state.headerFlags ||
+		elems.size() != state.elements.size();
+	for(size_t i = 0; !keyframe && i < elems.size(); i++)
+		if(elems[i].flags != state.elements[i].flags) keyframe = true;
+
+	string body;
+	if(keyframe) {
+		state.SetLayout(header.flags, elems);
+		forceKeyframe = false;
+		sinceKeyframe = 0;
+		putVarint(body, header.flags);
+		putVarint(body, elems.size());
+		for(size_t i = 0; i < elems.size(); i++)
+			putVarint(body, elems[i].flags);
+	}
+
+	// Sensors
+	const float *sensors = &header.axis.ax;
+	const uint32_t *rawSensors = &header.raw.ax;
+	int32_t quantised[DELTA_SENSORS];
+	uint32_t sensorMask = 0;
+	for(int i = 0; i < DELTA_SENSORS; i++) {
+		quantised[i] = isRawSensor(header.flags, i) ? rawSensors[i] : quantiseSensor(sensors[i]);
+		if(quantised[i] != state.sensors[i]) sensorMask |= 1 << i;
+	}
+	putVarint(body, sensorMask);
+	for(int i = 0; i < DELTA_SENSORS; i++) {
+		if(!(sensorMask & (1 << i))) continue;
+		putVarint(body, zigzag((uint32_t)quantised[i] - (uint32_t)state.sensors[i]));
+		state.sensors[i] = quantised[i];
+	}
+
+	// Which elements changed
+	size_t maskStart = body.size();
+	body.append((elems.size() + 7) / 8, 0);
+	vector<size_t> buttons, others;
+	for(size_t i = 0; i < elems.size(); i++) {
+		const RawBinaryElement &elem = elems[i];
+		RawBinaryElement &old = state.elements[i];
+		bool changed;
+		if(isPackedButton(elem.flags)) {
+			changed = (elem.raw.data1 != 0) != (old.raw.data1 != 0);
+			if(changed) buttons.push_back(i);
+		} else {
+			changed = elem.raw.data1 != old.raw.data1 ||
+				elem.raw.data2 != old.raw.data2 ||
+				elem.raw.data3 != old.raw.data3;
+			if(changed) others.push_back(i);
+		}
+		if(changed) body[maskStart + i / 8] |= 1 << (i % 8);
+	}
+
+	// Buttons, one bit each
+	size_t buttonStart = body.size();
+	body.append((buttons.size() + 7) / 8, 0);
+	for(size_t b = 0; b < buttons.size(); b++) {
+		bool pressed = elems[buttons[b]].raw.data1 != 0;
+		if(pressed) body[buttonStart + b / 8] |= 1 << (b % 8);
+		state.elements[buttons[b]].raw.data1 = pressed;
+	}
+
+	// Everything else
+	for(vector<size_t>::iterator it = others.begin(); it != others.end(); it++) {
+		const RawBinaryElement &elem = elems[*it];
+		RawBinaryElement &old = state.elements[*it];
+		putVarint(body, zigzag(elem.raw.data1 - old.raw.data1));
+		putVarint(body, zigzag(elem.raw.data2 - old.raw.data2));
+		putVarint(body, zigzag(elem.raw.data3 - old.raw.data3));
+		old.raw = elem.raw;
+	}
+
+	// Can't happen within DELTA_MAX_ELEMENTS, at up to 15 bytes an element,
+	// but the length mustn't wrap if that changes. The state has moved on,
+	// so the next frame has to be a keyframe.
+	if(body.size() > DELTA_MAX_LENGTH) {
+		ForceKeyframe();
+		return false;
+	}
+
+	// Header, with the length in network byte order
+	out.append("DPD2", 4);
+	out += (char)(keyframe ? DELTA_FLAG_KEYFRAME : 0);
+	out += (char)sequence++;
+	out += (char)(body.size() >> 8);
+	out += (char)(body.size() & 0xff);
+	out += body;
+	return true;
+}
+
+DeltaDecoder::DeltaDecoder() :
+	sequence(0)
+{ }
+
+size_t droidpad::decode::getDeltaFrameLength(const char *frameHeader) {
+	const uint8_t *length = (const uint8_t *)frameHeader + offsetof(DeltaFrameHeader, length);
+	return sizeof(DeltaFrameHeader) + ((length[0] << 8) | length[1]);
+}
+
+bool DeltaDecoder::Decode(const char *frame, size_t length, RawBinaryHeader &header, vector<RawBinaryElement> &elems) {
+	if(length < sizeof(DeltaFrameHeader) || getDeltaFrameLength(frame) != length)
+		return state.valid = false;
+	const DeltaFrameHeader *frameHeader = (const DeltaFrameHeader *)frame;
+	bool keyframe = frameHeader->flags & DELTA_FLAG_KEYFRAME;
+	uint8_t expectedSequence = sequence + 1;
+	sequence = frameHeader->sequence;
+	// Deltas are only any use on top of the frame before
+	if(!keyframe && (!state.valid || frameHeader->sequence != expectedSequence))
+		return state.valid = false;
+
+	FrameReader reader((const uint8_t *)frame + sizeof(DeltaFrameHeader), length - sizeof(DeltaFrameHeader));
+	if(keyframe) {
+		int32_t headerFlags = reader.Varint();
+		uint32_t numElements = reader.Varint();
+		if(!reader.Ok() || numElements > DELTA_MAX_ELEMENTS)
+			return state.valid = false;
+		vector<RawBinaryElement> layout(numElements);
+		for(size_t i = 0; i < numElements; i++)
+			layout[i].flags = reader.Varint();
+		if(!reader.Ok()) return state.valid = false;
+		state.SetLayout(headerFlags, layout);
+	}
+
+	uint32_t sensorMask = reader.Varint();
+	for(int i = 0; i < DELTA_SENSORS; i++)
+		if(sensorMask & (1 << i))
+			state.sensors[i] += unzigzag(reader.Varint());
+
+	size_t numElements = state.elements.size();
+	const uint8_t *changed = reader.Bytes((numElements + 7) / 8);
+	if(!reader.Ok()) return state.valid = false;
+	size_t numButtons = 0;
+	for(size_t i = 0; i < numElements; i++)
+		if((changed[i / 8] & (1 << (i % 8))) && isPackedButton(state.elements[i].flags))
+			numButtons++;
+
+	const uint8_t *buttons = reader.Bytes((numButtons + 7) / 8);
+	if(!reader.Ok()) return state.valid = false;
+	size_t b = 0;
+	for(size_t i = 0; i < numElements; i++) {
+		if(!(changed[i / 8] & (1 << (i % 8)))) continue;
+		RawBinaryElement &elem = state.elements[i];
+		if(isPackedButton(elem.flags)) {
+			elem.raw.data1 = (buttons[b / 8] >> (b % 8)) & 1;
+			b++;
+		} else {
+			elem.raw.data1 += unzigzag(reader.Varint());
+			elem.raw.data2 += unzigzag(reader.Varint());
+			elem.raw.data3 += unzigzag(reader.Varint());
+		}
+	}
+	if(!reader.Ok() || !reader.AtEnd()) return state.valid = false;
+
+	memcpy(header.sig.h, "DPAD", 4);
+	header.numElements = numElements;
+	header.flags = state.headerFlags;
+	float *sensors = &header.axis.ax;
+	uint32_t *rawSensors = &header.raw.ax;
+	for(int i = 0; i < DELTA_SENSORS; i++) {
+		if(isRawSensor(state.headerFlags, i))
+			rawSensors[i] = state.sensors[i];
+		else
+			sensors[i] = (float)state.sensors[i] / DELTA_SENSOR_SCALE;
+	}
+	elems = state.elements;
+	return true;
+}
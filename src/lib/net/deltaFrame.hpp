@@ -0,0 +1,125 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_DELTA_FRAME_H
+#define DP_DELTA_FRAME_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "net/protocol.hpp"
+
+// Number of sensor values in a RawBinaryHeader
+#define DELTA_SENSORS 10
+// Frames between keyframes, unless asked for sooner
+#define DELTA_KEYFRAME_INTERVAL 60
+// Larger layouts are rejected, so that a frame always fits its length field
+#define DELTA_MAX_ELEMENTS 1024
+// Largest body the 16 bit length field can give
+#define DELTA_MAX_LENGTH 0xffff
+
+namespace droidpad {
+	namespace decode {
+		/**
+		 * What both ends of a delta stream know about the last frame.
+		 */
+		class DeltaState {
+			public:
+				DeltaState();
+
+				// False until a keyframe has been seen
+				bool valid;
+				int32_t headerFlags;
+				// Quantised sensor values
+				int32_t sensors[DELTA_SENSORS];
+				// Elements in host byte order. Buttons only hold whether data1 is set.
+				std::vector<RawBinaryElement> elements;
+
+				/**
+				 * Resets to a new layout, with every value zero.
+				 */
+				void SetLayout(int32_t headerFlags, const std::vector<RawBinaryElement> &layout);
+		};
+
+		/**
+		 * Turns full frames into DPD2 delta frames. Used by phones, and by
+		 * the simulator and tests on this side.
+		 */
+		class DeltaEncoder {
+			public:
+				/**
+				 * keyframeInterval - a keyframe is sent at least this often, in frames.
+				 */
+				DeltaEncoder(int keyframeInterval = DELTA_KEYFRAME_INTERVAL);
+
+				/**
+				 * Encodes a frame, given in host byte order, and appends it to out.
+				 * A keyframe is sent whenever the layout changes.
+				 * Returns false, leaving out as it was, if the frame can't be
+				 * sent as a delta frame: it has more than DELTA_MAX_ELEMENTS
+				 * elements, or wouldn't fit the length field. It should be sent
+				 * in full instead, and the next delta frame will be a keyframe.
+				 */
+				bool Encode(const RawBinaryHeader &header, const std::vector<RawBinaryElement> &elems, std::string &out);
+
+				/**
+				 * Makes the next frame a keyframe.
+				 */
+				inline void ForceKeyframe() { forceKeyframe = true; }
+
+			private:
+				DeltaState state;
+				int keyframeInterval, sinceKeyframe;
+				bool forceKeyframe;
+				uint8_t sequence;
+		};
+
+		/**
+		 * Rebuilds full frames from DPD2 delta frames.
+		 */
+		class DeltaDecoder {
+			public:
+				DeltaDecoder();
+
+				/**
+				 * Decodes a frame, starting with its DeltaFrameHeader. The full frame
+				 * is written to header and elems, in host byte order, as given by
+				 * getBinaryHeader and getBinaryElements.
+				 * Returns false if the frame is malformed, or is a delta with nothing
+				 * to apply it to, after which frames are ignored until the next keyframe.
+				 */
+				bool Decode(const char *frame, size_t length, RawBinaryHeader &header, std::vector<RawBinaryElement> &elems);
+
+				inline void Reset() { state.valid = false; }
+
+			private:
+				DeltaState state;
+				uint8_t sequence;
+		};
+
+		/**
+		 * Given the DeltaFrameHeader at the start of a frame, returns the length
+		 * of the whole frame.
+		 */
+		size_t getDeltaFrameLength(const char *frameHeader);
+	};
+};
+
+#endif
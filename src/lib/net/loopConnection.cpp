@@ -0,0 +1,207 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "loopConnection.hpp"
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "log.hpp"
+#include "timing.hpp"
+
+using namespace droidpad;
+using namespace std;
+
+// The loop shared by every attached socket, and how many there are
+static SharedReceiveLoop *shared = NULL;
+static int sharedCount = 0;
+
+static wxMutex &sharedMutex() {
+	static wxMutex mutex;
+	return mutex;
+}
+
+SharedReceiveLoop::SharedReceiveLoop(ReceiveLoop *loop, int wakeRead, int wakeWrite) :
+	wxThread(wxTHREAD_JOINABLE),
+	loop(loop),
+	wakeRead(wakeRead),
+	wakeWrite(wakeWrite),
+	requestDone(requestMutex),
+	request(REQUEST_NONE),
+	requestFd(-1),
+	requestSink(NULL),
+	requestResult(false)
+{
+}
+
+SharedReceiveLoop::~SharedReceiveLoop() {
+	delete loop;
+	close(wakeRead);
+	close(wakeWrite);
+}
+
+bool SharedReceiveLoop::Attach(int fd, ReceiveSink *sink) {
+	wxMutexLocker locker(sharedMutex());
+	if(shared == NULL) {
+		ReceiveLoop *loop = ReceiveLoop::Create();
+		if(loop == NULL) return false;
+		int wake[2];
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, wake) != 0) {
+			delete loop;
+			return false;
+		}
+		shared = new SharedReceiveLoop(loop, wake[0], wake[1]);
+		if(!loop->Add(wake[0], shared) ||
+				shared->Create() != wxTHREAD_NO_ERROR ||
+				shared->Run() != wxTHREAD_NO_ERROR) {
+			delete shared;
+			shared = NULL;
+			return false;
+		}
+		LOGVwx(wxT("Receiving from phones on one thread, through ") + wxString(loop->Name(), wxConvUTF8));
+	}
+	if(!shared->MakeRequest(REQUEST_ADD, fd, sink)) {
+		if(sharedCount == 0) StopShared();
+		return false;
+	}
+	sharedCount++;
+	return true;
+}
+
+void SharedReceiveLoop::Detach(int fd) {
+	wxMutexLocker locker(sharedMutex());
+	if(shared == NULL) return;
+	shared->MakeRequest(REQUEST_REMOVE, fd, NULL);
+	if(--sharedCount == 0) StopShared();
+}
+
+void SharedReceiveLoop::StopShared() {
+	shared->MakeRequest(REQUEST_STOP, -1, NULL);
+	shared->Wait();
+	delete shared;
+	shared = NULL;
+	LOGV("Stopped receiving from phones on one thread");
+}
+
+bool SharedReceiveLoop::MakeRequest(int type, int fd, ReceiveSink *sink) {
+	wxMutexLocker locker(requestMutex);
+	request = type;
+	requestFd = fd;
+	requestSink = sink;
+	requestResult = false;
+	char wake = 0;
+	if(write(wakeWrite, &wake, 1) != 1) {
+		LOGE("Couldn't wake the receive thread");
+		request = REQUEST_NONE;
+		return false;
+	}
+	while(request != REQUEST_NONE) requestDone.Wait();
+	return requestResult;
+}
+
+void *SharedReceiveLoop::Entry() {
+	bool stopping = false;
+	while(!stopping) {
+		// Sinks are called from here, without requestMutex held
+		loop->Poll(-1);
+
+		wxMutexLocker locker(requestMutex);
+		switch(request) {
+			case REQUEST_NONE:
+				continue;
+			case REQUEST_ADD:
+				requestResult = loop->Add(requestFd, requestSink);
+				break;
+			case REQUEST_REMOVE:
+				loop->Remove(requestFd);
+				requestResult = true;
+				break;
+			case REQUEST_STOP:
+				requestResult = true;
+				stopping = true;
+				break;
+		}
+		request = REQUEST_NONE;
+		requestDone.Broadcast();
+	}
+	return NULL;
+}
+
+LoopConnection::LoopConnection(AndroidDevice &device) :
+	DPConnection(device),
+	attached(false),
+	pendingArrived(pendingMutex),
+	closed(false)
+{
+	// The loop does the waiting, so there is nothing to busy poll
+	busyPoll = 0;
+}
+
+LoopConnection::~LoopConnection() {
+	// Before the socket is closed, so that its fd isn't given to another
+	// socket while still in the loop
+	if(attached) SharedReceiveLoop::Detach(SocketFd());
+}
+
+int LoopConnection::Start() {
+	int ret = DPConnection::Start();
+	if(ret != START_SUCCESS) return ret;
+	// The handshake is read directly; only the stream goes through the loop
+	int fd = SocketFd();
+	if(fd >= 0 && SharedReceiveLoop::Attach(fd, this))
+		attached = true;
+	else
+		LOGW("Couldn't receive through the shared loop, reading from the phone directly");
+	return ret;
+}
+
+bool LoopConnection::ParseFromNet() {
+	if(!attached) return DPConnection::ParseFromNet();
+	// As when reading directly, a silence means the phone has gone, or
+	// otherwise the wx timeout applies
+	int timeout = connectionTimeout > 0 ? connectionTimeout : CONN_WX_TIMEOUT * 1000;
+	uint64_t deadline = monotonicNanos() + (uint64_t)timeout * NANOS_PER_MILLI;
+
+	wxMutexLocker locker(pendingMutex);
+	while(pending.empty() && !closed) {
+		uint64_t now = monotonicNanos();
+		if(now >= deadline) {
+			LOGVwx(wxString::Format(wxT("Nothing received from the phone for %dms"), timeout));
+			return false;
+		}
+		pendingArrived.WaitTimeout((deadline - now + NANOS_PER_MILLI - 1) / NANOS_PER_MILLI);
+	}
+	if(pending.empty()) return false;
+	inData.append(pending);
+	pending.clear();
+	return true;
+}
+
+void LoopConnection::Received(const char *data, size_t length) {
+	wxMutexLocker locker(pendingMutex);
+	pending.append(data, length);
+	pendingArrived.Signal();
+}
+
+void LoopConnection::Closed() {
+	wxMutexLocker locker(pendingMutex);
+	closed = true;
+	pendingArrived.Signal();
+}
@@ -0,0 +1,116 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_LOOP_CONNECTION_H
+#define DP_LOOP_CONNECTION_H
+
+#include <wx/thread.h>
+#include <string>
+
+#include "net/connection.hpp"
+#include "net/receiveLoop.hpp"
+
+namespace droidpad {
+	/**
+	 * One thread receiving for every LoopConnection, through a ReceiveLoop.
+	 * It is started when the first socket is attached, and stopped when the
+	 * last is detached.
+	 */
+	class SharedReceiveLoop : private wxThread, private ReceiveSink {
+		public:
+			/**
+			 * Starts receiving fd into sink on the shared thread. Returns
+			 * false if there is no loop to receive through.
+			 */
+			static bool Attach(int fd, ReceiveSink *sink);
+			/**
+			 * Stops receiving fd. Once this returns its sink won't be called
+			 * again.
+			 */
+			static void Detach(int fd);
+
+		private:
+			SharedReceiveLoop(ReceiveLoop *loop, int wakeRead, int wakeWrite);
+			~SharedReceiveLoop();
+
+			void *Entry();
+
+			ReceiveLoop *loop;
+			// Written to to wake the thread, so that it takes a request
+			int wakeRead, wakeWrite;
+
+			// Adds, removes and stops are only done on the thread, as the
+			// loops aren't thread safe. Only one is waiting at a time.
+			enum {
+				REQUEST_NONE,
+				REQUEST_ADD,
+				REQUEST_REMOVE,
+				REQUEST_STOP,
+			};
+			wxMutex requestMutex;
+			wxCondition requestDone;
+			int request;
+			int requestFd;
+			ReceiveSink *requestSink;
+			bool requestResult;
+
+			/**
+			 * Hands a request to the thread and waits for it to be done.
+			 */
+			bool MakeRequest(int type, int fd, ReceiveSink *sink);
+			/**
+			 * Stops and deletes the shared loop.
+			 */
+			static void StopShared();
+
+			// Drains the wake socket
+			inline void Received(const char *data, size_t length) { }
+			inline void Closed() { }
+	};
+
+	/**
+	 * A plain connection which, once the mode is known, is received by the
+	 * SharedReceiveLoop rather than by reading the socket on its own thread.
+	 * Falls back to reading the socket if it can't be attached.
+	 */
+	class LoopConnection : public DPConnection, private ReceiveSink {
+		public:
+			LoopConnection(AndroidDevice &device);
+			virtual ~LoopConnection();
+
+			virtual int Start();
+
+		protected:
+			virtual bool ParseFromNet();
+
+		private:
+			bool attached;
+
+			// Received by the loop, and not yet taken into inData
+			wxMutex pendingMutex;
+			wxCondition pendingArrived;
+			std::string pending;
+			bool closed;
+
+			void Received(const char *data, size_t length);
+			void Closed();
+	};
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_PROTOCOL_H
+#define DP_PROTOCOL_H
+
+// Wire format shared by the phone and computer. Kept free of wx so that
+// standalone tools (such as the phone simulator) can use it.
+// All multi-byte values are sent in network byte order.
+
+#include <stdint.h>
+#include <string.h>
+
+#define HEADER_FLAG_HAS_ACCEL 0x1
+#define HEADER_FLAG_HAS_GYRO 0x2
+#define HEADER_FLAG_STOP 0x4
+// The reserved header words hold a sequence number and send time
+#define HEADER_FLAG_TIMESTAMPED 0x8
+
+#define CMD_STOP 0x1
+// Tells the phone to send DPD2 delta frames from now on
+#define CMD_DELTA 0x2
+// Asks for a DPNG reply; sent as a BinaryPingMessage
+#define CMD_PING 0x3
+// Sent regularly so that each side notices quickly if the other is gone
+#define CMD_HEARTBEAT 0x4
+
+// Capabilities of the phone, sent in BinaryConnectionInfo
+#define CAPABILITY_DELTA 0x1
+// Answers pings, and may send timestamped frames
+#define CAPABILITY_TIMESTAMPS 0x2
+// Accepts heartbeats
+#define CAPABILITY_HEARTBEAT 0x4
+// gx and gy in frame headers are tilt angles integrated from the gyro, which
+// can be fused with the accelerometer's tilt
+#define CAPABILITY_GYRO_ANGLES 0x8
+
+// Flags in a DeltaFrameHeader
+#define DELTA_FLAG_KEYFRAME 0x1
+// Sensor values in delta frames are sent in units of 1 / DELTA_SENSOR_SCALE
+#define DELTA_SENSOR_SCALE 8192
+
+#define ITEM_FLAG_BUTTON 0x1
+#define ITEM_FLAG_TOGGLE_BUTTON (0x2 | ITEM_FLAG_BUTTON)
+#define ITEM_FLAG_SLIDER 0x4
+#define ITEM_FLAG_TRACKPAD 0x8
+#define ITEM_FLAG_HAS_X_AXIS 0x10
+#define ITEM_FLAG_HAS_Y_AXIS 0x20
+#define ITEM_FLAG_IS_RESET 0x40
+// Trackpads only: data3 is non-zero while a finger is on the pad, and data1
+// and data2 are its position, from -16384 to 16384 across the pad. These
+// are output as multi-touch rather than mixed into touchpadAxes, and aren't
+// sent in the text protocol.
+#define ITEM_FLAG_HAS_CONTACT 0x80
+
+namespace droidpad {
+	namespace decode {
+		/**
+		 * Each binary packet begins with four bytes,
+		 * identifying the type of message.
+		 */
+		typedef struct {
+			char h[4];
+			
+			inline bool isConnectionInfo() {
+//				printf("isConnectionInfo: %02x%02x%02x%02x == %s?\n",
+//						h[0], h[1], h[2], h[3], "DINF");
+				return memcmp(h, "DINF", 4) == 0;
+			}
+			inline bool isBinaryHeader() {
+//				printf("isBinaryHeader: %02x%02x%02x%02x == %s?\n",
+//						h[0], h[1], h[2], h[3], "DPAD");
+				return memcmp(h, "DPAD", 4) == 0;
+			}
+			inline bool isCmd() {
+				return memcmp(h, "DCMD", 4) == 0;
+			}
+			inline bool isDeltaFrame() {
+				return memcmp(h, "DPD2", 4) == 0;
+			}
+			inline bool isPong() {
+				return memcmp(h, "DPNG", 4) == 0;
+			}
+
+			/**
+			 * Sets this as a command message
+			 */
+			inline void setCmd() {
+				h[0] = 'D';
+				h[1] = 'C';
+				h[2] = 'M';
+				h[3] = 'D';
+			}
+		} BinarySignature;
+
+		typedef struct {
+			// In this case, "DINF"
+			BinarySignature sig;
+
+			// One of:
+			// * MODE_MOUSE
+			// * MODE_SLIDE
+			// * MODE_ABSMOUSE
+			// * MODE_JS
+			int32_t modeType;
+
+			int32_t rawDevices;
+			int32_t axes;
+			int32_t buttons;
+			// CAPABILITY_* flags. Older phones send zero.
+			int32_t capabilities;
+			char reserved[28];
+		} BinaryConnectionInfo;
+
+		typedef struct {
+			// In this case, "DPAD"
+			BinarySignature sig;
+			int32_t numElements;
+			int32_t flags;
+
+			union {
+				struct {
+					// Accel
+					float ax, ay, az;
+					// Gyro, and normalised gyro
+					float gx, gy, gz, gzn;
+					// Reserved
+					float rx, ry, rz;
+				} axis;
+				struct {
+					// Accel
+					uint32_t ax, ay, az;
+					// Gyro, and normalised gyro
+					uint32_t gx, gy, gz, gzn;
+					// Reserved. With HEADER_FLAG_TIMESTAMPED, rx is a frame
+					// sequence number, and ry and rz the high and low words of
+					// the phone's monotonic clock, in microseconds, when the
+					// frame was sent.
+					uint32_t rx, ry, rz;
+				} raw;
+			};
+		} RawBinaryHeader;
+
+		typedef struct {
+			int32_t flags;
+			union {
+				struct {
+					uint32_t data1;
+					uint32_t data2;
+					uint32_t data3;
+				} raw;
+				struct {
+					float data1;
+					float data2;
+					float data3;
+				} floating;
+				struct {
+					int32_t data1;
+					int32_t data2;
+					int32_t data3;
+				} integer;
+			};
+		} RawBinaryElement;
+
+		/**
+		 * Start of a DPD2 delta frame. A delta frame carries the same information
+		 * as a DPAD frame, but only what has changed since the previous frame:
+		 *
+		 * Keyframes (DELTA_FLAG_KEYFRAME) begin with the layout, as varints:
+		 * header flags, number of elements, then each element's flags.
+		 *
+		 * Every frame then has:
+		 * - A varint bitmask of the sensor values in the header which changed,
+		 *   followed by each one as a zigzag varint of the change in units of
+		 *   1 / DELTA_SENSOR_SCALE. Timestamps in the reserved values are
+		 *   sent as changes to the integers.
+		 * - A bitmask of changed elements, one bit per element, least
+		 *   significant bit first.
+		 * - One bit for each changed button, packed in the same way.
+		 * - For each other changed element, its three data words as zigzag
+		 *   varints of the change.
+		 *
+		 * In a keyframe, everything is sent as changed from zero.
+		 */
+		typedef struct {
+			// In this case, "DPD2"
+			BinarySignature sig;
+			uint8_t flags;
+			// Increments with each frame, so that gaps can be detected
+			uint8_t sequence;
+			// Length of the rest of the frame
+			uint16_t length;
+		} DeltaFrameHeader;
+
+		// A message from the server to the phone.
+		typedef struct {
+			BinarySignature sig;
+			int32_t msg;
+		} BinaryServerMessage;
+
+		// A CMD_PING message, which has an id after the usual fields.
+		typedef struct {
+			BinarySignature sig;
+			int32_t msg;
+			uint32_t id;
+		} BinaryPingMessage;
+
+		/**
+		 * The phone's reply to a ping, "DPNG". Times are on the same clock as
+		 * frame timestamps, in microseconds, split into high and low words.
+		 */
+		typedef struct {
+			BinarySignature sig;
+			uint32_t id;
+			// When the ping arrived
+			uint32_t receiveHigh, receiveLow;
+			// When this reply was sent
+			uint32_t sendHigh, sendLow;
+		} BinaryPong;
+	};
+};
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "receiveLoop.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "atomics.hpp"
+#include "log.hpp"
+
+// Entries in the submission ring; completions get twice as many
+#define URING_ENTRIES 64
+// Buffer group the receive buffers are provided in
+#define URING_BUFFER_GROUP 0
+// Events taken from epoll at a time
+#define EPOLL_EVENTS 64
+
+using namespace droidpad;
+using namespace std;
+
+ReceiveSink::~ReceiveSink() { }
+
+ReceiveLoop::~ReceiveLoop() { }
+
+ReceiveLoop *ReceiveLoop::Create() {
+	UringReceiveLoop *uring = new UringReceiveLoop;
+	if(uring->IsOpen()) return uring;
+	delete uring;
+	LOGV("io_uring not available, receiving with epoll");
+
+	EpollReceiveLoop *epoll = new EpollReceiveLoop;
+	if(epoll->IsOpen()) return epoll;
+	delete epoll;
+	return NULL;
+}
+
+EpollReceiveLoop::EpollReceiveLoop() :
+	epollFd(epoll_create(EPOLL_EVENTS))
+{ }
+
+EpollReceiveLoop::~EpollReceiveLoop() {
+	if(epollFd >= 0) close(epollFd);
+}
+
+bool EpollReceiveLoop::Add(int fd, ReceiveSink *sink) {
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) return false;
+	if((size_t)fd >= sinks.size()) sinks.resize(fd + 1, NULL);
+	sinks[fd] = sink;
+	return true;
+}
+
+void EpollReceiveLoop::Remove(int fd) {
+	if((size_t)fd >= sinks.size() || sinks[fd] == NULL) return;
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+	sinks[fd] = NULL;
+}
+
+int EpollReceiveLoop::Poll(int timeout) {
+	struct epoll_event events[EPOLL_EVENTS];
+	int count = epoll_wait(epollFd, events, EPOLL_EVENTS, timeout);
+	if(count < 0) return errno == EINTR ? 0 : -1;
+
+	int blocks = 0;
+	for(int i = 0; i < count; i++) {
+		int fd = events[i].data.fd;
+		if(sinks[fd] == NULL) continue; // Removed by an earlier sink
+		int length = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if(length > 0) {
+			sinks[fd]->Received(buffer, length);
+			blocks++;
+		} else if(length == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+			ReceiveSink *sink = sinks[fd];
+			Remove(fd);
+			sink->Closed();
+		}
+	}
+	return blocks;
+}
+
+static inline int uringSetup(unsigned entries, struct io_uring_params *params) {
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int uringEnter(int fd, unsigned submit, unsigned wait, unsigned flags, void *arg, size_t argSize) {
+	return syscall(__NR_io_uring_enter, fd, submit, wait, flags, arg, argSize);
+}
+
+static inline int uringRegister(int fd, unsigned opcode, void *arg, unsigned args) {
+	return syscall(__NR_io_uring_register, fd, opcode, arg, args);
+}
+
+UringReceiveLoop::UringReceiveLoop() :
+	ringFd(-1),
+	sqMap(MAP_FAILED),
+	cqMap(MAP_FAILED),
+	sqes((struct io_uring_sqe *)MAP_FAILED),
+	pendingSubmit(0),
+	bufRing((struct io_uring_buf_ring *)MAP_FAILED),
+	buffers(NULL),
+	bufTail(0)
+{
+#ifdef IORING_RECV_MULTISHOT
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	ringFd = uringSetup(URING_ENTRIES, &params);
+	if(ringFd < 0) return;
+	// Needed for the timeout in Poll
+	if(!(params.features & IORING_FEAT_EXT_ARG)) {
+		Close();
+		return;
+	}
+
+	sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+		sqMapSize = cqMapSize = max(sqMapSize, cqMapSize);
+	sqMap = mmap(NULL, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if(sqMap == MAP_FAILED) {
+		Close();
+		return;
+	}
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		cqMap = sqMap;
+	} else {
+		cqMap = mmap(NULL, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+		if(cqMap == MAP_FAILED) {
+			Close();
+			return;
+		}
+	}
+	sqes = (struct io_uring_sqe *)mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if(sqes == MAP_FAILED) {
+		Close();
+		return;
+	}
+
+	char *sq = (char *)sqMap, *cq = (char *)cqMap;
+	sqHead = (unsigned *)(sq + params.sq_off.head);
+	sqTail = (unsigned *)(sq + params.sq_off.tail);
+	sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+	sqArray = (unsigned *)(sq + params.sq_off.array);
+	cqHead = (unsigned *)(cq + params.cq_off.head);
+	cqTail = (unsigned *)(cq + params.cq_off.tail);
+	cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	// The buffer ring must be page aligned, which mmap gives
+	bufRingSize = RECEIVE_BUFFER_COUNT * sizeof(struct io_uring_buf);
+	bufRing = (struct io_uring_buf_ring *)mmap(NULL, bufRingSize, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	buffers = new char[RECEIVE_BUFFER_COUNT * RECEIVE_BUFFER_SIZE];
+	if(bufRing == MAP_FAILED) {
+		Close();
+		return;
+	}
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)bufRing;
+	reg.ring_entries = RECEIVE_BUFFER_COUNT;
+	reg.bgid = URING_BUFFER_GROUP;
+	// Provided buffer rings came after multishot receive (both 6.0)
+	if(uringRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+		Close();
+		return;
+	}
+	for(unsigned short i = 0; i < RECEIVE_BUFFER_COUNT; i++)
+		RecycleBuffer(i);
+#endif
+}
+
+UringReceiveLoop::~UringReceiveLoop() {
+	Close();
+}
+
+void UringReceiveLoop::Close() {
+	if(sqes != MAP_FAILED) munmap(sqes, URING_ENTRIES * sizeof(struct io_uring_sqe));
+	if(cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqMapSize);
+	if(sqMap != MAP_FAILED) munmap(sqMap, sqMapSize);
+	if(ringFd >= 0) close(ringFd);
+	// Unregistered when the ring closes
+	if(bufRing != MAP_FAILED) munmap(bufRing, bufRingSize);
+	delete[] buffers;
+	sqes = (struct io_uring_sqe *)MAP_FAILED;
+	sqMap = cqMap = MAP_FAILED;
+	bufRing = (struct io_uring_buf_ring *)MAP_FAILED;
+	buffers = NULL;
+	ringFd = -1;
+}
+
+struct io_uring_sqe *UringReceiveLoop::GetSqe() {
+	unsigned tail = *sqTail;
+	if(tail - LOAD_ACQUIRE(sqHead) > *sqMask) {
+		// Full, so hand what there is to the kernel first
+		if(uringEnter(ringFd, pendingSubmit, 0, 0, NULL, 0) < 0) return NULL;
+		pendingSubmit = 0;
+		if(tail - LOAD_ACQUIRE(sqHead) > *sqMask) return NULL;
+	}
+	unsigned index = tail & *sqMask;
+	struct io_uring_sqe *sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqArray[index] = index;
+	STORE_RELEASE(sqTail, tail + 1);
+	pendingSubmit++;
+	return sqe;
+}
+
+bool UringReceiveLoop::SubmitRecv(int fd) {
+#ifdef IORING_RECV_MULTISHOT
+	struct io_uring_sqe *sqe = GetSqe();
+	if(sqe == NULL) return false;
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUFFER_GROUP;
+	sqe->user_data = (__u64)generations[fd] << 32 | fd;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void UringReceiveLoop::RecycleBuffer(unsigned short id) {
+	// Not bufRing->bufs, which C++ puts after a padding byte; the ring is an
+	// array of io_uring_buf with the tail in the first one's resv.
+	struct io_uring_buf *buf = (struct io_uring_buf *)bufRing + (bufTail & (RECEIVE_BUFFER_COUNT - 1));
+	buf->addr = (unsigned long)(buffers + (size_t)id * RECEIVE_BUFFER_SIZE);
+	buf->len = RECEIVE_BUFFER_SIZE;
+	buf->bid = id;
+	STORE_RELEASE(&bufRing->tail, ++bufTail);
+}
+
+bool UringReceiveLoop::Add(int fd, ReceiveSink *sink) {
+	if((size_t)fd >= sinks.size()) {
+		sinks.resize(fd + 1, NULL);
+		generations.resize(fd + 1, 0);
+	}
+	generations[fd]++;
+	if(!SubmitRecv(fd)) return false;
+	sinks[fd] = sink;
+	return true;
+}
+
+void UringReceiveLoop::Remove(int fd) {
+	if((size_t)fd >= sinks.size() || sinks[fd] == NULL) return;
+	sinks[fd] = NULL;
+	// Completions still to come for fd are dropped in Poll
+	struct io_uring_sqe *sqe = GetSqe();
+	if(sqe == NULL) return;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (__u64)generations[fd] << 32 | fd;
+	sqe->user_data = (__u64)-1;
+}
+
+int UringReceiveLoop::Poll(int timeout) {
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	unsigned flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+	if(timeout >= 0) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (long long)(timeout % 1000) * 1000000;
+		arg.ts = (unsigned long)&ts;
+	}
+	if(uringEnter(ringFd, pendingSubmit, 1, flags, &arg, sizeof(arg)) < 0 &&
+			errno != ETIME && errno != EINTR)
+		return -1;
+	pendingSubmit = 0;
+
+	int blocks = 0;
+	unsigned head = *cqHead;
+	unsigned tail = LOAD_ACQUIRE(cqTail);
+	for(; head != tail; head++) {
+		const struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+		if(cqe->user_data == (__u64)-1) continue; // Cancellation
+		int fd = cqe->user_data & 0xFFFFFFFF;
+		bool hasBuffer = cqe->flags & IORING_CQE_F_BUFFER;
+		unsigned short id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		// Left over from a socket removed since, which may have had this fd.
+		// Any buffer it took still has to go back, or it is lost for good.
+		if(cqe->res == -ECANCELED || (size_t)fd >= sinks.size() || generations[fd] != cqe->user_data >> 32) {
+			if(hasBuffer) RecycleBuffer(id);
+			continue;
+		}
+		ReceiveSink *sink = sinks[fd];
+
+		if(cqe->res > 0 && hasBuffer && sink != NULL) {
+			sink->Received(buffers + (size_t)id * RECEIVE_BUFFER_SIZE, cqe->res);
+			blocks++;
+		}
+		if(hasBuffer) RecycleBuffer(id);
+		if(sink == NULL || sinks[fd] == NULL) continue;
+
+		if(cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS)) {
+			// Closed, or failed
+			sinks[fd] = NULL;
+			sink->Closed();
+		} else if(!(cqe->flags & IORING_CQE_F_MORE)) {
+			// The kernel stopped the receive, usually when it ran out of buffers
+			SubmitRecv(fd);
+		}
+	}
+	STORE_RELEASE(cqHead, head);
+	return blocks;
+}
@@ -0,0 +1,153 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_RECEIVE_LOOP_H
+#define DP_RECEIVE_LOOP_H
+
+#include <stddef.h>
+#include <vector>
+
+// Size of each buffer the kernel receives into, and how many there are
+#define RECEIVE_BUFFER_SIZE 4096
+#define RECEIVE_BUFFER_COUNT 256
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+namespace droidpad {
+	/**
+	 * Takes what arrives on one socket added to a ReceiveLoop.
+	 */
+	class ReceiveSink {
+		public:
+			virtual ~ReceiveSink();
+			/**
+			 * Called on the loop's thread with each block of bytes received.
+			 * data is only valid until this returns.
+			 */
+			virtual void Received(const char *data, size_t length) = 0;
+			/**
+			 * The socket was closed or failed. It has already been removed.
+			 */
+			virtual void Closed() = 0;
+	};
+
+	/**
+	 * Receives on many sockets from one thread, handing the bytes straight
+	 * to each socket's sink, for hosts running many phones at once. Only on
+	 * Linux.
+	 */
+	class ReceiveLoop {
+		public:
+			virtual ~ReceiveLoop();
+
+			/**
+			 * Makes the best loop available: io_uring where the kernel
+			 * supports multishot receives into provided buffers, otherwise
+			 * epoll. Returns NULL if neither can be made.
+			 */
+			static ReceiveLoop *Create();
+
+			virtual const char *Name() const = 0;
+
+			/**
+			 * Starts receiving on fd. The socket is only read from by the loop
+			 * until removed.
+			 */
+			virtual bool Add(int fd, ReceiveSink *sink) = 0;
+			/**
+			 * Stops receiving on fd. Its sink won't be called again.
+			 */
+			virtual void Remove(int fd) = 0;
+
+			/**
+			 * Waits up to timeout ms (-1 forever) for data, handing all that
+			 * has arrived to the sinks. Returns the number of blocks handed
+			 * over, or -1 on error.
+			 */
+			virtual int Poll(int timeout) = 0;
+	};
+
+	class EpollReceiveLoop : public ReceiveLoop {
+		public:
+			EpollReceiveLoop();
+			~EpollReceiveLoop();
+
+			inline bool IsOpen() const { return epollFd >= 0; }
+			const char *Name() const { return "epoll"; }
+			bool Add(int fd, ReceiveSink *sink);
+			void Remove(int fd);
+			int Poll(int timeout);
+
+		private:
+			int epollFd;
+			std::vector<ReceiveSink *> sinks;
+			char buffer[RECEIVE_BUFFER_SIZE];
+	};
+
+	/**
+	 * Each socket has a multishot receive outstanding, which the kernel
+	 * completes with a buffer from a ring shared with it whenever data
+	 * arrives, so there is no system call per socket or per packet; one
+	 * io_uring_enter collects everything. Buffers go back on the ring once
+	 * their sink has seen them.
+	 */
+	class UringReceiveLoop : public ReceiveLoop {
+		public:
+			UringReceiveLoop();
+			~UringReceiveLoop();
+
+			inline bool IsOpen() const { return ringFd >= 0; }
+			const char *Name() const { return "io_uring"; }
+			bool Add(int fd, ReceiveSink *sink);
+			void Remove(int fd);
+			int Poll(int timeout);
+
+		private:
+			int ringFd;
+
+			// Submission and completion rings, mapped from the kernel
+			void *sqMap, *cqMap;
+			size_t sqMapSize, cqMapSize;
+			struct io_uring_sqe *sqes;
+			unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+			unsigned *cqHead, *cqTail, *cqMask;
+			struct io_uring_cqe *cqes;
+			unsigned pendingSubmit;
+
+			// Provided buffers
+			struct io_uring_buf_ring *bufRing;
+			size_t bufRingSize;
+			char *buffers;
+			unsigned short bufTail;
+
+			std::vector<ReceiveSink *> sinks;
+			// Counts the sockets added with each fd, to tell completions for
+			// an old socket from those for a new one given the same fd
+			std::vector<unsigned> generations;
+
+			struct io_uring_sqe *GetSqe();
+			bool SubmitRecv(int fd);
+			void RecycleBuffer(unsigned short id);
+			void Close();
+	};
+};
+
+#endif
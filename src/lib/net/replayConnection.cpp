@@ -0,0 +1,140 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "replayConnection.hpp"
+
+#include <wx/utils.h>
+#include <iostream>
+
+#include "timing.hpp"
+#include "log.hpp"
+
+using namespace droidpad;
+using namespace droidpad::decode;
+using namespace droidpad::capture;
+using namespace std;
+
+ReplayConnection::ReplayConnection(const wxString &path, bool realtime) :
+	path(path),
+	realtime(realtime),
+	reader(NULL),
+	startTime(0),
+	firstRecordTime(0)
+{
+	cout << "Replaying capture " << path.mb_str() << endl;
+}
+
+ReplayConnection::~ReplayConnection() {
+	delete reader;
+}
+
+int ReplayConnection::Start()
+{
+	delete reader;
+	reader = NULL;
+	mode = ModeSetting();
+	try {
+		reader = new CaptureReader(string(path.mb_str()));
+	} catch (runtime_error err) {
+		LOGEwx(wxT("Error opening capture: ") + wxString(err.what(), wxConvUTF8));
+		return START_INITERROR;
+	}
+	try {
+		GetMode();
+	} catch (runtime_error err) {
+		LOGEwx(wxT("Error reading mode from capture: ") + wxString(err.what(), wxConvUTF8));
+		return START_HANDSHAKEERROR;
+	}
+	return START_SUCCESS;
+}
+
+bool ReplayConnection::NextRecord(CaptureRecord &record) throw (runtime_error) {
+	if(!reader) throw runtime_error("Capture not open");
+	if(!reader->Next(record)) return false;
+
+	if(startTime == 0) {
+		startTime = monotonicNanos();
+		firstRecordTime = record.time;
+	}
+	if(realtime) {
+		uint64_t due = startTime + (record.time - firstRecordTime);
+		uint64_t now = monotonicNanos();
+		if(due > now) wxMicroSleep((due - now) / NANOS_PER_MICRO);
+	}
+	if(capture) capture->Write(record.type, record.data.c_str(), record.data.size(), monotonicNanos());
+	return true;
+}
+
+const ModeSetting &ReplayConnection::GetMode() throw (runtime_error)
+{
+	if(mode.initialised) return mode;
+	CaptureRecord record;
+	while(NextRecord(record)) {
+		switch(record.type) {
+			case RECORD_INFO:
+				if(record.data.size() < sizeof(BinaryConnectionInfo))
+					throw runtime_error("Connection info in capture is too short");
+				mode.SetConnectionInfo(getBinaryConnectionInfo(record.data.c_str()));
+				return mode;
+			case RECORD_TEXT: {
+				wxString line(record.data.c_str(), wxConvUTF8);
+				if(line.Contains(wxT("<MODE>"))) {
+					mode.ParseSettingsLine(line);
+					return mode;
+				}
+					  } break;
+		}
+	}
+	throw runtime_error("No mode found in capture");
+}
+
+const DPJSData ReplayConnection::GetData() throw (runtime_error)
+{
+	CaptureRecord record;
+	if(!NextRecord(record)) {
+		// Treat the end of the capture as the phone closing the connection
+		DPJSData data;
+		data.connectionClosed = true;
+		return data;
+	}
+	switch(record.type) {
+		case RECORD_FRAME: {
+			if(record.data.size() < sizeof(RawBinaryHeader))
+				throw runtime_error("Frame in capture is too short");
+			const char *buf = record.data.c_str();
+			RawBinaryHeader header = getBinaryHeader(buf);
+			if(record.data.size() < sizeof(RawBinaryHeader) + sizeof(RawBinaryElement) * header.numElements)
+				throw runtime_error("Frame in capture is too short");
+			return DecodeFrame(header, getBinaryElements(buf + sizeof(RawBinaryHeader), header.numElements));
+				   }
+		case RECORD_DELTA: {
+			RawBinaryHeader header;
+			vector<RawBinaryElement> elems;
+			// As live, frames until the next keyframe aren't output
+			if(!deltaDecoder.Decode(record.data.data(), record.data.size(), header, elems))
+				return NoInput();
+			return DecodeFrame(header, elems);
+				   }
+		case RECORD_TEXT:
+			if(record.data.size() > 0 && record.data[0] == '[')
+				return getTextData(record.data.data(), record.data.size());
+			break; // Config lines are ignored, as on a live connection
+	}
+	return NoInput();
+}
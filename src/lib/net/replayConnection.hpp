@@ -0,0 +1,76 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_REPLAY_CONNECTION_H
+#define DP_REPLAY_CONNECTION_H
+
+#include <wx/string.h>
+#include <stdint.h>
+#include <stdexcept>
+
+#include "net/connection.hpp"
+#include "net/capture.hpp"
+
+namespace droidpad {
+	/**
+	 * Plays back a capture file as if it were a phone, through the normal
+	 * decoding path.
+	 */
+	class ReplayConnection : public Connection {
+		public:
+			/**
+			 * If realtime is false, frames are returned as fast as they are asked for.
+			 */
+			ReplayConnection(const wxString &path, bool realtime = true);
+			virtual ~ReplayConnection();
+
+			virtual int Start();
+
+			virtual const ModeSetting &GetMode() throw (std::runtime_error);
+			virtual const decode::DPJSData GetData() throw (std::runtime_error);
+
+			// Whatever was recorded is what is played back.
+			inline virtual void RequestBinary() throw (std::runtime_error) { }
+			inline virtual void RequestDelta() throw (std::runtime_error) { }
+
+		protected:
+			// Recorded pongs aren't replayed, so there is nothing to ping
+			inline virtual void SendPing(uint32_t id) throw (std::runtime_error) { }
+			inline virtual void SendHeartbeat() throw (std::runtime_error) { }
+
+		private:
+			wxString path;
+			bool realtime;
+
+			capture::CaptureReader *reader;
+
+			// Local time which the first record is played at
+			uint64_t startTime;
+			// Capture time of the first record
+			uint64_t firstRecordTime;
+
+			/**
+			 * Gets the next record, waiting until it is due if realtime.
+			 * Returns false at the end of the capture.
+			 */
+			bool NextRecord(capture::CaptureRecord &record) throw (std::runtime_error);
+	};
+}
+
+#endif
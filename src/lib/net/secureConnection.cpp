@@ -31,6 +31,14 @@ using namespace std;
 #include <wx/intl.h>
 #include "data.hpp"
 #include "mathUtil.hpp"
+#include "timing.hpp"
+#include "socketOptions.hpp"
+#include <string.h>
+#ifdef OS_LINUX
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
 
 #ifdef DEBUG
 #define SSL_PRINT_ERRORS() { if(ERR_peek_error()) fprintf(stderr, "SSL Error at %s:%d:\n", __FILE__, __LINE__); ERR_print_errors_fp(stderr); }
@@ -52,25 +60,58 @@ int SecureConnection::thisReferenceId = -1;
 SecureConnection::SecureConnection(AndroidDevice &device) throw (runtime_error) :
 	host(device.ip),
 	port(wxString::Format(wxT("%d"), device.securePort)),
-	name(device.name)
+	name(device.name),
+	ssl(NULL),
+	netBio(NULL),
+	kernelTlsRx(false),
+	kernelTlsTx(false),
+	sock(-1)
 {
 	staticInitialise();
 
 	cout << "Secure connection starting on " << device.securePort << endl;
 	LOGVwx(wxString::Format(_("Connecting on %s:%d"), host.c_str(), device.securePort));
 	// SSL_library_init called in droidApp
-	tlsMethod = TLSv1_server_method();
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	tlsMethod = TLS_server_method();
+#else
+	tlsMethod = SSLv23_server_method();
+#endif
 	ctx = SSL_CTX_new(tlsMethod);
 	THROW_NULL(ctx, "Couldn't initialise SSL");
+	SSL_CTX_set_options(ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_CIPHER_SERVER_PREFERENCE);
+
+	// Older versions of the app only speak TLS 1.0 with CBC ciphers, so they
+	// stay allowed, but anything newer gets an AEAD cipher. ChaCha20 is only
+	// chosen if the phone prefers it, as phones without AES instructions do.
+	SSL_CTX_set_cipher_list(ctx, TLS_PSK_CIPHERS);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	SSL_CTX_set_min_proto_version(ctx, TLS1_VERSION);
+	// Level 0 is needed to allow TLS 1.0 at all in OpenSSL 3
+	SSL_CTX_set_security_level(ctx, 0);
+#endif
+#ifdef SSL_OP_PRIORITIZE_CHACHA
+	SSL_CTX_set_options(ctx, SSL_OP_PRIORITIZE_CHACHA);
+#endif
+#ifdef TLS1_3_VERSION
+	SSL_CTX_set_ciphersuites(ctx, TLS_13_CIPHERSUITES);
+	SSL_CTX_set_psk_find_session_callback(ctx, &SecureConnection::findPskSession);
+	// Phones connect afresh each time, so session tickets would go unused
+	SSL_CTX_set_num_tickets(ctx, 0);
+#endif
 
 	// Set up identity and PSK auth
 	SSL_CTX_use_psk_identity_hint(ctx, Data::computerUuidString().c_str());
 	SSL_CTX_set_psk_server_callback(ctx, &SecureConnection::checkPsk);
 
-	// Connection setup
-	netBio = BIO_new(BIO_s_connect());
-	BIO_set_conn_hostname(netBio, host.char_str());
-	BIO_set_conn_port(netBio, port.char_str());
+	if(Data::kernelTls) {
+#ifdef SSL_OP_ENABLE_KTLS
+		SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#else
+		LOGW("This version of OpenSSL can't use kernel TLS");
+#endif
+	}
+
 }
 
 SecureConnection::~SecureConnection() {
@@ -81,9 +122,18 @@ SecureConnection::~SecureConnection() {
 int SecureConnection::Start() throw (runtime_error) {
 	int err;
 	LOGV("SSL: Connecting");
+	// Made here rather than in the constructor, as the BIO is freed along
+	// with the SSL, and Start is called again after the connection is lost.
+	if(!netBio) {
+		netBio = BIO_new(BIO_s_connect());
+		BIO_set_conn_hostname(netBio, host.char_str());
+		BIO_set_conn_port(netBio, port.char_str());
+	}
 	if(BIO_do_connect(netBio) != 1) {
 		// Could not connect
 		SSL_PRINT_ERRORS();
+		BIO_free(netBio);
+		netBio = NULL;
 		return START_NETERROR;
 	}
 	LOGV("SSL: Connected");
@@ -108,7 +158,10 @@ int SecureConnection::Start() throw (runtime_error) {
 		RETURN_SSL(err, START_AUTHERROR);
 	}
 
-	LOGV("SSL: Connection created");
+	LOGVwx(wxString::Format(wxT("SSL: Connection created, using %s with %s"),
+				wxString(SSL_get_version(ssl), wxConvUTF8).c_str(),
+				wxString(SSL_get_cipher_name(ssl), wxConvUTF8).c_str()));
+	CheckKernelTls();
 
 	try {
 		StartCommunication();
@@ -117,6 +170,7 @@ int SecureConnection::Start() throw (runtime_error) {
 		Stop();
 		return START_HANDSHAKEERROR;
 	}
+	return START_SUCCESS;
 }
 
 // Stops the connection, whatever stage it is at. If the connection is currently open, will send a stop message, then disconnect.
@@ -124,12 +178,7 @@ void SecureConnection::Stop(bool sendStopMessage) throw (std::runtime_error) {
 	if(ssl) {
 		if(sendStopMessage) {
 		LOGV("Sending stop message");
-			BinaryServerMessage stop;
-			stop.sig.setCmd();
-			stop.msg = CMD_STOP;
-			HTON(stop.msg);
-			SSL_write(ssl, &stop, sizeof(BinaryServerMessage));
-			SSL_PRINT_ERRORS();
+			SendCommand(CMD_STOP);
 			LOGV("Stop message sent");
 		}
 
@@ -142,10 +191,95 @@ void SecureConnection::Stop(bool sendStopMessage) throw (std::runtime_error) {
 		// BIO is closed by SSL_free
 		netBio = NULL;
 	}
+	kernelTlsRx = kernelTlsTx = false;
+	sock = -1;
+	poller.Detach();
+}
+
+void SecureConnection::SendCommand(int32_t cmd) {
+	BinaryServerMessage msg;
+	msg.sig.setCmd();
+	msg.msg = cmd;
+	HTON(msg.msg);
+	SSL_write(ssl, &msg, sizeof(BinaryServerMessage));
+	SSL_PRINT_ERRORS();
+}
+
+void SecureConnection::RequestDelta() throw (std::runtime_error) {
+	if(!ssl) throw runtime_error("SSL connection lost");
+	SendCommand(CMD_DELTA);
+	LOGV("Delta request sent to phone");
+}
+
+void SecureConnection::SendHeartbeat() throw (std::runtime_error) {
+	if(!ssl) throw runtime_error("SSL connection lost");
+	SendCommand(CMD_HEARTBEAT);
+}
+
+void SecureConnection::SendPing(uint32_t id) throw (std::runtime_error) {
+	if(!ssl) throw runtime_error("SSL connection lost");
+	BinaryPingMessage msg;
+	msg.sig.setCmd();
+	msg.msg = CMD_PING;
+	msg.id = id;
+	HTON(msg.msg);
+	HTON(msg.id);
+	SSL_write(ssl, &msg, sizeof(BinaryPingMessage));
+}
+
+void SecureConnection::CheckKernelTls() {
+	if(!Data::kernelTls) return;
+	kernelTlsTx = BIO_get_ktls_send(SSL_get_wbio(ssl));
+	kernelTlsRx = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+	if(kernelTlsRx) sock = SSL_get_rfd(ssl);
+	if(kernelTlsRx && sock < 0) kernelTlsRx = false;
+
+	if(kernelTlsRx || kernelTlsTx)
+		LOGVwx(wxString::Format(wxT("Kernel TLS enabled for %s%s%s"),
+					kernelTlsRx ? wxT("receiving") : wxT(""),
+					kernelTlsRx && kernelTlsTx ? wxT(" and ") : wxT(""),
+					kernelTlsTx ? wxT("sending") : wxT("")));
+	else
+		// Usually the kernel has no tls module, or doesn't support the cipher
+		LOGVwx(wxString::Format(wxT("Kernel TLS not available for %s, using OpenSSL"),
+					wxString(SSL_get_cipher_name(ssl), wxConvUTF8).c_str()));
+}
+
+void SecureConnection::ReadFully(char *buf, size_t length) throw(std::runtime_error) {
+	while(length > 0) {
+		if(!ssl) throw runtime_error("SSL connection lost");
+		// Anything OpenSSL has already decrypted can be read straight away
+		if(poller.IsAttached() && (kernelTlsRx || SSL_pending(ssl) == 0) && !BusyWait())
+			throw runtime_error("Failed to read from stream");
+		int read;
+#ifdef OS_LINUX
+		if(kernelTlsRx) {
+			// Only application data can be read this way. Anything else (alerts,
+			// session tickets) makes recv fail with EIO, and is left for OpenSSL.
+			read = recv(sock, buf, length, 0);
+			if(read < 0 && errno == EINTR) continue;
+			if(read < 0 && errno == EIO) read = SSL_read(ssl, buf, length);
+		} else
+#endif
+			read = SSL_read(ssl, buf, length);
+		if(read < 1) throw runtime_error("Failed to read from stream");
+		buf += read;
+		length -= read;
+	}
 }
 
 void SecureConnection::StartCommunication() throw(std::runtime_error) {
 	GetMode();
+	LimitTimeoutToHeartbeats();
+
+	// The phone now streams continuously, so a silence means it has gone.
+	if(connectionTimeout > 0) {
+		int fd = SSL_get_rfd(ssl);
+		if(fd < 0 || !setSocketOptions(fd, getLivenessOptions(connectionTimeout)) ||
+				!setReceiveTimeout(fd, connectionTimeout))
+			LOGW("Couldn't set connection timeout");
+	}
+	StartBusyPoll(SSL_get_rfd(ssl));
 }
 
 const ModeSetting &SecureConnection::GetMode() throw (std::runtime_error) {
@@ -158,74 +292,104 @@ const ModeSetting &SecureConnection::GetMode() throw (std::runtime_error) {
 	const size_t amt = sizeof(decode::BinaryConnectionInfo);
 	char buf[amt];
 	memcpy(buf, &sig, sizeof(decode::BinarySignature));
-	if(SSL_read(ssl, buf + sizeof(decode::BinarySignature), amt - sizeof(BinarySignature)) < 1)
+	try {
+		ReadFully(buf + sizeof(decode::BinarySignature), amt - sizeof(BinarySignature));
+	} catch(runtime_error e) {
 		throw runtime_error("Failed to read full info from stream");
-
-	const decode::BinaryConnectionInfo info = decode::getBinaryConnectionInfo(buf);
+	}
+	if(capture) capture->Write(capture::RECORD_INFO, buf, amt, monotonicNanos());
 
 	// Set mode
-	mode.type = info.modeType;
-	mode.numRawAxes = info.rawDevices;
-	mode.numAxes = info.axes;
-	mode.numButtons = info.buttons;
-	mode.supportsBinary = true;
-	mode.initialised = true;
+	mode.SetConnectionInfo(decode::getBinaryConnectionInfo(buf));
 	return mode;
 }
 const decode::DPJSData SecureConnection::GetData() throw (std::runtime_error) {
+	HeartbeatIfDue();
+	if(mode.supportsTimestamps) PingIfDue();
 	decode::BinarySignature sig = getSignature();
+	if(sig.isDeltaFrame()) {
+		char frameHeader[sizeof(DeltaFrameHeader)];
+		memcpy(frameHeader, &sig, sizeof(BinarySignature));
+		ReadFully(frameHeader + sizeof(BinarySignature), sizeof(DeltaFrameHeader) - sizeof(BinarySignature));
+		vector<char> frame(getDeltaFrameLength(frameHeader));
+		memcpy(&frame[0], frameHeader, sizeof(DeltaFrameHeader));
+		ReadFully(&frame[sizeof(DeltaFrameHeader)], frame.size() - sizeof(DeltaFrameHeader));
+		if(capture) capture->Write(capture::RECORD_DELTA, &frame[0], frame.size(), monotonicNanos());
+
+		RawBinaryHeader header;
+		vector<RawBinaryElement> elems;
+		if(!deltaDecoder.Decode(&frame[0], frame.size(), header, elems)) {
+			LOGW("Couldn't decode delta frame, waiting for keyframe");
+			return NoInput();
+		}
+		return DecodeFrame(header, elems);
+	}
+	if(sig.isPong()) {
+		char pong[sizeof(BinaryPong)];
+		memcpy(pong, &sig, sizeof(BinarySignature));
+		ReadFully(pong + sizeof(BinarySignature), sizeof(BinaryPong) - sizeof(BinarySignature));
+		HandlePong(pong);
+		return NoInput();
+	}
 	if(!sig.isBinaryHeader())
-		return DPJSData();
+		return NoInput();
 	char *headerBuf = (char*)malloc(sizeof(RawBinaryHeader));
 	// Copy header in place
 	memcpy(headerBuf, &sig, sizeof(BinarySignature));
 
 	// Read rest of header
-	if(!ssl) throw runtime_error("SSL connection lost");
-	if(SSL_read(ssl, headerBuf + sizeof(BinarySignature),
-				sizeof(RawBinaryHeader) - sizeof(BinarySignature)) < 1)
+	try {
+		ReadFully(headerBuf + sizeof(BinarySignature), sizeof(RawBinaryHeader) - sizeof(BinarySignature));
+	} catch(runtime_error e) {
+		free(headerBuf);
 		throw runtime_error("Failed to read full header from stream");
+	}
 
 	RawBinaryHeader header = getBinaryHeader(headerBuf);
-	free(headerBuf);
 
 	size_t elementsSize = sizeof(RawBinaryElement) * header.numElements;
 	char *elementsBuf = (char*)malloc(elementsSize);
-	if(elementsSize > 0)
-		if(SSL_read(ssl, elementsBuf, elementsSize) < 1)
-			throw runtime_error("Failed to read elements from stream");
-
-	vector<RawBinaryElement> elems;
-	for(const char *elem = elementsBuf; elem < elementsBuf + elementsSize; elem += sizeof(RawBinaryElement)) {
-		elems.push_back(getBinaryElement(elem));
+	try {
+		ReadFully(elementsBuf, elementsSize);
+	} catch(runtime_error e) {
+		free(headerBuf);
+		free(elementsBuf);
+		throw runtime_error("Failed to read elements from stream");
 	}
 
+	if(capture) capture->Write(capture::RECORD_FRAME,
+			headerBuf, sizeof(RawBinaryHeader),
+			elementsBuf, elementsSize, monotonicNanos());
+
+	vector<RawBinaryElement> elems = getBinaryElements(elementsBuf, header.numElements);
+
+	free(headerBuf);
 	free(elementsBuf);
 
-	return getBinaryData(header, elems);
+	return DecodeFrame(header, elems);
 }
 
 decode::BinarySignature SecureConnection::getSignature() throw(std::runtime_error) {
 	decode::BinarySignature sig;
 	if(ssl) { // Read header
-		int read;
-		if((read = SSL_read(ssl, &sig, sizeof(decode::BinarySignature))) < 1) {
+		try {
+			ReadFully((char *)&sig, sizeof(decode::BinarySignature));
+		} catch(runtime_error e) {
 			LOGW("WARNING: Signature not read from stream");
-			// TODO: Should I stop here?
-			Stop();
+			// Usually the phone has gone quiet, so don't wait to tell it
+			Stop(false);
+			throw;
 		}
 	} else throw runtime_error("SSL not open");
 	return sig;
 }
 
-// Checks to see if a set of creds exists, and sends the PSK to SSL if it does.
-// Sends a fake PSK if not.
-unsigned int SecureConnection::checkPsk(SSL *ssl, const char *identity, unsigned char *psk, unsigned int max_psk_len) {
+bool SecureConnection::findPsk(SSL *ssl, const string &identity, string &psk) {
 	for(vector<Credentials>::iterator it = CredentialStore::begin();
 			it != CredentialStore::end(); ++it) {
-		if(it->deviceIdString().compare((string) identity) == 0) {
+		if(it->deviceIdString().compare(identity) == 0) {
 			// Known connection found
-			memcpy(psk, it->psk.c_str(), std::min((int)max_psk_len, (int)it->psk.size()));
+			psk = it->psk;
 
 			// Now that we have a valid key, update the name saved in the DB with the name given over mDNS, accessible in 'device'
 			SecureConnection *conn = (SecureConnection*)SSL_get_ex_data(ssl, thisReferenceId);
@@ -233,10 +397,42 @@ unsigned int SecureConnection::checkPsk(SSL *ssl, const char *identity, unsigned
 				it->deviceName = conn->name;
 				Data::savePreferences();
 			}
-
-			return it->psk.size();
+			return true;
 		}
 	}
 	LOGV("Failed to authenticate PSK");
-	return 0; // Indicates failure
+	return false;
+}
+
+// Checks to see if a set of creds exists, and sends the PSK to SSL if it does.
+// Used up to TLS 1.2.
+unsigned int SecureConnection::checkPsk(SSL *ssl, const char *identity, unsigned char *psk, unsigned int max_psk_len) {
+	string key;
+	if(!findPsk(ssl, identity, key))
+		return 0; // Indicates failure
+	memcpy(psk, key.c_str(), std::min((int)max_psk_len, (int)key.size()));
+	return key.size();
 }
+
+#ifdef TLS1_3_VERSION
+// TLS 1.3 equivalent of checkPsk. The PSK becomes a session, whose cipher
+// only sets the hash; any of TLS_13_CIPHERSUITES can still be negotiated.
+int SecureConnection::findPskSession(SSL *ssl, const unsigned char *identity, size_t identityLength, SSL_SESSION **session) {
+	*session = NULL;
+	string key;
+	if(!findPsk(ssl, string((const char *)identity, identityLength), key))
+		return 1; // No session, so the handshake fails
+	const unsigned char aes128GcmSha256[] = { 0x13, 0x01 };
+	const SSL_CIPHER *cipher = SSL_CIPHER_find(ssl, aes128GcmSha256);
+	SSL_SESSION *pskSession = SSL_SESSION_new();
+	if(cipher == NULL || pskSession == NULL ||
+			!SSL_SESSION_set1_master_key(pskSession, (const unsigned char *)key.c_str(), key.size()) ||
+			!SSL_SESSION_set_cipher(pskSession, cipher) ||
+			!SSL_SESSION_set_protocol_version(pskSession, TLS1_3_VERSION)) {
+		SSL_SESSION_free(pskSession);
+		return 0;
+	}
+	*session = pskSession;
+	return 1;
+}
+#endif
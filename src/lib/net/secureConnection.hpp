@@ -27,6 +27,13 @@
 
 #include "net/connection.hpp"
 
+// Ciphers offered up to TLS 1.2, best first. PSK alone keeps the CBC
+// ciphers used by older versions of the app.
+#define TLS_PSK_CIPHERS "PSK-AES128-GCM-SHA256:PSK-AES256-GCM-SHA384:PSK-CHACHA20-POLY1305:PSK"
+// TLS 1.3 ciphersuites, best first. All of these must use SHA256, the
+// hash of the sessions made from PSKs.
+#define TLS_13_CIPHERSUITES "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256"
+
 namespace droidpad {
 	class SecureConnection : public Connection {
 		public:
@@ -45,6 +52,11 @@ namespace droidpad {
 			// In this mode, binary comms is used all the time, so
 			// no need to request it.
 			inline virtual void RequestBinary() throw (std::runtime_error) { }
+			virtual void RequestDelta() throw (std::runtime_error);
+
+		protected:
+			virtual void SendPing(uint32_t id) throw (std::runtime_error);
+			virtual void SendHeartbeat() throw (std::runtime_error);
 
 		private:
 			wxString host, port, name;
@@ -60,13 +72,40 @@ namespace droidpad {
 			 */
 			decode::BinarySignature getSignature() throw(std::runtime_error);
 
+			/**
+			 * Sends a DCMD message to the phone
+			 */
+			void SendCommand(int32_t cmd);
+			/**
+			 * Reads exactly length bytes, throwing if the stream ends first
+			 */
+			void ReadFully(char *buf, size_t length) throw(std::runtime_error);
+
+			/**
+			 * Checks whether the kernel took over encryption after the handshake,
+			 * and if so reads from the socket directly from then on.
+			 */
+			void CheckKernelTls();
+
 			// SSL stuff
 			const SSL_METHOD *tlsMethod;
 			SSL_CTX *ctx;
 			SSL *ssl;
 			BIO *netBio;
 
+			// Whether the kernel is decrypting (rx) and encrypting (tx) records.
+			// With kernelTlsRx, application data is read with recv() on sock.
+			bool kernelTlsRx, kernelTlsTx;
+			int sock;
+
+			/**
+			 * Looks up the PSK of a paired phone by its identity.
+			 */
+			static bool findPsk(SSL *ssl, const std::string &identity, std::string &psk);
 			static unsigned int checkPsk(SSL *ssl, const char *identity, unsigned char *psk, unsigned int max_psk_len);
+#ifdef TLS1_3_VERSION
+			static int findPskSession(SSL *ssl, const unsigned char *identity, size_t identityLength, SSL_SESSION **session);
+#endif
 
 			/**
 			 * Initialises the static components of this class
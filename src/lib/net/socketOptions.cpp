@@ -0,0 +1,89 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "socketOptions.hpp"
+
+#ifdef OS_WIN32
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#include "log.hpp"
+
+using namespace droidpad;
+using namespace std;
+
+// Keepalive probes sent before giving up
+#define KEEPALIVE_PROBES 3
+
+SocketOption::SocketOption(int level, int name, int value) :
+	level(level),
+	name(name),
+	value(value)
+{ }
+
+vector<SocketOption> droidpad::getLivenessOptions(int timeout) {
+	vector<SocketOption> options;
+	// Frames are small and frequent, so shouldn't wait to be coalesced
+	options.push_back(SocketOption(IPPROTO_TCP, TCP_NODELAY, 1));
+	options.push_back(SocketOption(SOL_SOCKET, SO_KEEPALIVE, 1));
+	// Keepalive times are in whole seconds, so only help when the phone is
+	// idle; heartbeats and TCP_USER_TIMEOUT catch the rest.
+	int keepaliveSecs = timeout / 1000 > 1 ? timeout / 1000 : 1;
+#ifdef TCP_KEEPIDLE
+	options.push_back(SocketOption(IPPROTO_TCP, TCP_KEEPIDLE, keepaliveSecs));
+#endif
+#ifdef TCP_KEEPINTVL
+	options.push_back(SocketOption(IPPROTO_TCP, TCP_KEEPINTVL, keepaliveSecs));
+#endif
+#ifdef TCP_KEEPCNT
+	options.push_back(SocketOption(IPPROTO_TCP, TCP_KEEPCNT, KEEPALIVE_PROBES));
+#endif
+#ifdef TCP_USER_TIMEOUT
+	options.push_back(SocketOption(IPPROTO_TCP, TCP_USER_TIMEOUT, timeout));
+#endif
+	return options;
+}
+
+bool droidpad::setSocketOptions(int fd, const vector<SocketOption> &options) {
+	bool ok = true;
+	for(vector<SocketOption>::const_iterator it = options.begin(); it != options.end(); it++) {
+		if(setsockopt(fd, it->level, it->name, (const char *)&it->value, sizeof(int)) != 0) {
+			LOGV("Couldn't set socket option");
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+bool droidpad::setReceiveTimeout(int fd, int timeout) {
+#ifdef OS_WIN32
+	DWORD value = timeout;
+#else
+	struct timeval value;
+	value.tv_sec = timeout / 1000;
+	value.tv_usec = (timeout % 1000) * 1000;
+#endif
+	return setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&value, sizeof(value)) == 0;
+}
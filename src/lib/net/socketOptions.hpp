@@ -0,0 +1,59 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_SOCKET_OPTIONS_H
+#define DP_SOCKET_OPTIONS_H
+
+#include <vector>
+
+// Default time after which a silent phone is treated as lost, in ms
+#define DEFAULT_CONNECTION_TIMEOUT 250
+// Heartbeats sent to the phone in each connection timeout
+#define HEARTBEATS_PER_TIMEOUT 3
+
+namespace droidpad {
+	/**
+	 * A socket option with an int value, as passed to setsockopt.
+	 */
+	class SocketOption {
+		public:
+			SocketOption(int level, int name, int value);
+
+			int level, name, value;
+	};
+
+	/**
+	 * Options which make the kernel give up on a connection once nothing has
+	 * been acknowledged for timeout ms (TCP_USER_TIMEOUT, where supported), or
+	 * the phone stops answering keepalives.
+	 */
+	std::vector<SocketOption> getLivenessOptions(int timeout);
+
+	/**
+	 * Sets each option on fd. Returns false if any couldn't be set.
+	 */
+	bool setSocketOptions(int fd, const std::vector<SocketOption> &options);
+
+	/**
+	 * Makes blocking reads on fd fail after timeout ms without data.
+	 */
+	bool setReceiveTimeout(int fd, int timeout);
+};
+
+#endif
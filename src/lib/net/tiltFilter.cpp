@@ -0,0 +1,73 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tiltFilter.hpp"
+
+#include <cmath>
+
+#include "net/dataDecode.hpp"
+
+using namespace droidpad;
+using namespace droidpad::decode;
+
+// Wraps an angle difference into [-pi, pi]
+static inline float wrapAngle(float angle) {
+	while(angle > M_PI) angle -= 2 * M_PI;
+	while(angle < -M_PI) angle += 2 * M_PI;
+	return angle;
+}
+
+TiltFilter::TiltFilter() :
+	prevGx(0),
+	prevGy(0),
+	prevTime(0)
+{ }
+
+bool TiltFilter::Update(const RawBinaryHeader &header, uint64_t time) {
+	if(!(header.flags & HEADER_FLAG_HAS_ACCEL) || !(header.flags & HEADER_FLAG_HAS_GYRO))
+		return false;
+
+	Vec2 accel = accelToAngles(header.axis.ax, header.axis.ay, header.axis.az);
+	if(prevTime == 0 || time <= prevTime || time - prevTime > TILT_FILTER_MAX_GAP) {
+		tilt = accel;
+	} else {
+		// Like gz, gx and gy are angles the phone has integrated from its
+		// gyro, so the change since the last frame is the rotation. The
+		// accelerometer's x tilt is about the phone's y axis, in the
+		// opposite sense, and its y tilt about the x axis.
+		tilt.x -= wrapAngle(header.axis.gy - prevGy);
+		tilt.y += wrapAngle(header.axis.gx - prevGx);
+
+		float dt = (float)(time - prevTime) / NANOS_PER_SEC;
+		float alpha = TILT_FILTER_TIME_CONSTANT / (TILT_FILTER_TIME_CONSTANT + dt);
+		tilt.x = wrapAngle(tilt.x + wrapAngle(accel.x - tilt.x) * (1 - alpha));
+		tilt.y = wrapAngle(tilt.y + wrapAngle(accel.y - tilt.y) * (1 - alpha));
+	}
+	prevGx = header.axis.gx;
+	prevGy = header.axis.gy;
+	prevTime = time;
+	return true;
+}
+
+void TiltFilter::Apply(const RawBinaryHeader &header, uint64_t time, DPJSData &data) {
+	if(data.axes.size() < 2 || !Update(header, time)) return;
+	Vec2 axes = anglesToAxes(tilt);
+	data.axes[0] = axes.x;
+	data.axes[1] = axes.y;
+}
@@ -0,0 +1,91 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_TILT_FILTER_H
+#define DP_TILT_FILTER_H
+
+#include <stdint.h>
+
+#include "types.hpp"
+#include "net/protocol.hpp"
+#include "timing.hpp"
+
+// Time over which the accelerometer corrects the gyro's drift. Shorter
+// follows the accelerometer's noise more closely.
+#define TILT_FILTER_TIME_CONSTANT (0.5f)
+// After a gap this long, the tilt is taken from the accelerometer alone
+#define TILT_FILTER_MAX_GAP (250 * NANOS_PER_MILLI)
+
+namespace droidpad {
+	namespace decode {
+		class DPJSData;
+
+		/**
+		 * Fuses the accelerometer and gyro in a frame header into a tilt, with
+		 * a complementary filter. The gyro gives the change in tilt between
+		 * frames, which is smooth and immediate but drifts; the accelerometer
+		 * gives the absolute tilt, which is noisy. Each frame the gyro's
+		 * change is added, and the result pulled a little towards the
+		 * accelerometer, so the noise is filtered out without the lag a
+		 * moving average would add.
+		 *
+		 * This relies on the phone sending integrated angles, rather than
+		 * rates, as gx and gy, so is only used for phones which advertise
+		 * CAPABILITY_GYRO_ANGLES.
+		 */
+		class TiltFilter {
+			public:
+				TiltFilter();
+
+				/**
+				 * Adds a frame received at time, in monotonicNanos. Returns
+				 * false, and changes nothing, if the header doesn't have both
+				 * accelerometer and gyro.
+				 */
+				bool Update(const RawBinaryHeader &header, uint64_t time);
+
+				/**
+				 * Updates with a frame, then replaces the tilt axes decoded
+				 * from it with the fused tilt. Frames without both
+				 * accelerometer and gyro are left as they are.
+				 */
+				void Apply(const RawBinaryHeader &header, uint64_t time, DPJSData &data);
+
+				/**
+				 * The tilt, in radians, as from accelToAngles.
+				 */
+				inline const Vec2 &GetAngles() const { return tilt; }
+
+				/**
+				 * Forgets the filter's state, so the next frame starts again
+				 * from the accelerometer.
+				 */
+				inline void Reset() { prevTime = 0; }
+
+			private:
+				Vec2 tilt;
+				// Gyro angles in the previous frame
+				float prevGx, prevGy;
+				// 0 if there is no previous frame
+				uint64_t prevTime;
+		};
+	};
+};
+
+#endif
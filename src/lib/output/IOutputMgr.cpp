@@ -32,6 +32,8 @@ IOutputManager::~IOutputManager() {}
 
 void IOutputManager::BeginToStop() { }
 
+void IOutputManager::SendTouchContacts(const vector<TouchContact>& contacts) { }
+
 OutputException::OutputException(int error, string msg) :
 	runtime_error(msg),
 	error(error)
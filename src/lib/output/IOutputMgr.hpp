@@ -21,6 +21,7 @@
 #define DP_I_OUTPUT_MGR_H
 
 #include <stdexcept>
+#include <vector>
 
 namespace droidpad {
 	namespace decode {
@@ -28,6 +29,7 @@ namespace droidpad {
 		class DPMouseData;
 		class DPSlideData;
 		class DPTouchData;
+		class TouchContact;
 	}
 	class IOutputManager {
 		public:
@@ -43,6 +45,12 @@ namespace droidpad {
 			virtual void SendMouseData(const decode::DPMouseData& data, bool firstIteration = true) = 0;
 			virtual void SendTouchData(const decode::DPTouchData& data, bool firstIteration = true) = 0;
 			virtual void SendSlideData(const decode::DPSlideData& data, bool firstIteration = true) = 0;
+
+			/**
+			 * Sends the fingers on contact trackpads as multi-touch, one slot
+			 * per trackpad. Ignored where multi-touch isn't supported.
+			 */
+			virtual void SendTouchContacts(const std::vector<decode::TouchContact>& contacts);
 		protected:
 			int type;
 	};
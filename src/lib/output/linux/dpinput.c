@@ -26,18 +26,26 @@
 #include <linux/input.h>
 #include <linux/uinput.h>
 #include <errno.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 
-/* Non-Globals */
-struct input_event event;
-
 int trimMinMax(int val, int min, int max);
+static void flushEvents(dpInfo *info);
 
 char *uinput_filename[] = {"/dev/uinput", "/dev/input/uinput",
                            "/dev/misc/uinput"};
 
-#define RESET_EVENT()	memset(&event, 0, sizeof(event));	\
-      			gettimeofday(&event.time, NULL);
+/* Present once uinput is built in or loaded */
+#define UINPUT_SYSFS_PATH "/sys/class/misc/uinput"
+
+extern char **environ;
+
+/* Node found by the last probe. Once one has opened, it isn't probed again. */
+static int probeSucceeded = 0;
+static const char *uinputPath = NULL;
 
 __u16 joystickKeys[] = {
 BTN_A,		// Gamepad - from linux/input.h
@@ -100,60 +108,119 @@ ABS_VOLUME,
 ABS_MISC,
 };
 
+/* Runs modprobe directly, without a shell. */
+static void loadUInputModule()
+{
+	char *argv[] = {"modprobe", "uinput", NULL};
+	pid_t pid;
+	if(posix_spawnp(&pid, "modprobe", NULL, NULL, argv, environ) == 0)
+		waitpid(pid, NULL, 0);
+}
+
 int dpinput_checkUInput() {
-	system("modprobe uinput"); // Some systems don't have this, try it anyway.
-	
+	struct stat st;
 	int file, i;
+	int result = CHECKRESULT_NOTFOUND;
+	if(probeSucceeded) return CHECKRESULT_SUCCESS;
+	
+	if(stat(UINPUT_SYSFS_PATH, &st) != 0)
+		loadUInputModule(); // Some systems don't have this, try it anyway.
+	
 	for (i = 0; i < ARRAY_COUNT(uinput_filename, char *); i++)
 	{
 		if ((file = open(uinput_filename[i], O_RDWR)) >= 0)
 		{
 			close(file);
-			return CHECKRESULT_SUCCESS; // Worked.
-		} else {
-			switch(errno) {
-				case EACCES:
-					return CHECKRESULT_PERMS;
-			}
+			uinputPath = uinput_filename[i];
+			result = CHECKRESULT_SUCCESS; // Worked.
+			break;
+		} else if(errno == EACCES) {
+			uinputPath = uinput_filename[i];
+			result = CHECKRESULT_PERMS;
+			break;
 		}
 	}
-	return CHECKRESULT_NOTFOUND;
+	// Failures aren't kept, so that loading uinput or fixing its
+	// permissions works without restarting.
+	probeSucceeded = result == CHECKRESULT_SUCCESS;
+	return result;
 }
 
-int dpinput_setup(dpInfo *info, int type)
+int dpinput_axisCode(int type, int index)
 {
-	struct uinput_user_dev uinp;
-	if(info == NULL) return -2;
-	info->type = type;
-	
-	int i=0, retcode;
-	
-	for (i = 0; i < ARRAY_COUNT(uinput_filename, char *); i++)
-	{
-		if ((info->ufile = open(uinput_filename[i], O_RDWR)) >= 0)
-		{
-			break;
-		}
-	}
-	if (info->ufile < 0) {
-		printf(" ** unable to open uinput, possibly not root / uinput not loaded?\n ** Trying to load uinput kernmod...\n");
+	if(index < 0) return -1;
+	switch(type) {
+		case TYPE_JS:
+			return index < ARRAY_COUNT(joystickAxes, __u16) ? joystickAxes[index] : -1;
+		case TYPE_TOUCHSCREEN:
+		case TYPE_MULTITOUCH:
+			return index == 0 ? ABS_X : index == 1 ? ABS_Y : -1;
+		default:
+			return -1;
 	}
-	system("modprobe uinput");
-	
-	for (i = 0; i < ARRAY_COUNT(uinput_filename, char *); i++)
-	{
-		if ((info->ufile = open(uinput_filename[i], O_RDWR)) >= 0)
-		{
-			break;
-		}
+}
+
+/* The code joystick axis index is sent as, which the caller may have chosen. */
+static __u16 joystickAxisCode(const dpInfo *info, int index)
+{
+	if(info->axisInfo != NULL && index < info->axisNum && info->axisInfo[index].code >= 0)
+		return info->axisInfo[index].code;
+	return joystickAxes[index];
+}
+
+/* Fills in the kernel's description of the axis at index, or the defaults if index is -1. */
+static void getAbsInfo(const dpInfo *info, int index, struct input_absinfo *abs)
+{
+	memset(abs, 0, sizeof(*abs));
+	if(info->axisInfo != NULL && index >= 0 && index < info->axisNum) {
+		abs->minimum = info->axisInfo[index].min;
+		abs->maximum = info->axisInfo[index].max;
+		abs->fuzz = info->axisInfo[index].fuzz;
+		abs->flat = info->axisInfo[index].flat;
+		abs->resolution = info->axisInfo[index].resolution;
+	} else {
+		abs->minimum = info->axisMin;
+		abs->maximum = info->axisMax;
 	}
-	if (info->ufile < 0) {
-		printf(" ** unable to open uinput (second time), probably not root.\n");
+}
+
+#ifdef UI_DEV_SETUP
+/*
+ * Describes the device with UI_DEV_SETUP and each axis with UI_ABS_SETUP.
+ * Fails on kernels older than 4.5, which only take uinput_user_dev.
+ */
+static int setupDevice(int ufile, const char *name, const __u16 absCodes[], const struct input_absinfo absInfo[], int absCount)
+{
+	struct uinput_setup setup;
+	struct uinput_abs_setup absSetup;
+	int i;
+
+	memset(&setup, 0, sizeof(setup));
+	strncpy(setup.name, name, UINPUT_MAX_NAME_SIZE - 1);
+	setup.id.version = 4;
+	setup.id.bustype = BUS_USB;
+	if(ioctl(ufile, UI_DEV_SETUP, &setup) < 0)
 		return -1;
+
+	for(i = 0; i < absCount; i++) {
+		memset(&absSetup, 0, sizeof(absSetup));
+		absSetup.code = absCodes[i];
+		absSetup.absinfo = absInfo[i];
+		if(ioctl(ufile, UI_ABS_SETUP, &absSetup) < 0)
+			return -1;
 	}
-	
+	return 0;
+}
+#endif
+
+/* Describes the device by writing uinput_user_dev, which has no resolution. */
+static int setupDeviceLegacy(dpInfo *info, const char *name, const __u16 absCodes[], const struct input_absinfo absInfo[], int absCount)
+{
+	struct uinput_user_dev uinp;
+	int i;
+
 	memset(&uinp, 0, sizeof(uinp));
-	strncpy(uinp.name, "DroidPad", 20);
+	strncpy(uinp.name, name, UINPUT_MAX_NAME_SIZE - 1);
 	uinp.id.version = 4;
 	uinp.id.bustype = BUS_USB;
 	
@@ -162,14 +229,51 @@ int dpinput_setup(dpInfo *info, int type)
 		uinp.absmax[i] = info->axisMax;
 		uinp.absmin[i] = info->axisMin;
 	}
+	for(i = 0; i < absCount; i++)
+	{
+		uinp.absmin[absCodes[i]] = absInfo[i].minimum;
+		uinp.absmax[absCodes[i]] = absInfo[i].maximum;
+		uinp.absfuzz[absCodes[i]] = absInfo[i].fuzz;
+		uinp.absflat[absCodes[i]] = absInfo[i].flat;
+	}
+	
+	if(write(info->ufile, &uinp, sizeof(uinp)) != sizeof(uinp))
+		return -1;
+	return 0;
+}
+
+int dpinput_setup(dpInfo *info, int type)
+{
+	__u16 absCodes[ABS_CNT];
+	struct input_absinfo absInfo[ABS_CNT];
+	int absCount = 0;
+	const char *name = type == TYPE_MULTITOUCH ? "DroidPad Touchpad" : "DroidPad";
+	if(info == NULL) return -2;
+	info->type = type;
+	info->batchCount = 0;
+	info->reportDepth = 0;
+	
+	int i=0, retcode;
+	
+	if (dpinput_checkUInput() != CHECKRESULT_SUCCESS) {
+		printf(" ** unable to find uinput, possibly not root / uinput not loaded?\n");
+		return -1;
+	}
+	if ((info->ufile = open(uinputPath, O_RDWR)) < 0) {
+		printf(" ** unable to open %s.\n", uinputPath);
+		return -1;
+	}
 	
 	ioctl(info->ufile, UI_SET_EVBIT, EV_SYN);
 	ioctl(info->ufile, UI_SET_EVBIT, EV_KEY);
 	switch(type) {
 		case TYPE_JS:
 			ioctl(info->ufile, UI_SET_EVBIT, EV_ABS);
-			for(i = 0; i < info->axisNum; i++)
-				ioctl(info->ufile, UI_SET_ABSBIT, joystickAxes[i]);
+			for(i = 0; i < info->axisNum && i < ARRAY_COUNT(joystickAxes, __u16); i++) {
+				ioctl(info->ufile, UI_SET_ABSBIT, joystickAxisCode(info, i));
+				absCodes[absCount] = joystickAxisCode(info, i);
+				getAbsInfo(info, i, &absInfo[absCount++]);
+			}
 			for(i = 0; i < info->buttonNum; i++)
 				ioctl(info->ufile, UI_SET_KEYBIT, joystickKeys[i]);
 			break;
@@ -178,6 +282,9 @@ int dpinput_setup(dpInfo *info, int type)
 			ioctl(info->ufile, UI_SET_RELBIT, REL_X);
 			ioctl(info->ufile, UI_SET_RELBIT, REL_Y);
 			ioctl(info->ufile, UI_SET_RELBIT, REL_WHEEL);
+#ifdef REL_WHEEL_HI_RES
+			ioctl(info->ufile, UI_SET_RELBIT, REL_WHEEL_HI_RES);
+#endif
 			
 			ioctl(info->ufile, UI_SET_KEYBIT, BTN_LEFT);
 			ioctl(info->ufile, UI_SET_KEYBIT, BTN_MIDDLE);
@@ -188,7 +295,20 @@ int dpinput_setup(dpInfo *info, int type)
 			ioctl(info->ufile, UI_SET_ABSBIT, ABS_X);
 			ioctl(info->ufile, UI_SET_ABSBIT, ABS_Y);
 			ioctl(info->ufile, UI_SET_ABSBIT, ABS_PRESSURE);
-			ioctl(info->ufile, UI_SET_RELBIT, ABS_WHEEL);
+			ioctl(info->ufile, UI_SET_EVBIT, EV_REL);
+			ioctl(info->ufile, UI_SET_RELBIT, REL_WHEEL);
+#ifdef REL_WHEEL_HI_RES
+			ioctl(info->ufile, UI_SET_RELBIT, REL_WHEEL_HI_RES);
+#endif
+			absCodes[absCount] = ABS_X;
+			getAbsInfo(info, 0, &absInfo[absCount++]);
+			absCodes[absCount] = ABS_Y;
+			getAbsInfo(info, 1, &absInfo[absCount++]);
+			// Always sent as axisMax while touching
+			absCodes[absCount] = ABS_PRESSURE;
+			getAbsInfo(info, -1, &absInfo[absCount]);
+			absInfo[absCount].minimum = 0;
+			absInfo[absCount++].maximum = info->axisMax;
 			
 			ioctl(info->ufile, UI_SET_KEYBIT, BTN_DIGI); // Indicates this is an absolute mouse
 			ioctl(info->ufile, UI_SET_KEYBIT, BTN_LEFT);
@@ -200,12 +320,56 @@ int dpinput_setup(dpInfo *info, int type)
 			for(i = 0; i < 128; i++)
 				ioctl(info->ufile, UI_SET_KEYBIT, i);
 			break;
+		case TYPE_MULTITOUCH:
+			// A touchpad, so that the compositor resolves gestures
+			ioctl(info->ufile, UI_SET_PROPBIT, INPUT_PROP_POINTER);
+			ioctl(info->ufile, UI_SET_EVBIT, EV_ABS);
+			ioctl(info->ufile, UI_SET_ABSBIT, ABS_X);
+			ioctl(info->ufile, UI_SET_ABSBIT, ABS_Y);
+			ioctl(info->ufile, UI_SET_ABSBIT, ABS_MT_SLOT);
+			ioctl(info->ufile, UI_SET_ABSBIT, ABS_MT_TRACKING_ID);
+			ioctl(info->ufile, UI_SET_ABSBIT, ABS_MT_POSITION_X);
+			ioctl(info->ufile, UI_SET_ABSBIT, ABS_MT_POSITION_Y);
+			absCodes[absCount] = ABS_X;
+			getAbsInfo(info, 0, &absInfo[absCount++]);
+			absCodes[absCount] = ABS_Y;
+			getAbsInfo(info, 1, &absInfo[absCount++]);
+			absCodes[absCount] = ABS_MT_POSITION_X;
+			getAbsInfo(info, 0, &absInfo[absCount++]);
+			absCodes[absCount] = ABS_MT_POSITION_Y;
+			getAbsInfo(info, 1, &absInfo[absCount++]);
+			absCodes[absCount] = ABS_MT_SLOT;
+			getAbsInfo(info, -1, &absInfo[absCount]);
+			absInfo[absCount].minimum = 0;
+			absInfo[absCount++].maximum = DP_MAX_CONTACTS - 1;
+			absCodes[absCount] = ABS_MT_TRACKING_ID;
+			getAbsInfo(info, -1, &absInfo[absCount]);
+			absInfo[absCount].minimum = 0;
+			absInfo[absCount++].maximum = 0xffff;
+
+			ioctl(info->ufile, UI_SET_KEYBIT, BTN_LEFT);
+			ioctl(info->ufile, UI_SET_KEYBIT, BTN_TOUCH);
+			ioctl(info->ufile, UI_SET_KEYBIT, BTN_TOOL_FINGER);
+			ioctl(info->ufile, UI_SET_KEYBIT, BTN_TOOL_DOUBLETAP);
+			ioctl(info->ufile, UI_SET_KEYBIT, BTN_TOOL_TRIPLETAP);
+			ioctl(info->ufile, UI_SET_KEYBIT, BTN_TOOL_QUADTAP);
+			break;
 	}
 	
 	if(info->buttonNum > ARRAY_COUNT(joystickKeys, __u16))
 		info->buttonNum = ARRAY_COUNT(joystickKeys, __u16);
 	
-	retcode = write(info->ufile, &uinp, sizeof(uinp));
+	retcode = -1;
+#ifdef UI_DEV_SETUP
+	retcode = setupDevice(info->ufile, name, absCodes, absInfo, absCount);
+#endif
+	if(retcode < 0)
+		retcode = setupDeviceLegacy(info, name, absCodes, absInfo, absCount);
+	if(retcode < 0) {
+		printf(" ** Error describing uinput device.\n");
+		close(info->ufile);
+		return -1;
+	}
 	
 	retcode = (ioctl(info->ufile, UI_DEV_CREATE));
 	if (retcode) {
@@ -219,15 +383,53 @@ int dpinput_setup(dpInfo *info, int type)
 	return 0;
 }
 
+/* Queues an event, writing the batch out first if it is full. */
+static void queueEvent(dpInfo *info, __u16 type, __u16 code, __s32 value)
+{
+	struct input_event *event;
+	if(info->batchCount == DP_BATCH_EVENTS) flushEvents(info);
+	event = &info->batch[info->batchCount++];
+	memset(event, 0, sizeof(*event));
+	event->type = type;
+	event->code = code;
+	event->value = value;
+}
+
+/* Writes every queued event in one go. The kernel timestamps them. */
+static void flushEvents(dpInfo *info)
+{
+	if(info->batchCount == 0) return;
+	if(write(info->ufile, info->batch, info->batchCount * sizeof(struct input_event)) < 0)
+		printf(" ** uinput write failed: %s\n", strerror(errno));
+	info->batchCount = 0;
+}
+
+/* Ends a report, unless one is being built up by dpinput_beginReport. */
+static void report(dpInfo *info)
+{
+	if(info->reportDepth > 0) return;
+	queueEvent(info, EV_SYN, SYN_REPORT, 0);
+	flushEvents(info);
+}
+
+void dpinput_beginReport(dpInfo *info)
+{
+	if(info == NULL) return;
+	info->reportDepth++;
+}
+
+void dpinput_endReport(dpInfo *info)
+{
+	if(info == NULL || info->reportDepth == 0) return;
+	if(--info->reportDepth == 0) report(info);
+}
+
 int dpinput_close(dpInfo *info)
 {
 	if(info == NULL) return -2;
-	RESET_EVENT();
-	
-	event.type = SYN_CONFIG;
-	event.code = 0;
-	event.value = 0;
-	write(info->ufile,&event,sizeof(event));
+	info->reportDepth = 0;
+	queueEvent(info, EV_SYN, SYN_CONFIG, 0);
+	flushEvents(info);
 	
 	ioctl(info->ufile, UI_DEV_DESTROY);
 	close(info->ufile);
@@ -236,126 +438,168 @@ int dpinput_close(dpInfo *info)
 	return 0;
 }
 
+int dpinput_reset(dpInfo *info)
+{
+	if(info == NULL) return -2;
+	int i;
+	
+	// The kernel drops events which don't change state, so releasing
+	// everything that could be down is cheap.
+	switch(info->type) {
+		case TYPE_JS:
+			for(i = 0; i < info->buttonNum; i++)
+				queueEvent(info, EV_KEY, joystickKeys[i], 0);
+			for(i = 0; i < info->axisNum && i < ARRAY_COUNT(joystickAxes, __u16); i++)
+				queueEvent(info, EV_ABS, joystickAxisCode(info, i), 0);
+			break;
+		case TYPE_MOUSE:
+		case TYPE_TOUCHSCREEN:
+			queueEvent(info, EV_KEY, BTN_LEFT, 0);
+			queueEvent(info, EV_KEY, BTN_MIDDLE, 0);
+			queueEvent(info, EV_KEY, BTN_RIGHT, 0);
+			if(info->type == TYPE_TOUCHSCREEN)
+				queueEvent(info, EV_ABS, ABS_PRESSURE, 0);
+			break;
+		case TYPE_KEYBD:
+			for(i = 0; i < 128; i++)
+				queueEvent(info, EV_KEY, i, 0);
+			break;
+		case TYPE_MULTITOUCH:
+			queueEvent(info, EV_KEY, BTN_LEFT, 0);
+			queueEvent(info, EV_KEY, BTN_TOUCH, 0);
+			queueEvent(info, EV_KEY, BTN_TOOL_FINGER, 0);
+			queueEvent(info, EV_KEY, BTN_TOOL_DOUBLETAP, 0);
+			queueEvent(info, EV_KEY, BTN_TOOL_TRIPLETAP, 0);
+			queueEvent(info, EV_KEY, BTN_TOOL_QUADTAP, 0);
+			// Lift every finger
+			for(i = 0; i < DP_MAX_CONTACTS; i++) {
+				queueEvent(info, EV_ABS, ABS_MT_SLOT, i);
+				queueEvent(info, EV_ABS, ABS_MT_TRACKING_ID, -1);
+			}
+			break;
+	}
+	
+	report(info);
+	return 0;
+}
+
 int dpinput_sendPos(dpInfo *info, int code, int val)
 {
 	if(info == NULL) return -2;
-	RESET_EVENT();
 	
 	if(info->type == TYPE_JS || info->type == TYPE_TOUCHSCREEN)
-		event.type = EV_ABS;
+		queueEvent(info, EV_ABS, code, trimMinMax(val, info->axisMin, info->axisMax));
 	else if(info->type == TYPE_MOUSE)
-		event.type = EV_REL;
-	event.code = code;
-	event.value = trimMinMax(val, info->axisMin, info->axisMax);
-	write(info->ufile, &event, sizeof(event));
+		queueEvent(info, EV_REL, code, trimMinMax(val, info->axisMin, info->axisMax));
 	
-	event.type = EV_SYN;
-	event.code = SYN_REPORT;
-	event.value = 0;
-	write(info->ufile, &event, sizeof(event));
+	report(info);
+	return 0;
 }
 
 int dpinput_send2Pos(dpInfo *info, int posX, int posY)
 {
 	if(info == NULL) return -2;
-	RESET_EVENT();
 	
 	if(info->type == TYPE_JS || info->type == TYPE_TOUCHSCREEN)
 	{
-		event.type = EV_ABS;
-		event.code = ABS_X;
-		event.value = trimMinMax(posX, info->axisMin, info->axisMax);
-		write(info->ufile, &event, sizeof(event));
-		event.code = ABS_Y;
-		event.value = trimMinMax(posY, info->axisMin, info->axisMax);
-		write(info->ufile, &event, sizeof(event));
-
-		event.code = ABS_PRESSURE;
-		event.value = info->axisMax;
-		write(info->ufile, &event, sizeof(event));
+		queueEvent(info, EV_ABS, ABS_X, trimMinMax(posX, info->axisMin, info->axisMax));
+		queueEvent(info, EV_ABS, ABS_Y, trimMinMax(posY, info->axisMin, info->axisMax));
+		queueEvent(info, EV_ABS, ABS_PRESSURE, info->axisMax);
 	}
 	else if(info->type == TYPE_MOUSE)
 	{
-		event.type = EV_REL;
-		event.code = REL_X;
-		event.value = posX;
-		write(info->ufile, &event, sizeof(event));
-		event.code = REL_Y;
-		event.value = posY;
-		write(info->ufile, &event, sizeof(event));
+		queueEvent(info, EV_REL, REL_X, posX);
+		queueEvent(info, EV_REL, REL_Y, posY);
 	}
 	
-	event.type = EV_SYN;
-	event.code = SYN_REPORT;
-	event.value = 0;
-	write(info->ufile, &event, sizeof(event));
+	report(info);
+	return 0;
 }
 
 int dpinput_sendNPos(dpInfo *info, int pos[], int count)
 {
 	if(info == NULL) return -2;
-	RESET_EVENT();
 	
 	if(info->type == TYPE_JS)
 	{
 		if(count > ARRAY_COUNT(joystickAxes, __u16))
 			count = ARRAY_COUNT(joystickAxes, __u16);
-		event.type = EV_ABS;
 		int i;
-		for(i = 0; i < count; i++)
-		{
-			event.code = joystickAxes[i]; // Send event for each button val
-			event.value = trimMinMax(pos[i], info->axisMin, info->axisMax);
-			write(info->ufile, &event, sizeof(event));
-		}
+		for(i = 0; i < count; i++) // Send event for each axis
+			queueEvent(info, EV_ABS, joystickAxisCode(info, i), trimMinMax(pos[i], info->axisMin, info->axisMax));
 	}
 	
-	event.type = EV_SYN;
-	event.code = SYN_REPORT;
-	event.value = 0;
-	write(info->ufile, &event, sizeof(event));
+	report(info);
+	return 0;
 }
 
 int dpinput_sendButtons(dpInfo *info, int buttons[], int count)
 {
 	if(info == NULL) return -2;
 	int i;
-	RESET_EVENT();
-	
-	//printf("Count: %d, Array has %d.\n", count, ARRAY_COUNT(joystickKeys, __u16));
 	
 	if(count > ARRAY_COUNT(joystickKeys, __u16))
 		count = ARRAY_COUNT(joystickKeys, __u16);
 	
-	event.type = EV_KEY;
 	for(i = 0; i < count; i++)
-	{
-		event.code = joystickKeys[i];
-		event.value = buttons[i];
-		write(info->ufile, &event, sizeof(event));
-	}
+		queueEvent(info, EV_KEY, joystickKeys[i], buttons[i]);
 	
-	event.type = EV_SYN;
-	event.code = SYN_REPORT;
-	event.value = 0;
-	write(info->ufile, &event, sizeof(event));
+	report(info);
+	return 0;
 }
 
 int dpinput_sendButton(dpInfo *info, int code, int val)
+{
+	if(info == NULL) return -2;
+	
+	queueEvent(info, EV_KEY, code, val);
+	
+	report(info);
+	return 0;
+}
+
+int dpinput_sendScroll(dpInfo *info, int hiRes, int notches)
+{
+	if(info == NULL) return -2;
+	
+#ifdef REL_WHEEL_HI_RES
+	queueEvent(info, EV_REL, REL_WHEEL_HI_RES, hiRes);
+#endif
+	if(notches != 0)
+		queueEvent(info, EV_REL, REL_WHEEL, notches);
+	
+	report(info);
+	return 0;
+}
+
+int dpinput_sendContacts(dpInfo *info, const dpContact contacts[], int count, int fingers, int pointerX, int pointerY)
 {
 	if(info == NULL) return -2;
 	int i;
-	RESET_EVENT();
 	
-	event.type = EV_KEY;
-	event.code = code;
-	event.value = val;
-	write(info->ufile, &event, sizeof(event));
+	for(i = 0; i < count; i++)
+	{
+		queueEvent(info, EV_ABS, ABS_MT_SLOT, contacts[i].slot);
+		queueEvent(info, EV_ABS, ABS_MT_TRACKING_ID, contacts[i].trackingId);
+		if(contacts[i].trackingId < 0) continue;
+		queueEvent(info, EV_ABS, ABS_MT_POSITION_X, trimMinMax(contacts[i].x, info->axisMin, info->axisMax));
+		queueEvent(info, EV_ABS, ABS_MT_POSITION_Y, trimMinMax(contacts[i].y, info->axisMin, info->axisMax));
+	}
+	if(fingers > 0)
+	{
+		queueEvent(info, EV_ABS, ABS_X, trimMinMax(pointerX, info->axisMin, info->axisMax));
+		queueEvent(info, EV_ABS, ABS_Y, trimMinMax(pointerY, info->axisMin, info->axisMax));
+	}
 	
-	event.type = EV_SYN;
-	event.code = SYN_REPORT;
-	event.value = 0;
-	write(info->ufile, &event, sizeof(event));
+	// Unchanged keys are dropped by the kernel
+	queueEvent(info, EV_KEY, BTN_TOUCH, fingers > 0);
+	queueEvent(info, EV_KEY, BTN_TOOL_FINGER, fingers == 1);
+	queueEvent(info, EV_KEY, BTN_TOOL_DOUBLETAP, fingers == 2);
+	queueEvent(info, EV_KEY, BTN_TOOL_TRIPLETAP, fingers == 3);
+	queueEvent(info, EV_KEY, BTN_TOOL_QUADTAP, fingers >= 4);
+	
+	report(info);
+	return 0;
 }
 
 int trimMinMax(int val, int min, int max)
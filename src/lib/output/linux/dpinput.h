@@ -27,6 +27,25 @@ extern "C" {
 #include <fcntl.h>
 #include <linux/input.h>
 
+/**
+ * Range and filtering of a single absolute axis, as given to the kernel.
+ * fuzz and flat are in axis units, resolution in units per radian for
+ * rotational axes or 0 when unknown. code is the ABS_ event code the axis
+ * is sent as, from dpinput_axisCode.
+ */
+typedef struct dpaxisinfo
+{
+	int code;
+	int min;
+	int max;
+	int fuzz;
+	int flat;
+	int resolution;
+} dpAxisInfo;
+
+/* Events held back to be written to uinput together */
+#define DP_BATCH_EVENTS 64
+
 typedef struct dpinfo
 {
 	int ufile;
@@ -35,15 +54,40 @@ typedef struct dpinfo
 	int buttonNum;
 	int axisNum;
 	int type;
+	// axisNum entries in the order of the axes sent, or NULL to use
+	// axisMin and axisMax with no filtering.
+	const dpAxisInfo *axisInfo;
+	// Events not yet written, so that each report takes one write()
+	struct input_event batch[DP_BATCH_EVENTS];
+	int batchCount;
+	// Nesting of dpinput_beginReport
+	int reportDepth;
 } dpInfo;
 
 enum {
 TYPE_JS,
 TYPE_MOUSE,
 TYPE_TOUCHSCREEN,
-TYPE_KEYBD
+TYPE_KEYBD,
+TYPE_MULTITOUCH
 };
 
+/* Slots on a TYPE_MULTITOUCH device */
+#define DP_MAX_CONTACTS 10
+
+/**
+ * A change to one multi-touch slot. axisInfo[0] and [1] give the range of
+ * x and y on a TYPE_MULTITOUCH device.
+ */
+typedef struct dpcontact
+{
+	int slot;
+	// -1 once the finger has been lifted
+	int trackingId;
+	int x;
+	int y;
+} dpContact;
+
 extern __u16 joystickKeys[];
 
 #define ARRAY_COUNT(_array, _vartype)	(sizeof(_array) / sizeof(_vartype))
@@ -57,17 +101,48 @@ extern __u16 joystickKeys[];
  * CHECKRESULT_SUCCESS on success
  * CHECKRESULT_NOTFOUND on not found
  * CHECKRESULT_PERMS on permission error.
+ * The module is only loaded if it is missing from sysfs. Once uinput has
+ * been found it is not probed again; failures are probed again each time.
  */
 int dpinput_checkUInput();
 
+/**
+ * The event code axis index of a device of the given type is sent as, or -1
+ * if it has no such axis.
+ */
+int dpinput_axisCode(int type, int index);
+
 int dpinput_setup(dpInfo *info, int type);
 int dpinput_close(dpInfo *info);
+/**
+ * Releases every button and key and centres every axis, so the device can
+ * be handed to the next session without anything held down.
+ */
+int dpinput_reset(dpInfo *info);
+
+/**
+ * Between these, the dpinput_send functions add to one report rather than
+ * each sending their own, so everything changed in a frame reaches readers
+ * at once, in a single write. They may be nested.
+ */
+void dpinput_beginReport(dpInfo *info);
+void dpinput_endReport(dpInfo *info);
 
 int dpinput_sendPos(dpInfo *info, int code, int val);
 int dpinput_send2Pos(dpInfo *info, int posX, int posY);
 int dpinput_sendNPos(dpInfo *info, int pos[], int count);
 int dpinput_sendButtons(dpInfo *info, int buttons[], int count);
 int dpinput_sendButton(dpInfo *info, int code, int val);
+/**
+ * Scrolls by hiRes 120ths of a notch, for readers of REL_WHEEL_HI_RES, and
+ * by whole notches for readers of REL_WHEEL. Both describe the same movement.
+ */
+int dpinput_sendScroll(dpInfo *info, int hiRes, int notches);
+/**
+ * Sends the slots which changed, using multi-touch protocol B, then the
+ * number of fingers down and the position of the pointer they emulate.
+ */
+int dpinput_sendContacts(dpInfo *info, const dpContact contacts[], int count, int fingers, int pointerX, int pointerY);
 
 #endif
 
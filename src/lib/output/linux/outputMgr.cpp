@@ -18,47 +18,52 @@
  * If not, see <http://www.gnu.org/licenses/>.
  */
 #include "outputMgr.hpp"
+#include "uinputPool.hpp"
 
 #include "types.hpp"
 #include "data.hpp"
+#include "log.hpp"
 
 #include "net/connection.hpp"
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 
 using namespace std;
 using namespace droidpad;
 using namespace droidpad::decode;
 
-OutputManager::OutputManager(const int type, const int numAxes, const int numButtons) :
-	IOutputManager(type, numAxes, numButtons)
-{
-	dpinput = new dpinfo;
-
-	dpinput->axisMin = -AXIS_SIZE;
-	dpinput->axisMax = AXIS_SIZE;
-	dpinput->buttonNum = numButtons;
-	dpinput->axisNum = numAxes;
-	int ret;
+/**
+ * The dpinput device type for a mode, or -1 if there isn't one.
+ */
+static int deviceType(const int type) {
 	switch(type) {
 		case MODE_JS:
-			ret = dpinput_setup(dpinput,TYPE_JS);
-			break;
+			return TYPE_JS;
 		case MODE_MOUSE:
-			ret = dpinput_setup(dpinput,TYPE_MOUSE);
-			break;
+			return TYPE_MOUSE;
 		case MODE_SLIDE:
-			ret = dpinput_setup(dpinput,TYPE_KEYBD);
-			break;
+			return TYPE_KEYBD;
 		case MODE_ABSMOUSE:
-			ret = dpinput_setup(dpinput,TYPE_TOUCHSCREEN);
-			break;
+			return TYPE_TOUCHSCREEN;
 		default:
-			delete dpinput;
-			throw invalid_argument("Invalid type");
+			return -1;
 	}
-	if(ret < 0) {
-		delete dpinput;
+}
+
+OutputManager::OutputManager(const int type, const int numAxes, const int numButtons, const uint32_t accelAxes, const uint32_t gyroAxes) :
+	IOutputManager(type, numAxes, numButtons),
+	wheelRemainder(0),
+	touchpad(NULL),
+	touchpadFailed(false),
+	nextTrackingId(0)
+{
+	int dpType = deviceType(type);
+	if(dpType < 0) throw invalid_argument("Invalid type");
+	axisInfo = DescribeAxes(type, numAxes, accelAxes, gyroAxes);
+	dpinput = UInputPool::Acquire(dpType, numButtons, axisInfo);
+	if(dpinput == NULL) {
 		throw OutputException(ERROR_NO_UINPUT, "Couldn't setup uinput");
 	}
 
@@ -69,13 +74,54 @@ OutputManager::OutputManager(const int type, const int numAxes, const int numBut
 }
 
 OutputManager::~OutputManager() {
-	dpinput_close(dpinput);
-	delete dpinput;
+	UInputPool::Release(dpinput);
 	dpinput = NULL;
+	UInputPool::Release(touchpad);
+	touchpad = NULL;
 	delete axesBuffer;
 	delete buttonBuffer;
 }
 
+vector<dpAxisInfo> OutputManager::DescribeAxes(const int type, const int numAxes, const uint32_t accelAxes, const uint32_t gyroAxes) {
+	vector<dpAxisInfo> axisInfo(numAxes);
+	for(int i = 0; i < numAxes; i++) {
+		dpAxisInfo &info = axisInfo[i];
+		info.code = dpinput_axisCode(deviceType(type), i);
+		info.min = -AXIS_SIZE;
+		info.max = AXIS_SIZE;
+		info.fuzz = SLIDER_FUZZ;
+		info.flat = 0;
+		info.resolution = 0;
+	}
+	if(type != MODE_JS) return axisInfo;
+
+	int accelSeen = 0;
+	for(int i = 0; i < numAxes && i < 32; i++) {
+		// Sensor axes span the tweaked angle linearly, so the noise in
+		// degrees maps to a fixed number of axis units. Sliders keep
+		// their description.
+		int totalAngle;
+		if(accelAxes & (1u << i)) // In x, y pairs
+			totalAngle = Data::tweaks.tilt[accelSeen++ % 2].totalAngle;
+		else if(gyroAxes & (1u << i))
+			totalAngle = Data::tweaks.rotation[0].totalAngle;
+		else continue;
+		if(totalAngle <= 0) continue;
+
+		// Axes are reordered before output, as in DPJSData::reorder, so the
+		// description of decoded axis i belongs where it is sent.
+		int destination = i < Data::axisOrder.size() ? Data::axisOrder[i] : i;
+		if(destination < 0 || destination >= numAxes) continue;
+		dpAxisInfo &info = axisInfo[destination];
+
+		float unitsPerDegree = (float)AXIS_SIZE * 2 / totalAngle;
+		info.fuzz = unitsPerDegree * SENSOR_FUZZ_CENTIDEGREES / 100;
+		info.flat = unitsPerDegree * SENSOR_FLAT_CENTIDEGREES / 100;
+		info.resolution = unitsPerDegree * 180 / M_PI;
+	}
+	return axisInfo;
+}
+
 void OutputManager::SendJSData(const DPJSData& data, bool firstIteration) {
 	int i = 0;
 	for(vector<int>::const_iterator it = data.axes.begin(); it != data.axes.end(); it++) {
@@ -86,28 +132,45 @@ void OutputManager::SendJSData(const DPJSData& data, bool firstIteration) {
 		buttonBuffer[i++] = *it;
 	}
 
+	// One report, and one write, for the whole frame
+	dpinput_beginReport(dpinput);
 	dpinput_sendNPos(dpinput, axesBuffer, axesBufferSize);
 	dpinput_sendButtons(dpinput, buttonBuffer, buttonBufferSize);
+	dpinput_endReport(dpinput);
 }
 
 void OutputManager::SendMouseData(const DPMouseData& data, bool firstIteration) {
-	dpinput_send2Pos(dpinput, data.x / 400, -data.y / 400); // TODO: Customise?
-	dpinput_sendPos(dpinput, REL_WHEEL, firstIteration ? (data.incrementalScrollDelta / 120) : 0);
+	dpinput_beginReport(dpinput);
+	dpinput_send2Pos(dpinput, data.x, -data.y);
+	sendScroll(data.scrollDelta);
 	dpinput_sendButton(dpinput, BTN_LEFT, data.bLeft);
 	dpinput_sendButton(dpinput, BTN_MIDDLE, data.bMiddle);
 	dpinput_sendButton(dpinput, BTN_RIGHT, data.bRight);
+	dpinput_endReport(dpinput);
 }
 
 void OutputManager::SendTouchData(const decode::DPTouchData& data, bool firstIteration) {
+	dpinput_beginReport(dpinput);
 	dpinput_send2Pos(dpinput, data.x, -data.y);
-	dpinput_sendPos(dpinput, ABS_WHEEL, firstIteration ? (data.incrementalScrollDelta / 120) : 0);
+	sendScroll(data.scrollDelta);
 	dpinput_sendButton(dpinput, BTN_LEFT, data.bLeft);
 	dpinput_sendButton(dpinput, BTN_MIDDLE, data.bMiddle);
 	dpinput_sendButton(dpinput, BTN_RIGHT, data.bRight);
+	dpinput_endReport(dpinput);
+}
+
+void OutputManager::sendScroll(int hiRes)
+{
+	if(hiRes == 0) return;
+	wheelRemainder += hiRes;
+	int notches = wheelRemainder / 120;
+	wheelRemainder -= notches * 120;
+	dpinput_sendScroll(dpinput, hiRes, notches);
 }
 
 void OutputManager::SendSlideData(const DPSlideData& data, bool firstIteration)
 {
+	dpinput_beginReport(dpinput);
 	dpinput_sendButton(dpinput,	KEY_UP,		data.prev);
 	dpinput_sendButton(dpinput,	KEY_DOWN,	data.next);
 	dpinput_sendButton(dpinput,	KEY_F5,		data.start);
@@ -116,8 +179,59 @@ void OutputManager::SendSlideData(const DPSlideData& data, bool firstIteration)
 	dpinput_sendButton(dpinput,	getKeycode(Data::blackKey), data.black);
 	dpinput_sendButton(dpinput,	KEY_HOME,	data.beginning);
 	dpinput_sendButton(dpinput,	KEY_END,	data.end);
+	dpinput_endReport(dpinput);
 }
 
+void OutputManager::SendTouchContacts(const vector<TouchContact>& contacts)
+{
+	if(touchpad == NULL) {
+		if(touchpadFailed) return;
+		vector<dpAxisInfo> touchpadAxes(2);
+		for(int i = 0; i < 2; i++) {
+			touchpadAxes[i].code = dpinput_axisCode(TYPE_MULTITOUCH, i);
+			touchpadAxes[i].min = -AXIS_SIZE;
+			touchpadAxes[i].max = AXIS_SIZE;
+			touchpadAxes[i].fuzz = SLIDER_FUZZ;
+			touchpadAxes[i].flat = 0;
+			touchpadAxes[i].resolution = AXIS_SIZE * 2 / TOUCHPAD_SIZE_MM;
+		}
+		touchpad = UInputPool::Acquire(TYPE_MULTITOUCH, 0, touchpadAxes);
+		if(touchpad == NULL) {
+			LOGW("Couldn't create multi-touch device");
+			touchpadFailed = true;
+			return;
+		}
+	}
+
+	// Only the slots which changed are sent
+	dpContact changed[DP_MAX_CONTACTS];
+	int numChanged = 0, fingers = 0;
+	int pointerX = 0, pointerY = 0;
+	size_t slots = max(contacts.size(), prevContacts.size());
+	for(size_t i = 0; i < slots && i < DP_MAX_CONTACTS; i++) {
+		TouchContact cur = i < contacts.size() ? contacts[i] : TouchContact();
+		TouchContact prev = i < prevContacts.size() ? prevContacts[i] : TouchContact();
+		if(cur.down) {
+			if(fingers++ == 0) {
+				pointerX = cur.x;
+				pointerY = cur.y;
+			}
+		}
+		if(cur.down == prev.down && (!cur.down || (cur.x == prev.x && cur.y == prev.y)))
+			continue;
+
+		dpContact &c = changed[numChanged++];
+		c.slot = i;
+		if(cur.down && !prev.down)
+			slotIds[i] = nextTrackingId++ & 0xffff;
+		c.trackingId = cur.down ? slotIds[i] : -1;
+		c.x = cur.x;
+		c.y = cur.y;
+	}
+	prevContacts = contacts;
+	if(numChanged == 0) return;
+	dpinput_sendContacts(touchpad, changed, numChanged, fingers, pointerX, pointerY);
+}
 
 int OutputManager::getKeycode(char letter) {
 	char lower = tolower(letter);
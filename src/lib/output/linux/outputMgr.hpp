@@ -22,6 +22,8 @@
 
 #include "dpinput.h"
 #include <stdexcept>
+#include <stdint.h>
+#include <vector>
 #include "platformSettings.hpp"
 #include "output/IOutputMgr.hpp"
 
@@ -29,22 +31,47 @@ namespace droidpad {
 	class OutputManager : public IOutputManager {
 		public:
 			/**
-			  Type is according to those in "types.hpp"
+			  Type is according to those in "types.hpp".
+			  accelAxes and gyroAxes mark the axes which come from the
+			  phone's sensors, as in DPJSData.
 			  */
-			OutputManager(const int type, const int numAxes, const int numButtons);
+			OutputManager(const int type, const int numAxes, const int numButtons, const uint32_t accelAxes = 0, const uint32_t gyroAxes = 0);
 			~OutputManager();
 
 			void SendJSData(const decode::DPJSData& data, bool firstIteration = true);
 			void SendMouseData(const decode::DPMouseData& data, bool firstIteration = true);
 			void SendTouchData(const decode::DPTouchData& data, bool firstIteration = true);
 			void SendSlideData(const decode::DPSlideData& data, bool firstIteration = true);
+			void SendTouchContacts(const std::vector<decode::TouchContact>& contacts);
 
 			/**
 			 * Given a letter of the alphabet, returns the Linux keycode associated with it.
 			 */
 			static int getKeycode(char letter);
+
+			/**
+			 * Describes each axis to the kernel, using the tweaks for the
+			 * sensor axes so that their noise is filtered out.
+			 */
+			static std::vector<dpAxisInfo> DescribeAxes(const int type, const int numAxes, const uint32_t accelAxes, const uint32_t gyroAxes);
 		private:
+
+			/**
+			 * Scrolls by hiRes 120ths of a notch, keeping the part of a notch
+			 * not yet sent as REL_WHEEL for next time.
+			 */
+			void sendScroll(int hiRes);
+
 			dpinfo *dpinput;
+			std::vector<dpAxisInfo> axisInfo;
+			int wheelRemainder;
+
+			// Separate device for contact trackpads, created when first used
+			dpinfo *touchpad;
+			bool touchpadFailed;
+			std::vector<decode::TouchContact> prevContacts;
+			int slotIds[DP_MAX_CONTACTS];
+			int nextTrackingId;
 
 			int *axesBuffer;
 			int axesBufferSize;
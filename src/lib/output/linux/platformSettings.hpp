@@ -25,4 +25,15 @@
 // For analogue axes, the 3 means that the axis rotates around a third of the axis.
 #define AXIS_CUTOFF_MULTIPLIER (AXIS_SIZE * 3)
 
+// Noise of the phone's sensors, in hundredths of a degree. The kernel drops
+// changes smaller than the fuzz before they reach evdev readers.
+#define SENSOR_FUZZ_CENTIDEGREES 25
+// Dead zone hinted to readers around the centre of sensor axes.
+#define SENSOR_FLAT_CENTIDEGREES 50
+// On-screen sliders and touch positions are already quantised by the phone.
+#define SLIDER_FUZZ (AXIS_SIZE / 1024)
+// Phone trackpads are taken to be this wide, in mm, to give the multi-touch
+// device a resolution. Compositors need one to scale gestures.
+#define TOUCHPAD_SIZE_MM 60
+
 #endif
@@ -0,0 +1,116 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "uinputPool.hpp"
+
+#include "log.hpp"
+#include "timing.hpp"
+#include "platformSettings.hpp"
+
+#include <wx/string.h>
+
+using namespace std;
+using namespace droidpad;
+
+vector<UInputPool::Device*> UInputPool::devices;
+wxMutex UInputPool::mutex;
+
+static bool sameAxis(const dpAxisInfo &a, const dpAxisInfo &b) {
+	return a.code == b.code &&
+		a.min == b.min && a.max == b.max &&
+		a.fuzz == b.fuzz && a.flat == b.flat &&
+		a.resolution == b.resolution;
+}
+
+bool UInputPool::Device::Matches(int type, int numButtons, const vector<dpAxisInfo> &axes) const {
+	if(inUse || info.type != type || this->numButtons != numButtons) return false;
+	if(this->axes.size() != axes.size()) return false;
+	for(size_t i = 0; i < axes.size(); i++) {
+		if(!sameAxis(this->axes[i], axes[i])) return false;
+	}
+	return true;
+}
+
+dpInfo *UInputPool::Acquire(int type, int numButtons, const vector<dpAxisInfo> &axes) {
+	wxMutexLocker lock(mutex);
+	for(vector<Device*>::iterator it = devices.begin(); it != devices.end(); it++) {
+		if((*it)->Matches(type, numButtons, axes)) {
+			LOGV("Reusing uinput device");
+			(*it)->inUse = true;
+			return &(*it)->info;
+		}
+	}
+
+	uint64_t start = monotonicNanos();
+	Device *device = new Device;
+	device->numButtons = numButtons;
+	device->axes = axes;
+	device->inUse = true;
+	device->info.axisMin = -AXIS_SIZE;
+	device->info.axisMax = AXIS_SIZE;
+	device->info.buttonNum = numButtons;
+	device->info.axisNum = axes.size();
+	device->info.axisInfo = device->axes.empty() ? NULL : &device->axes[0];
+	if(dpinput_setup(&device->info, type) < 0) {
+		delete device;
+		return NULL;
+	}
+	LOGVwx(wxString::Format(wxT("Created uinput device in %d us"),
+				(int)((monotonicNanos() - start) / NANOS_PER_MICRO)));
+	devices.push_back(device);
+	return &device->info;
+}
+
+void UInputPool::Release(dpInfo *info) {
+	if(info == NULL) return;
+	wxMutexLocker lock(mutex);
+	int idle = 0;
+	for(vector<Device*>::iterator it = devices.begin(); it != devices.end(); it++) {
+		if(&(*it)->info == info) {
+			dpinput_reset(info);
+			(*it)->inUse = false;
+		}
+		if(!(*it)->inUse) idle++;
+	}
+
+	// Drop the oldest idle devices, which were probably for older layouts
+	for(vector<Device*>::iterator it = devices.begin(); it != devices.end() && idle > UINPUT_POOL_MAX_IDLE; ) {
+		if((*it)->inUse) {
+			it++;
+			continue;
+		}
+		dpinput_close(&(*it)->info);
+		delete *it;
+		it = devices.erase(it);
+		idle--;
+	}
+}
+
+void UInputPool::Clear() {
+	wxMutexLocker lock(mutex);
+	for(vector<Device*>::iterator it = devices.begin(); it != devices.end(); ) {
+		if((*it)->inUse) {
+			it++;
+			continue;
+		}
+		dpinput_close(&(*it)->info);
+		delete *it;
+		it = devices.erase(it);
+	}
+}
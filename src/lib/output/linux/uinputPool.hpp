@@ -0,0 +1,73 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_UINPUT_POOL_H
+#define DP_UINPUT_POOL_H
+
+#include "dpinput.h"
+
+#include <vector>
+#include <wx/thread.h>
+
+// Idle devices kept open once their session has finished
+#define UINPUT_POOL_MAX_IDLE 4
+
+namespace droidpad {
+	/**
+	 * Keeps uinput devices open between sessions. Creating a device takes
+	 * dozens of ioctls and then a wait for udev to announce the new node, so
+	 * reconnecting with the same layout reuses the device from last time.
+	 */
+	class UInputPool {
+		public:
+			/**
+			 * Returns a device of the given type with these buttons and axes,
+			 * reusing an idle one if possible. Returns NULL if uinput
+			 * couldn't be set up.
+			 */
+			static dpInfo *Acquire(int type, int numButtons, const std::vector<dpAxisInfo> &axes);
+
+			/**
+			 * Resets the state of a device from Acquire and keeps it for the
+			 * next session.
+			 */
+			static void Release(dpInfo *info);
+
+			/**
+			 * Destroys all idle devices. Called on exit.
+			 */
+			static void Clear();
+		private:
+			class Device {
+				public:
+					dpInfo info;
+					int numButtons;
+					std::vector<dpAxisInfo> axes;
+					bool inUse;
+
+					bool Matches(int type, int numButtons, const std::vector<dpAxisInfo> &axes) const;
+			};
+
+			// Oldest first
+			static std::vector<Device*> devices;
+			static wxMutex mutex;
+	};
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "outputEventRing.hpp"
+
+#include "atomics.hpp"
+
+using namespace droidpad;
+
+OutputEventRing::OutputEventRing(size_t capacity) :
+	head(0),
+	tail(0),
+	dropped(0)
+{
+	size_t size = 1;
+	while(size < capacity) size <<= 1;
+	events = new OutputEvent[size];
+	mask = size - 1;
+}
+
+OutputEventRing::~OutputEventRing() {
+	delete[] events;
+}
+
+bool OutputEventRing::Push(const OutputEvent &event) {
+	size_t h = LOAD_RELAXED(&head);
+	if(h - LOAD_ACQUIRE(&tail) > mask) {
+		ADD_RELAXED(&dropped, 1);
+		return false;
+	}
+	events[h & mask] = event;
+	STORE_RELEASE(&head, h + 1);
+	return true;
+}
+
+bool OutputEventRing::Pop(OutputEvent &event) {
+	size_t t = LOAD_RELAXED(&tail);
+	if(t == LOAD_ACQUIRE(&head)) return false;
+	event = events[t & mask];
+	STORE_RELEASE(&tail, t + 1);
+	return true;
+}
+
+size_t OutputEventRing::Size() const {
+	return LOAD_ACQUIRE(&head) - LOAD_ACQUIRE(&tail);
+}
+
+uint64_t OutputEventRing::Dropped() const {
+	return LOAD_RELAXED(&dropped);
+}
+
+void OutputEventRing::Clear() {
+	STORE_RELEASE(&tail, LOAD_ACQUIRE(&head));
+}
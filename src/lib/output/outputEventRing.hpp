@@ -0,0 +1,116 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_OUTPUT_EVENT_RING_H
+#define DP_OUTPUT_EVENT_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define OUTPUT_RING_DEFAULT_SIZE 65536
+
+// Keeps the producer and consumer indices from sharing a cache line
+#define OUTPUT_RING_CACHE_LINE 64
+
+namespace droidpad {
+	/**
+	 * Types of output event. These mirror the evdev types, but are kept
+	 * separate so that recordings are the same on every platform.
+	 */
+	enum {
+		OUTPUT_EVENT_SYNC = 0,	// End of one Send call. value is firstIteration.
+		OUTPUT_EVENT_BUTTON,	// code is the button / key number
+		OUTPUT_EVENT_REL,	// code is one of OUTPUT_REL_*
+		OUTPUT_EVENT_ABS,	// code is the axis number
+		OUTPUT_EVENT_TYPES,
+	};
+
+	enum {
+		OUTPUT_REL_X = 0,
+		OUTPUT_REL_Y,
+		OUTPUT_REL_WHEEL,
+		OUTPUT_REL_WHEEL_HI_RES,	// In 120ths of a notch
+	};
+
+	typedef struct {
+		// monotonicNanos() when the event was recorded
+		uint64_t time;
+		uint16_t type;
+		uint16_t code;
+		int32_t value;
+		// When the phone sent the frame this came from, as in DPJSData
+		uint64_t senderTime;
+	} OutputEvent;
+
+	/**
+	 * A fixed size, lock-free queue of output events, for one producer thread
+	 * and one consumer thread. The producer never blocks; events pushed
+	 * while the ring is full are dropped and counted.
+	 */
+	class OutputEventRing {
+		public:
+			/**
+			 * capacity is rounded up to a power of two.
+			 */
+			OutputEventRing(size_t capacity = OUTPUT_RING_DEFAULT_SIZE);
+			~OutputEventRing();
+
+			/**
+			 * Called by the producer. Returns false if the event was dropped.
+			 */
+			bool Push(const OutputEvent &event);
+			/**
+			 * Called by the consumer. Returns false if the ring is empty.
+			 */
+			bool Pop(OutputEvent &event);
+
+			/**
+			 * Number of events waiting. Only exact when called from either end.
+			 */
+			size_t Size() const;
+			inline size_t Capacity() const { return mask + 1; }
+			/**
+			 * Number of events dropped because the ring was full.
+			 */
+			uint64_t Dropped() const;
+
+			/**
+			 * Discards all waiting events. Called by the consumer.
+			 */
+			void Clear();
+
+		private:
+			OutputEvent *events;
+			size_t mask;
+
+			// Next slot to write; only written by the producer
+			size_t head;
+			char headPad[OUTPUT_RING_CACHE_LINE - sizeof(size_t)];
+			// Next slot to read; only written by the consumer
+			size_t tail;
+			char tailPad[OUTPUT_RING_CACHE_LINE - sizeof(size_t)];
+			uint64_t dropped;
+
+			// Not copyable
+			OutputEventRing(const OutputEventRing &);
+			OutputEventRing &operator=(const OutputEventRing &);
+	};
+}
+
+#endif
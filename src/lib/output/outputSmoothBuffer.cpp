@@ -23,7 +23,14 @@
 #include <iostream>
 
 #include "types.hpp"
+#include "timing.hpp"
+#include "data.hpp"
+#include "realtime.hpp"
+#include "log.hpp"
 #define SLEEP_TIME 15
+// Time without motion after which the thread stops outputting periodically,
+// and waits for the next frame instead
+#define IDLE_DELAY (250 * NANOS_PER_MILLI)
 
 using namespace droidpad;
 using namespace droidpad::decode;
@@ -31,7 +38,16 @@ using namespace std;
 
 OutputSmoothBuffer::OutputSmoothBuffer(IOutputManager *mgr, const int type, const int numAxes, const int numButtons) :
 	IOutputManager(type, numAxes, numButtons),
-	mgr(mgr)
+	mgr(mgr),
+	touchPrevSenderTime(0),
+	mousePrevOutput(monotonicNanos()),
+	scrollPending(0),
+	wake(callMutex),
+	stopping(false),
+	idle(false),
+	lastMotion(monotonicNanos()),
+	stateSince(lastMotion),
+	stateWakeups(0)
 {
 	Create();
 	Run();
@@ -44,49 +60,100 @@ OutputSmoothBuffer::~OutputSmoothBuffer()
 
 void* OutputSmoothBuffer::Entry()
 {
+	if(Data::realtimePriority > 0)
+		realtime::enterLowLatency("Output thread", Data::realtimePriority, Data::realtimeCpu);
+	wxMutexLocker lock(callMutex);
 	while(!TestDestroy()) {
-		wxThread::Sleep(SLEEP_TIME);
-		wxMutexLocker lock(callMutex);
+		// Wait for the next output, or while idle for a frame to arrive.
+		// callMutex is released while waiting. Once stopping, only wait
+		// for Delete, which this mustn't return before, as it deletes
+		// itself on returning.
+		wxCondError waited = idle && !stopping ? wake.Wait() : wake.WaitTimeout(SLEEP_TIME);
+		if(stopping) continue;
+		stateWakeups++;
+		uint64_t now = monotonicNanos();
+		if(idle) {
+			setIdle(false, now);
+			// The frame that woke this has been output already, other
+			// than in absolute mouse mode
+			if(type != MODE_ABSMOUSE) continue;
+		} else if(waited != wxCOND_TIMEOUT && type != MODE_ABSMOUSE) {
+			continue;
+		}
 		switch(type) {
-			case MODE_JS:
-				mgr->SendJSData(jsData, false);
-				break;
 			case MODE_MOUSE:
-				mgr->SendMouseData(mouseData, false);
-				break;
-			case MODE_SLIDE:
-				mgr->SendSlideData(slideData, false);
+				sendMouse(false);
 				break;
 			case MODE_ABSMOUSE:
 				Vec2 newPos = touchCurrentSmoothed2 + touchVelocity * ((float)SLEEP_TIME / 1000);
 				// touchCurrentSmoothed2.x = newPos.x;
 				// touchCurrentSmoothed2.y = newPos.y;
+				touchCurrentSmoothed2.scrollDelta = takeScroll();
 				mgr->SendTouchData(touchCurrentSmoothed2, firstIteration);
 				firstIteration = false;
+				if(scrollPending != 0) lastMotion = now;
 				break;
 		}
+		if(now >= lastMotion + IDLE_DELAY) setIdle(true, now);
 	}
+	return NULL;
+}
+
+void OutputSmoothBuffer::setIdle(bool nowIdle, uint64_t now)
+{
+	double seconds = (double)(now - stateSince) / NANOS_PER_SEC;
+	if(seconds > 0)
+		LOGVwx(wxString::Format(wxT("Output thread %s for %.1fs, %.1f wakeups/s"),
+					idle ? wxT("idle") : wxT("active"), seconds, stateWakeups / seconds));
+	// Forget any fraction of a pixel, so it isn't output on waking
+	if(nowIdle) motion.Reset();
+	idle = nowIdle;
+	stateSince = now;
+	stateWakeups = 0;
 }
 
 void OutputSmoothBuffer::BeginToStop()
 {
+	{
+		wxMutexLocker lock(callMutex);
+		stopping = true;
+		wake.Signal();
+	}
 	Delete();
 }
 
+// Only the mouse modes are smoothed, so joystick and slide data is never sent here
 void OutputSmoothBuffer::SendJSData(const DPJSData& data, bool firstIteration)
 {
-	wxMutexLocker lock(callMutex);
-	jsData = data;
-	mgr->SendJSData(data);
 }
 
 void OutputSmoothBuffer::SendMouseData(const DPMouseData& data, bool firstIteration)
 {
 	wxMutexLocker lock(callMutex);
+	// Nothing was output while idle, so the first step after it mustn't
+	// cover that time
+	if(idle) mousePrevOutput = monotonicNanos();
 	mouseData = data;
-	mouseData.x = mouseData.x * SLEEP_TIME / 60;
-	mouseData.y = mouseData.y * SLEEP_TIME / 60;
-	mgr->SendMouseData(mouseData);
+	motion.SetAcceleration(Data::mouseAcceleration);
+	motion.SetVelocity(data.x, data.y);
+	scrollPending += data.scrollDelta;
+	if(data.x != 0 || data.y != 0 || scrollPending != 0)
+		noteMotion();
+	sendMouse(true);
+}
+
+void OutputSmoothBuffer::sendMouse(bool firstIteration)
+{
+	// Step by the time that really passed, rather than SLEEP_TIME, as neither
+	// the sleep nor the phone's frames are regular.
+	uint64_t now = monotonicNanos();
+	DPMouseData out = mouseData;
+	motion.Step(now - mousePrevOutput, out.x, out.y);
+	mousePrevOutput = now;
+	out.scrollDelta = takeScroll();
+	mgr->SendMouseData(out, firstIteration);
+	if(mouseData.x != 0 || mouseData.y != 0 || scrollPending != 0)
+		lastMotion = now;
 }
 
 void OutputSmoothBuffer::SendTouchData(const decode::DPTouchData& data, bool firstIteration) {
@@ -95,6 +162,7 @@ void OutputSmoothBuffer::SendTouchData(const decode::DPTouchData& data, bool fir
 	// For this method we don't call the actual method directly, so must prompt the thread to do so.
 	this->firstIteration = true;
 
+	scrollPending += data.scrollDelta;
 	touchDataQueue.push_back(data);
 	while(touchDataQueue.size() > TOUCHSCREEN_MOVING_AVG_NUM)
 		touchDataQueue.pop_front();
@@ -102,23 +170,56 @@ void OutputSmoothBuffer::SendTouchData(const decode::DPTouchData& data, bool fir
 	touchCurrentSmoothed = getMovingAverage(touchDataQueue);
 	touchCurrentSmoothed2 = touchCurrentSmoothed;
 
-	// Get velocity
+	// Get velocity. When the phone timestamps frames, use the time between
+	// sending them, which isn't disturbed by network jitter.
 	touchTimer.Pause();
-	if(touchTimer.Time() > 0) {// div0
+	if(data.senderTime != 0 && touchPrevSenderTime != 0 && data.senderTime > touchPrevSenderTime) {
+		touchVelocity = (touchCurrentSmoothed - touchPrevSmoothed) /
+			((float)(data.senderTime - touchPrevSenderTime) / NANOS_PER_SEC);
+	} else if(touchTimer.Time() > 0) {// div0
 		touchVelocity = (touchCurrentSmoothed - touchPrevSmoothed) / ((float)touchTimer.Time() / 1000);
 	} else {
 		touchVelocity = Vec2();
 	}
+	touchPrevSenderTime = data.senderTime;
 	touchTimer.Start();
+
+	if(touchCurrentSmoothed.x != touchPrevSmoothed.x || touchCurrentSmoothed.y != touchPrevSmoothed.y ||
+			touchCurrentSmoothed.bLeft != touchPrevSmoothed.bLeft ||
+			touchCurrentSmoothed.bMiddle != touchPrevSmoothed.bMiddle ||
+			touchCurrentSmoothed.bRight != touchPrevSmoothed.bRight ||
+			data.incrementalScrollDelta != 0 || scrollPending != 0) {
+		noteMotion();
+		// Output it now rather than on the next periodic output
+		wake.Signal();
+	}
 }
 
 void OutputSmoothBuffer::SendSlideData(const DPSlideData& data, bool firstIteration)
+{
+}
+
+// Contacts aren't smoothed, so that gestures are seen at the rate they are sent
+void OutputSmoothBuffer::SendTouchContacts(const vector<TouchContact>& contacts)
 {
 	wxMutexLocker lock(callMutex);
-	slideData = data;
-	mgr->SendSlideData(data);
+	mgr->SendTouchContacts(contacts);
+}
+
+void OutputSmoothBuffer::noteMotion()
+{
+	lastMotion = monotonicNanos();
+	if(idle) wake.Signal();
 }
 
+int OutputSmoothBuffer::takeScroll()
+{
+	int scroll = scrollPending / SCROLL_SMOOTHING;
+	// Send the last few units at once, rather than one at a time
+	if(scroll == 0) scroll = scrollPending;
+	scrollPending -= scroll;
+	return scroll;
+}
 
 template<typename T> T OutputSmoothBuffer::getMovingAverage(deque<T> values) {
 	T ret = values.back();
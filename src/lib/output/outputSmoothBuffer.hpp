@@ -24,16 +24,20 @@
 #include <wx/thread.h>
 #include <wx/stopwatch.h>
 #include "net/connection.hpp"
+#include "relativeMotion.hpp"
 #include <deque>
 
 #define TOUCHSCREEN_MOVING_AVG_NUM 10
+// Scroll not yet output is divided by this on each output, so that each
+// frame's scroll is spread over the outputs until the next one
+#define SCROLL_SMOOTHING 2
 
 namespace droidpad {
 	class OutputSmoothBuffer : public IOutputManager, private wxThread {
 		public:
 			/**
 			  * Constructs a new buffer, which threads the process and outputs data more frequently.
-			  * ownership is taken of mgr.
+			  * ownership is taken of mgr. Only for MODE_MOUSE and MODE_ABSMOUSE.
 			  */
 			OutputSmoothBuffer(IOutputManager* mgr, const int type, const int numAxes, const int numButtons);
 			~OutputSmoothBuffer();
@@ -45,18 +49,58 @@ namespace droidpad {
 			void SendMouseData(const decode::DPMouseData& data, bool firstIteration = true);
 			void SendTouchData(const decode::DPTouchData& data, bool firstIteration = true);
 			void SendSlideData(const decode::DPSlideData& data, bool firstIteration = true);
+			void SendTouchContacts(const std::vector<decode::TouchContact>& contacts);
 		private:
 			IOutputManager* mgr;
 
 			wxMutex callMutex;
-			decode::DPJSData jsData;
 			decode::DPMouseData mouseData;
-			decode::DPSlideData slideData;
 			std::deque<decode::DPTouchData> touchDataQueue;
 			decode::DPTouchData touchCurrentSmoothed, touchCurrentSmoothed2, touchPrevSmoothed;
 			Vec2 touchVelocity;
 			bool firstIteration;
 			wxStopWatch touchTimer;
+			uint64_t touchPrevSenderTime;
+			// Turns mouseData's velocity into pixels for each output
+			RelativeMotion motion;
+			// When the mouse was last output
+			uint64_t mousePrevOutput;
+			// Scroll received but not yet output, in 120ths of a notch
+			int scrollPending;
+
+			// Signalled to wake the thread early, when a frame arrives while
+			// it is idle, an absolute mouse frame moves, or it is stopping
+			wxCondition wake;
+			bool stopping;
+			// While idle, the thread only wakes when signalled, rather than
+			// every SLEEP_TIME
+			bool idle;
+			// When the input or the smoothing last changed the output
+			uint64_t lastMotion;
+			// When the thread last became idle or active, and how many times
+			// it has woken since
+			uint64_t stateSince;
+			uint64_t stateWakeups;
+
+			/**
+			 * Notes that the output is changing, waking the thread if idle.
+			 */
+			void noteMotion();
+			/**
+			 * Moves the thread into or out of idle, logging its wakeups in
+			 * the state it leaves.
+			 */
+			void setIdle(bool nowIdle, uint64_t now);
+
+			/**
+			 * Returns the part of scrollPending to output now.
+			 */
+			int takeScroll();
+
+			/**
+			 * Outputs mouseData, moved on by the time since the last output.
+			 */
+			void sendMouse(bool firstIteration);
 
 			template<typename T> static T getMovingAverage(std::deque<T> values);
 	};
@@ -0,0 +1,176 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "recordingOutputMgr.hpp"
+
+#include "net/dataDecode.hpp"
+#include "timing.hpp"
+#include "log.hpp"
+#include "atomics.hpp"
+
+#include <string.h>
+#include <vector>
+#include <wx/thread.h>
+
+// Buffer dumped events, so that writing them costs little in the output path
+#define DUMP_BUFFER_SIZE 65536
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::decode;
+
+OutputCounters::OutputCounters() :
+	frames(0),
+	dropped(0)
+{
+	memset(events, 0, sizeof(events));
+}
+
+static OutputEventRing *harnessRing = NULL;
+static bool harnessRingUsed = false;
+
+static wxMutex &harnessRingMutex() {
+	static wxMutex mutex;
+	return mutex;
+}
+
+void RecordingOutputManager::SetHarnessRing(OutputEventRing *ring) {
+	wxMutexLocker lock(harnessRingMutex());
+	harnessRing = ring;
+}
+
+RecordingOutputManager::RecordingOutputManager(const int type, const int numAxes, const int numButtons,
+		OutputEventRing *ring, const string &dumpPath) :
+	IOutputManager(type, numAxes, numButtons),
+	ring(ring),
+	usingHarnessRing(false),
+	dump(NULL),
+	frames(0),
+	senderTime(0)
+{
+	memset(events, 0, sizeof(events));
+	if(ring == NULL) {
+		wxMutexLocker lock(harnessRingMutex());
+		if(harnessRing != NULL && !harnessRingUsed) {
+			this->ring = harnessRing;
+			usingHarnessRing = harnessRingUsed = true;
+		} else if(harnessRing != NULL) {
+			LOGW("Output harness ring already in use; only counting events");
+		}
+	}
+	if(!dumpPath.empty()) {
+		dump = fopen(dumpPath.c_str(), "w");
+		if(dump) {
+			setvbuf(dump, NULL, _IOFBF, DUMP_BUFFER_SIZE);
+			// Header, so that traces from different modes can't be confused
+			fprintf(dump, "# droidpad output trace: mode %d axes %d buttons %d\n",
+					type, numAxes, numButtons);
+		} else LOGW("Couldn't open output dump file");
+	}
+}
+
+RecordingOutputManager::~RecordingOutputManager() {
+	if(dump) fclose(dump);
+	if(usingHarnessRing) {
+		wxMutexLocker lock(harnessRingMutex());
+		harnessRingUsed = false;
+	}
+	OutputCounters counters = GetCounters();
+	LOGVwx(wxString::Format(wxT("Recorded %lu frames, %lu events dropped"),
+				(unsigned long)counters.frames, (unsigned long)counters.dropped));
+}
+
+OutputCounters RecordingOutputManager::GetCounters() const {
+	OutputCounters counters;
+	counters.frames = LOAD_RELAXED(&frames);
+	for(int i = 0; i < OUTPUT_EVENT_TYPES; i++)
+		counters.events[i] = LOAD_RELAXED(&events[i]);
+	counters.dropped = ring ? ring->Dropped() : 0;
+	return counters;
+}
+
+void RecordingOutputManager::record(uint64_t time, int type, int code, int32_t value) {
+	OutputEvent event;
+	event.time = time;
+	event.type = type;
+	event.code = code;
+	event.value = value;
+	event.senderTime = senderTime;
+	if(ring) ring->Push(event);
+	ADD_RELAXED(&events[type], 1);
+	// Times are left out, so that traces of the same input are identical.
+	if(dump) fprintf(dump, "%d %d %d\n", type, code, value);
+}
+
+void RecordingOutputManager::endFrame(uint64_t time, bool firstIteration) {
+	record(time, OUTPUT_EVENT_SYNC, 0, firstIteration);
+	ADD_RELAXED(&frames, 1);
+}
+
+void RecordingOutputManager::SendJSData(const DPJSData& data, bool firstIteration) {
+	uint64_t time = monotonicNanos();
+	senderTime = data.senderTime;
+	int i = 0;
+	for(vector<int>::const_iterator it = data.axes.begin(); it != data.axes.end(); it++)
+		record(time, OUTPUT_EVENT_ABS, i++, *it);
+	i = 0;
+	for(vector<bool>::const_iterator it = data.buttons.begin(); it != data.buttons.end(); it++)
+		record(time, OUTPUT_EVENT_BUTTON, i++, *it);
+	endFrame(time, firstIteration);
+}
+
+void RecordingOutputManager::SendMouseData(const DPMouseData& data, bool firstIteration) {
+	uint64_t time = monotonicNanos();
+	senderTime = data.senderTime;
+	record(time, OUTPUT_EVENT_REL, OUTPUT_REL_X, data.x);
+	record(time, OUTPUT_EVENT_REL, OUTPUT_REL_Y, data.y);
+	record(time, OUTPUT_EVENT_REL, OUTPUT_REL_WHEEL, firstIteration ? data.incrementalScrollDelta : 0);
+	record(time, OUTPUT_EVENT_REL, OUTPUT_REL_WHEEL_HI_RES, data.scrollDelta);
+	record(time, OUTPUT_EVENT_BUTTON, 0, data.bLeft);
+	record(time, OUTPUT_EVENT_BUTTON, 1, data.bMiddle);
+	record(time, OUTPUT_EVENT_BUTTON, 2, data.bRight);
+	endFrame(time, firstIteration);
+}
+
+void RecordingOutputManager::SendTouchData(const DPTouchData& data, bool firstIteration) {
+	uint64_t time = monotonicNanos();
+	senderTime = data.senderTime;
+	record(time, OUTPUT_EVENT_ABS, 0, data.x);
+	record(time, OUTPUT_EVENT_ABS, 1, data.y);
+	record(time, OUTPUT_EVENT_REL, OUTPUT_REL_WHEEL, firstIteration ? data.incrementalScrollDelta : 0);
+	record(time, OUTPUT_EVENT_REL, OUTPUT_REL_WHEEL_HI_RES, data.scrollDelta);
+	record(time, OUTPUT_EVENT_BUTTON, 0, data.bLeft);
+	record(time, OUTPUT_EVENT_BUTTON, 1, data.bMiddle);
+	record(time, OUTPUT_EVENT_BUTTON, 2, data.bRight);
+	endFrame(time, firstIteration);
+}
+
+void RecordingOutputManager::SendSlideData(const DPSlideData& data, bool firstIteration) {
+	uint64_t time = monotonicNanos();
+	senderTime = data.senderTime;
+	record(time, OUTPUT_EVENT_BUTTON, 0, data.next);
+	record(time, OUTPUT_EVENT_BUTTON, 1, data.prev);
+	record(time, OUTPUT_EVENT_BUTTON, 2, data.start);
+	record(time, OUTPUT_EVENT_BUTTON, 3, data.finish);
+	record(time, OUTPUT_EVENT_BUTTON, 4, data.white);
+	record(time, OUTPUT_EVENT_BUTTON, 5, data.black);
+	record(time, OUTPUT_EVENT_BUTTON, 6, data.beginning);
+	record(time, OUTPUT_EVENT_BUTTON, 7, data.end);
+	endFrame(time, firstIteration);
+}
@@ -0,0 +1,104 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_RECORDING_OUTPUT_MGR_H
+#define DP_RECORDING_OUTPUT_MGR_H
+
+#include "IOutputMgr.hpp"
+#include "outputEventRing.hpp"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+namespace droidpad {
+	/**
+	 * Totals of what a RecordingOutputManager has been sent.
+	 */
+	class OutputCounters {
+		public:
+			OutputCounters();
+
+			// Number of Send* calls
+			uint64_t frames;
+			// Events of each OUTPUT_EVENT_* type
+			uint64_t events[OUTPUT_EVENT_TYPES];
+			// Events lost because the ring was full
+			uint64_t dropped;
+	};
+
+	/**
+	 * An output manager which doesn't touch the system, for benchmarking and
+	 * testing. Everything sent to it is turned into OutputEvents and counted,
+	 * and pushed to a ring if there is one, which the test harness may read
+	 * from another thread. Optionally the events are also written to a text
+	 * file, which can be compared against a known good trace.
+	 *
+	 * Values are recorded as given to the output manager, before any
+	 * platform specific scaling.
+	 */
+	class RecordingOutputManager : public IOutputManager {
+		public:
+			/**
+			 * ring - Where to push events. If NULL, the harness ring is used if
+			 * one is set and no other manager is using it, otherwise events
+			 * are only counted and dumped.
+			 * dumpPath - If not empty, events are also written to this file.
+			 */
+			RecordingOutputManager(const int type, const int numAxes, const int numButtons,
+					OutputEventRing *ring = NULL, const std::string &dumpPath = "");
+			~RecordingOutputManager();
+
+			void SendJSData(const decode::DPJSData& data, bool firstIteration = true);
+			void SendMouseData(const decode::DPMouseData& data, bool firstIteration = true);
+			void SendTouchData(const decode::DPTouchData& data, bool firstIteration = true);
+			void SendSlideData(const decode::DPSlideData& data, bool firstIteration = true);
+
+			/**
+			 * Safe to call from any thread.
+			 */
+			OutputCounters GetCounters() const;
+
+			/**
+			 * Sets the ring used by recording managers created without one,
+			 * or NULL for none. As MainThread creates its own output
+			 * managers, this is how a harness gets at their events. Only one
+			 * manager at a time pushes to it, as the ring has one producer.
+			 * Must not be changed while a manager is using it.
+			 */
+			static void SetHarnessRing(OutputEventRing *ring);
+
+		private:
+			// NULL if events aren't pushed anywhere
+			OutputEventRing *ring;
+			// Whether ring is the harness ring, to be released when done
+			bool usingHarnessRing;
+			FILE *dump;
+
+			uint64_t frames;
+			uint64_t events[OUTPUT_EVENT_TYPES];
+			// senderTime of the frame being recorded
+			uint64_t senderTime;
+
+			void record(uint64_t time, int type, int code, int32_t value);
+			void endFrame(uint64_t time, bool firstIteration);
+	};
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "relativeMotion.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "timing.hpp"
+
+using namespace std;
+using namespace droidpad;
+
+RelativeMotion::RelativeMotion() :
+	acceleration(-1)
+{
+	SetAcceleration(DEFAULT_MOUSE_ACCELERATION);
+}
+
+void RelativeMotion::SetAcceleration(int percent) {
+	if(percent == acceleration) return;
+	acceleration = percent;
+
+	// The gain follows a smoothstep up to ACCEL_REFERENCE_SPEED, then stays
+	// level, so there is no sudden change in speed anywhere on the curve.
+	gains.resize(ACCEL_TABLE_SIZE);
+	for(int i = 0; i < ACCEL_TABLE_SIZE; i++) {
+		float speed = (float)i * ACCEL_TABLE_MAX_SPEED / (ACCEL_TABLE_SIZE - 1);
+		float t = min(speed / ACCEL_REFERENCE_SPEED, 1.0f);
+		gains[i] = 1 + (float)percent / 100 * t * t * (3 - 2 * t);
+	}
+}
+
+float RelativeMotion::gain(float speed) const {
+	float pos = speed * (ACCEL_TABLE_SIZE - 1) / ACCEL_TABLE_MAX_SPEED;
+	if(pos >= ACCEL_TABLE_SIZE - 1) return gains[ACCEL_TABLE_SIZE - 1];
+	int i = (int)pos;
+	float frac = pos - i;
+	return gains[i] + (gains[i + 1] - gains[i]) * frac;
+}
+
+void RelativeMotion::SetVelocity(int x, int y) {
+	float scale = 1000.0f / MOUSE_VELOCITY_PERIOD_MS / MOUSE_UNITS_PER_PIXEL;
+	velocity = Vec2(x * scale, y * scale);
+	velocity *= gain(sqrt(velocity.x * velocity.x + velocity.y * velocity.y));
+}
+
+void RelativeMotion::Step(uint64_t nanos, int &dx, int &dy) {
+	remainder += velocity * ((float)nanos / NANOS_PER_SEC);
+	// Truncate, so that the remainder keeps the sign of the motion
+	dx = (int)remainder.x;
+	dy = (int)remainder.y;
+	remainder.x -= dx;
+	remainder.y -= dy;
+}
+
+void RelativeMotion::Reset() {
+	velocity = Vec2();
+	remainder = Vec2();
+}
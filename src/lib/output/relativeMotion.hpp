@@ -0,0 +1,90 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_RELATIVE_MOTION_H
+#define DP_RELATIVE_MOTION_H
+
+#include "types.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+// Mouse units, as in DPMouseData, in one pixel of movement
+#define MOUSE_UNITS_PER_PIXEL 400
+// DPMouseData gives the distance to move in this many ms
+#define MOUSE_VELOCITY_PERIOD_MS 60
+
+// Default extra speed given to fast movements, in percent
+#define DEFAULT_MOUSE_ACCELERATION 0
+// Speed, in pixels per second, at which the acceleration is reached
+#define ACCEL_REFERENCE_SPEED 1000
+// Fastest speed in the curve table, in pixels per second; faster movements
+// use the last entry
+#define ACCEL_TABLE_MAX_SPEED 4000
+#define ACCEL_TABLE_SIZE 256
+
+namespace droidpad {
+	/**
+	 * Turns the mouse velocity from the phone into whole pixels of movement,
+	 * at whatever rate the output runs. Movement is scaled by the time that
+	 * really passed, put through an acceleration curve, and the fractions of
+	 * a pixel left over are carried to the next step, so slow movements add
+	 * up rather than being rounded away.
+	 */
+	class RelativeMotion {
+		public:
+			RelativeMotion();
+
+			/**
+			 * Sets the extra speed, in percent, given to movements at
+			 * ACCEL_REFERENCE_SPEED, rising smoothly from none when still.
+			 * 0 is linear. The curve is only rebuilt if this changes.
+			 */
+			void SetAcceleration(int percent);
+
+			/**
+			 * Sets the velocity, in mouse units per MOUSE_VELOCITY_PERIOD_MS.
+			 */
+			void SetVelocity(int x, int y);
+
+			/**
+			 * Moves on by nanos, giving the whole pixels to move.
+			 */
+			void Step(uint64_t nanos, int &dx, int &dy);
+
+			/**
+			 * Stops, and forgets any fraction of a pixel.
+			 */
+			void Reset();
+
+		private:
+			int acceleration;
+			// Gain at each speed, ACCEL_TABLE_MAX_SPEED / (ACCEL_TABLE_SIZE - 1) apart
+			std::vector<float> gains;
+
+			// In pixels per second, after the curve
+			Vec2 velocity;
+			// Fractions of a pixel not yet moved
+			Vec2 remainder;
+
+			float gain(float speed) const;
+	};
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "shmOutputMgr.hpp"
+
+#include "net/dataDecode.hpp"
+#include "timing.hpp"
+#include "atomics.hpp"
+#include "log.hpp"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::decode;
+
+SharedMemoryOutputManager::SharedMemoryOutputManager(const int type, const int numAxes, const int numButtons,
+		const string &session, IOutputManager *next) :
+	IOutputManager(type, numAxes, numButtons),
+	next(next),
+	name(DPSHM_PREFIX + session),
+	segment(NULL)
+{
+	// Start afresh, so readers of a stale segment don't see this one's frames
+	// as continuing it.
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(fd < 0) {
+		LOGWwx(wxT("Couldn't create shared memory output: ") + wxString::FromAscii(strerror(errno)));
+		return;
+	}
+	void *map = MAP_FAILED;
+	if(ftruncate(fd, sizeof(dpshm_segment)) == 0)
+		map = mmap(NULL, sizeof(dpshm_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		LOGWwx(wxT("Couldn't map shared memory output: ") + wxString::FromAscii(strerror(errno)));
+		shm_unlink(name.c_str());
+		return;
+	}
+
+	segment = (dpshm_segment *)map;
+	segment->version = DPSHM_VERSION;
+	segment->size = sizeof(dpshm_segment);
+	segment->pid = getpid();
+	segment->state.mode = type;
+	segment->state.numAxes = min(numAxes, DPSHM_MAX_AXES);
+	segment->state.numButtons = min(numButtons, DPSHM_MAX_BUTTONS);
+	// Readers check the magic, so it goes last
+	STORE_RELEASE(&segment->magic, (uint32_t)DPSHM_MAGIC);
+}
+
+SharedMemoryOutputManager::~SharedMemoryOutputManager()
+{
+	if(segment != NULL) {
+		beginWrite();
+		segment->state.flags |= DPSHM_FLAG_CLOSED;
+		STORE_RELEASE(&segment->sequence, segment->sequence + 1);
+		munmap(segment, sizeof(dpshm_segment));
+		shm_unlink(name.c_str());
+	}
+	delete next;
+}
+
+void SharedMemoryOutputManager::BeginToStop()
+{
+	if(next != NULL) next->BeginToStop();
+}
+
+void SharedMemoryOutputManager::beginWrite()
+{
+	// Only this thread writes, so the count needn't be read atomically
+	STORE_RELAXED(&segment->sequence, segment->sequence + 1);
+	// Keeps the state's stores after the count's
+	FENCE_RELEASE();
+}
+
+void SharedMemoryOutputManager::endWrite(uint64_t senderTime)
+{
+	dpshm_state &state = segment->state;
+	state.frame++;
+	state.time = monotonicNanos();
+	state.senderTime = senderTime;
+	STORE_RELEASE(&segment->sequence, segment->sequence + 1);
+}
+
+void SharedMemoryOutputManager::setButton(int button, bool down)
+{
+	uint32_t bit = 1u << (button % 32);
+	if(down) segment->state.buttons[button / 32] |= bit;
+	else segment->state.buttons[button / 32] &= ~bit;
+}
+
+void SharedMemoryOutputManager::SendJSData(const DPJSData& data, bool firstIteration)
+{
+	if(segment != NULL) {
+		beginWrite();
+		dpshm_state &state = segment->state;
+		state.numAxes = min((int)data.axes.size(), DPSHM_MAX_AXES);
+		for(int i = 0; i < state.numAxes; i++)
+			state.axes[i] = data.axes[i];
+		state.numButtons = min((int)data.buttons.size(), DPSHM_MAX_BUTTONS);
+		for(int i = 0; i < state.numButtons; i++)
+			setButton(i, data.buttons[i]);
+		endWrite(data.senderTime);
+	}
+	if(next != NULL) next->SendJSData(data, firstIteration);
+}
+
+void SharedMemoryOutputManager::SendMouseData(const DPMouseData& data, bool firstIteration)
+{
+	if(segment != NULL) {
+		beginWrite();
+		dpshm_state &state = segment->state;
+		state.mouseX += data.x;
+		state.mouseY += data.y;
+		state.scroll += data.scrollDelta;
+		setButton(0, data.bLeft);
+		setButton(1, data.bMiddle);
+		setButton(2, data.bRight);
+		endWrite(0);
+	}
+	if(next != NULL) next->SendMouseData(data, firstIteration);
+}
+
+void SharedMemoryOutputManager::SendTouchData(const DPTouchData& data, bool firstIteration)
+{
+	if(segment != NULL) {
+		beginWrite();
+		dpshm_state &state = segment->state;
+		state.numAxes = 2;
+		state.axes[0] = data.x;
+		state.axes[1] = data.y;
+		state.scroll += data.scrollDelta;
+		setButton(0, data.bLeft);
+		setButton(1, data.bMiddle);
+		setButton(2, data.bRight);
+		endWrite(data.senderTime);
+	}
+	if(next != NULL) next->SendTouchData(data, firstIteration);
+}
+
+void SharedMemoryOutputManager::SendSlideData(const DPSlideData& data, bool firstIteration)
+{
+	if(segment != NULL) {
+		beginWrite();
+		setButton(0, data.next);
+		setButton(1, data.prev);
+		setButton(2, data.start);
+		setButton(3, data.finish);
+		setButton(4, data.white);
+		setButton(5, data.black);
+		setButton(6, data.beginning);
+		setButton(7, data.end);
+		endWrite(0);
+	}
+	if(next != NULL) next->SendSlideData(data, firstIteration);
+}
+
+// Contacts aren't published
+void SharedMemoryOutputManager::SendTouchContacts(const vector<TouchContact>& contacts)
+{
+	if(next != NULL) next->SendTouchContacts(contacts);
+}
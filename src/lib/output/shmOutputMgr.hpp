@@ -0,0 +1,79 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_SHM_OUTPUT_MGR_H
+#define DP_SHM_OUTPUT_MGR_H
+
+#include "IOutputMgr.hpp"
+#include "shm/dpshm.h"
+
+#include <string>
+#include <stdint.h>
+
+namespace droidpad {
+	/**
+	 * Publishes each frame to a shared memory segment, as laid out in
+	 * shm/dpshm.h, then passes it on to another output manager. Local
+	 * programs can read the segment with libdpshm without any system calls.
+	 */
+	class SharedMemoryOutputManager : public IOutputManager {
+		public:
+			/**
+			 * session - Name of the segment, after DPSHM_PREFIX. A segment
+			 * left by an earlier run is replaced.
+			 * next - Where frames go after publishing; owned by this. May be
+			 * NULL to only publish.
+			 * If the segment can't be made, frames only go to next.
+			 */
+			SharedMemoryOutputManager(const int type, const int numAxes, const int numButtons,
+					const std::string &session, IOutputManager *next);
+			/**
+			 * Marks the segment closed and removes it. Readers which have it
+			 * open can still read the last state.
+			 */
+			~SharedMemoryOutputManager();
+
+			void BeginToStop();
+
+			void SendJSData(const decode::DPJSData& data, bool firstIteration = true);
+			void SendMouseData(const decode::DPMouseData& data, bool firstIteration = true);
+			void SendTouchData(const decode::DPTouchData& data, bool firstIteration = true);
+			void SendSlideData(const decode::DPSlideData& data, bool firstIteration = true);
+			void SendTouchContacts(const std::vector<decode::TouchContact>& contacts);
+
+			inline bool IsPublishing() const { return segment != NULL; }
+
+		private:
+			IOutputManager *next;
+			std::string name;
+			dpshm_segment *segment;
+
+			/**
+			 * Makes the sequence odd, before the state is changed.
+			 */
+			void beginWrite();
+			/**
+			 * Stamps the frame and makes the sequence even again.
+			 */
+			void endWrite(uint64_t senderTime);
+			void setButton(int button, bool down);
+	};
+}
+
+#endif
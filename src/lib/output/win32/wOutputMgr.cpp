@@ -35,7 +35,7 @@ using namespace droidpad;
 using namespace droidpad::decode;
 using namespace droidpad::win32;
 
-OutputManager::OutputManager(const int type, const int numAxes, const int numButtons) :
+OutputManager::OutputManager(const int type, const int numAxes, const int numButtons, const uint32_t accelAxes, const uint32_t gyroAxes) :
 	IOutputManager(type, numAxes, numButtons)
 {
 	switch(type) {
@@ -87,7 +87,7 @@ void OutputManager::SendJSData(const DPJSData& data, bool firstIteration) {
 
 void OutputManager::SendMouseData(const DPMouseData& data, bool firstIteration)
 {
-	if(!WinOutputs::SendMouseEvent(data.x / 400, -data.y / 400, data.bLeft, data.bMiddle, data.bRight, firstIteration ? data.incrementalScrollDelta : 0)) // TODO: Customise scale factors?
+	if(!WinOutputs::SendMouseEvent(data.x, -data.y, data.bLeft, data.bMiddle, data.bRight, firstIteration ? data.incrementalScrollDelta : 0))
 	{
 		LOGWwx(wxT("SendInput failed") + GetLastError());
 	}
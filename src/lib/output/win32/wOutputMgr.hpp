@@ -21,6 +21,7 @@
 #define DP_WIN_OUTPUT_MGR_H
 
 #include <stdexcept>
+#include <stdint.h>
 #include "wPlatformSettings.hpp"
 #include "output/IOutputMgr.hpp"
 
@@ -29,7 +30,8 @@
 namespace droidpad {
 	class OutputManager : public IOutputManager {
 		public:
-			OutputManager(const int type, const int numAxes, const int numButtons);
+			// accelAxes and gyroAxes are only used to describe axes on Linux.
+			OutputManager(const int type, const int numAxes, const int numButtons, const uint32_t accelAxes = 0, const uint32_t gyroAxes = 0);
 			~OutputManager();
 
 			void SendJSData(const decode::DPJSData& data, bool firstIteration = true);
@@ -0,0 +1,118 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "realtime.hpp"
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef OS_WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <wx/string.h>
+#include <wx/thread.h>
+
+#include "log.hpp"
+
+using namespace droidpad;
+
+bool realtime::setPriority(int priority) {
+#ifdef OS_WIN32
+	return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+	int min = sched_get_priority_min(SCHED_FIFO), max = sched_get_priority_max(SCHED_FIFO);
+	if(param.sched_priority < min) param.sched_priority = min;
+	if(param.sched_priority > max) param.sched_priority = max;
+	return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+}
+
+bool realtime::setAffinity(int cpu) {
+	if(cpu < 0) return false;
+#ifdef OS_WIN32
+	if(cpu >= (int)sizeof(DWORD_PTR) * 8) return false;
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(OS_LINUX)
+	if(cpu >= CPU_SETSIZE) return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	// On Linux, pid 0 is the calling thread rather than the whole process
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+// Touches the stack below the caller, so that it is mapped before it's needed
+static void prefaultStack() {
+	volatile char stack[REALTIME_STACK_RESERVE];
+	memset((char *)stack, 0, sizeof(stack));
+}
+
+static wxMutex lockMutex;
+static bool memoryLocked = false;
+
+bool realtime::lockMemory() {
+	wxMutexLocker lock(lockMutex);
+	if(memoryLocked) return true;
+#ifdef OS_WIN32
+	return false;
+#else
+#ifdef __GLIBC__
+	// Keep freed memory, and serve large blocks from the heap rather than
+	// new mappings, so the locked reserve is what gets reused
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+#endif
+	if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0) return false;
+	memoryLocked = true;
+
+	char *reserve = (char *)malloc(REALTIME_HEAP_RESERVE);
+	if(reserve != NULL) {
+		memset(reserve, 0, REALTIME_HEAP_RESERVE);
+		free(reserve);
+	}
+	return true;
+#endif
+}
+
+void realtime::enterLowLatency(const char *thread, int priority, int cpu) {
+	wxString name = wxString::FromAscii(thread);
+	if(!lockMemory())
+		LOGWwx(name + wxT(": couldn't lock memory, page faults may delay input"));
+	if(!setPriority(priority))
+		LOGWwx(name + wxT(": couldn't get real-time priority, running at normal priority"));
+	if(cpu >= 0 && !setAffinity(cpu))
+		LOGWwx(name + wxString::Format(wxT(": couldn't pin to CPU %d"), cpu));
+	prefaultStack();
+	LOGVwx(name + wxT(": low latency mode set up"));
+}
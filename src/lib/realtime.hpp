@@ -0,0 +1,62 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_REALTIME_H
+#define DP_REALTIME_H
+
+// Heap kept allocated and locked once memory is locked, so that the input
+// threads' allocations don't need new pages
+#define REALTIME_HEAP_RESERVE (4 * 1024 * 1024)
+// Stack touched by each low latency thread, so it is already mapped
+#define REALTIME_STACK_RESERVE (64 * 1024)
+
+namespace droidpad {
+	/**
+	 * Helpers for running the input threads with low latency. Each one
+	 * returns false if it couldn't be done, usually for lack of
+	 * permission, in which case nothing is changed.
+	 */
+	namespace realtime {
+		/**
+		 * Runs the current thread under SCHED_FIFO at priority, from 1 to
+		 * 99. On Windows, priority only chooses time critical.
+		 */
+		bool setPriority(int priority);
+
+		/**
+		 * Pins the current thread to one CPU.
+		 */
+		bool setAffinity(int cpu);
+
+		/**
+		 * Locks the process's memory, now and in future, into RAM, and
+		 * keeps REALTIME_HEAP_RESERVE of heap around so that later
+		 * allocations don't fault. Only has an effect the first time.
+		 */
+		bool lockMemory();
+
+		/**
+		 * Everything above for the current thread, as far as permissions
+		 * allow, logging what couldn't be done. cpu may be -1 to not pin.
+		 */
+		void enterLowLatency(const char *thread, int priority, int cpu);
+	};
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "dpshm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int dpshm_open(dpshm_reader *reader, const char *session)
+{
+	char name[256];
+	int fd;
+	struct stat st;
+	void *map;
+	const dpshm_segment *segment;
+
+	reader->segment = NULL;
+	if(snprintf(name, sizeof(name), "%s%s", DPSHM_PREFIX, session) >= (int)sizeof(name)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd < 0) return -1;
+	if(fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+	if(st.st_size < (off_t)sizeof(dpshm_segment)) {
+		close(fd);
+		errno = EPROTO;
+		return -1;
+	}
+	map = mmap(NULL, sizeof(dpshm_segment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) return -1;
+
+	segment = (const dpshm_segment *)map;
+	if(segment->magic != DPSHM_MAGIC || segment->version != DPSHM_VERSION ||
+			segment->size != sizeof(dpshm_segment)) {
+		munmap(map, sizeof(dpshm_segment));
+		errno = EPROTO;
+		return -1;
+	}
+	reader->segment = segment;
+	return 0;
+}
+
+int dpshm_read(const dpshm_reader *reader, dpshm_state *state)
+{
+	const dpshm_segment *segment = reader->segment;
+	uint32_t before, after;
+	int tries;
+
+	for(tries = 0; tries < DPSHM_READ_TRIES; tries++) {
+		before = __atomic_load_n(&segment->sequence, __ATOMIC_ACQUIRE);
+		if(before & 1) continue; /* Being written */
+		memcpy(state, (const void *)&segment->state, sizeof(dpshm_state));
+		/* Keeps the copy from being moved after the second load */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&segment->sequence, __ATOMIC_RELAXED);
+		if(before == after) return 0;
+	}
+	errno = EAGAIN;
+	return -1;
+}
+
+void dpshm_close(dpshm_reader *reader)
+{
+	if(reader->segment != NULL) munmap((void *)reader->segment, sizeof(dpshm_segment));
+	reader->segment = NULL;
+}
@@ -0,0 +1,140 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef DP_SHM_H
+#define DP_SHM_H
+
+#include <stdint.h>
+
+/*
+ * Layout of the shared memory segment droidpad publishes its output to when
+ * run with --shm-output=NAME, as /dev/shm/droidpad-NAME. Each frame sent to
+ * the system is also written here, so that local programs can read the
+ * latest state without going through the kernel's input devices.
+ *
+ * The state is guarded by a sequence count, which the writer makes odd while
+ * it changes the state and even again once done. Readers copy the state and
+ * try again if the count was odd or changed meanwhile. dpshm_read does this.
+ *
+ * The layout only changes along with DPSHM_VERSION.
+ */
+
+#define DPSHM_MAGIC 0x4d535044 /* "DPSM" */
+#define DPSHM_VERSION 1
+
+/* Segment name is this followed by the session name */
+#define DPSHM_PREFIX "/droidpad-"
+
+#define DPSHM_MAX_AXES 32
+#define DPSHM_MAX_BUTTONS 128
+
+/* Reads which keep seeing a write in progress give up after this many tries */
+#define DPSHM_READ_TRIES 100000
+
+/* Values of dpshm_state.mode, as in types.hpp */
+enum {
+	DPSHM_MODE_JS = 1,
+	DPSHM_MODE_ABSMOUSE,
+	DPSHM_MODE_MOUSE,
+	DPSHM_MODE_SLIDE,
+};
+
+/* Bits of dpshm_state.flags */
+enum {
+	/* The session has ended, and the state won't change again */
+	DPSHM_FLAG_CLOSED = 1,
+};
+
+typedef struct dpshm_state
+{
+	/* Frames published so far; a reader has seen every change if this
+	 * went up by one since its last read. 0 until the first frame. */
+	uint64_t frame;
+	/* When the frame was published, on CLOCK_MONOTONIC, in ns */
+	uint64_t time;
+	/* When the phone sent it, on the same clock, or 0 if not known */
+	uint64_t senderTime;
+
+	int32_t mode;
+	int32_t flags;
+	int32_t numAxes;
+	int32_t numButtons;
+
+	/* As sent to the output device, before any platform scaling. In
+	 * absolute mouse mode, the first two are the pointer position. */
+	int32_t axes[DPSHM_MAX_AXES];
+	/* Button n is bit n % 32 of buttons[n / 32]. In mouse modes these are
+	 * left, middle and right; in slide mode next, prev, start, finish,
+	 * white, black, beginning and end. */
+	uint32_t buttons[DPSHM_MAX_BUTTONS / 32];
+
+	/* Relative mouse movement in pixels and scrolling in 120ths of a
+	 * notch (down positive), totalled since the segment was made. Readers
+	 * take the difference from their last read, so nothing is lost between
+	 * polls. */
+	int64_t mouseX;
+	int64_t mouseY;
+	int64_t scroll;
+} dpshm_state;
+
+typedef struct dpshm_segment
+{
+	uint32_t magic;
+	uint32_t version;
+	/* sizeof(dpshm_segment) */
+	uint32_t size;
+	/* Process id of the writer */
+	int32_t pid;
+	/* Odd while the writer is changing state */
+	uint32_t sequence;
+	uint32_t reserved;
+	dpshm_state state;
+} dpshm_segment;
+
+/*
+ * Reader library, in libdpshm.
+ */
+typedef struct dpshm_reader
+{
+	const dpshm_segment *segment;
+} dpshm_reader;
+
+/*
+ * Maps the named session's segment. Returns 0 on success, or -1 with errno
+ * set: ENOENT if droidpad isn't publishing that session, EPROTO if the
+ * segment is from an incompatible version.
+ */
+int dpshm_open(dpshm_reader *reader, const char *session);
+/*
+ * Copies the latest state, making no system calls. Returns 0 on success, or
+ * -1 with errno set to EAGAIN if a write never finished, as when droidpad
+ * died while writing.
+ */
+int dpshm_read(const dpshm_reader *reader, dpshm_state *state);
+void dpshm_close(dpshm_reader *reader);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,37 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_TIMING_H
+#define DP_TIMING_H
+
+#include <stdint.h>
+
+#define NANOS_PER_MICRO ((uint64_t)1000)
+#define NANOS_PER_MILLI ((uint64_t)1000000)
+#define NANOS_PER_SEC ((uint64_t)1000000000)
+
+namespace droidpad {
+	/**
+	 * Returns a monotonic timestamp in nanoseconds. Only differences between
+	 * two values are meaningful; the epoch is unspecified.
+	 */
+	uint64_t monotonicNanos();
+};
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// dpsim - simulates one or more phones running DroidPad, for testing the
+// computer side without a device.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <vector>
+#include <string>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include "b64/base64.hpp"
+
+#include "types.hpp"
+#include "timing.hpp"
+#include "simPhone.hpp"
+#include "simAdvertiser.hpp"
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::sim;
+
+static volatile bool quit = false;
+
+static void onSignal(int sig) {
+	quit = true;
+}
+
+static void usage(const char *name) {
+	printf("Usage: %s [options]\n"
+			"Simulates phones running DroidPad.\n"
+			"\n"
+			"  -n, --instances=N      number of phones to simulate (default 1)\n"
+			"  -p, --port=PORT        port of the first phone; each further phone uses\n"
+			"                         the next port but one (default 3141)\n"
+			"  -r, --rate=HZ          frames sent per second (default 60)\n"
+			"  -m, --mode=MODE        js, mouse, absmouse or slide (default js)\n"
+			"  -a, --axes=N           on-screen axes in js mode (default 2)\n"
+			"  -b, --buttons=N        buttons in js mode (default 4)\n"
+			"      --contacts=N       multi-touch trackpads in the mouse modes\n"
+			"      --no-accel         don't send accelerometer data\n"
+			"      --gyro             send gyroscope data (absmouse only)\n"
+			"  -s, --shape=SHAPE      sine, square, ramp, random or static (default sine)\n"
+			"  -f, --frequency=HZ     cycles per second of the shape (default 0.5)\n"
+			"  -t, --text-only        ignore requests to use the binary protocol\n"
+			"      --delta            offer delta frames, and send them if asked\n"
+			"      --timestamps       timestamp binary frames and answer pings\n"
+			"      --clock-offset=MS  offset of the phone's clock from the computer's\n"
+			"  -d, --drop-after=N     drop each connection after N frames\n"
+			"      --stall-after=N    stop sending on each connection after N frames\n"
+			"  -S, --secure           also listen for secure connections\n"
+			"      --device-id=UUID   device id for secure connections\n"
+			"      --psk=BASE64       pre-shared key for secure connections\n"
+			"      --legacy-tls       only use TLS 1.0, as older versions of the app do\n"
+			"      --name=NAME        name shown on the computer (default \"Simulated phone\")\n"
+			"      --ip=ADDRESS       address to advertise over mDNS\n"
+			"      --no-mdns          don't advertise over mDNS\n"
+			"      --duration=SECS    exit after this long (default: run until interrupted)\n"
+			"      --stats=SECS       interval between statistics lines (default 1)\n"
+			"  -h, --help             show this help\n", name);
+}
+
+enum {
+	OPT_NO_ACCEL = 256,
+	OPT_GYRO,
+	OPT_CONTACTS,
+	OPT_DELTA,
+	OPT_STALL_AFTER,
+	OPT_TIMESTAMPS,
+	OPT_CLOCK_OFFSET,
+	OPT_DEVICE_ID,
+	OPT_PSK,
+	OPT_LEGACY_TLS,
+	OPT_NAME,
+	OPT_IP,
+	OPT_NO_MDNS,
+	OPT_DURATION,
+	OPT_STATS,
+};
+
+int main(int argc, char **argv) {
+	SimSettings settings;
+	int instances = 1;
+	string name = "Simulated phone", ip;
+	bool mdns = true;
+	double duration = 0, statsInterval = 1;
+
+	static struct option longOptions[] = {
+		{ "instances",	required_argument,	NULL, 'n' },
+		{ "port",	required_argument,	NULL, 'p' },
+		{ "rate",	required_argument,	NULL, 'r' },
+		{ "mode",	required_argument,	NULL, 'm' },
+		{ "axes",	required_argument,	NULL, 'a' },
+		{ "buttons",	required_argument,	NULL, 'b' },
+		{ "no-accel",	no_argument,		NULL, OPT_NO_ACCEL },
+		{ "gyro",	no_argument,		NULL, OPT_GYRO },
+		{ "contacts",	required_argument,	NULL, OPT_CONTACTS },
+		{ "shape",	required_argument,	NULL, 's' },
+		{ "frequency",	required_argument,	NULL, 'f' },
+		{ "text-only",	no_argument,		NULL, 't' },
+		{ "delta",	no_argument,		NULL, OPT_DELTA },
+		{ "timestamps",	no_argument,		NULL, OPT_TIMESTAMPS },
+		{ "clock-offset", required_argument,	NULL, OPT_CLOCK_OFFSET },
+		{ "drop-after",	required_argument,	NULL, 'd' },
+		{ "stall-after", required_argument,	NULL, OPT_STALL_AFTER },
+		{ "secure",	no_argument,		NULL, 'S' },
+		{ "device-id",	required_argument,	NULL, OPT_DEVICE_ID },
+		{ "psk",	required_argument,	NULL, OPT_PSK },
+		{ "legacy-tls",	no_argument,		NULL, OPT_LEGACY_TLS },
+		{ "name",	required_argument,	NULL, OPT_NAME },
+		{ "ip",		required_argument,	NULL, OPT_IP },
+		{ "no-mdns",	no_argument,		NULL, OPT_NO_MDNS },
+		{ "duration",	required_argument,	NULL, OPT_DURATION },
+		{ "stats",	required_argument,	NULL, OPT_STATS },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int opt;
+	while((opt = getopt_long(argc, argv, "n:p:r:m:a:b:s:f:td:Sh", longOptions, NULL)) != -1) {
+		switch(opt) {
+			case 'n': instances = atoi(optarg); break;
+			case 'p': settings.basePort = atoi(optarg); break;
+			case 'r': settings.rate = atof(optarg); break;
+			case 'm':
+				if(!settings.layout.SetMode(optarg)) {
+					fprintf(stderr, "Unknown mode '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'a': settings.layout.axes = atoi(optarg); break;
+			case 'b': settings.layout.buttons = atoi(optarg); break;
+			case OPT_NO_ACCEL: settings.layout.accel = false; break;
+			case OPT_GYRO: settings.layout.gyro = true; break;
+			case OPT_CONTACTS: settings.layout.contacts = atoi(optarg); break;
+			case 's':
+				if(!settings.layout.SetShape(optarg)) {
+					fprintf(stderr, "Unknown shape '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'f': settings.layout.frequency = atof(optarg); break;
+			case 't': settings.textOnly = true; break;
+			case OPT_DELTA: settings.delta = true; break;
+			case OPT_TIMESTAMPS: settings.timestamps = true; break;
+			case OPT_CLOCK_OFFSET: settings.clockOffset = (int64_t)(atof(optarg) * 1000); break;
+			case 'd': settings.dropAfter = atoi(optarg); break;
+			case OPT_STALL_AFTER: settings.stallAfter = atoi(optarg); break;
+			case 'S': settings.secure = true; break;
+			case OPT_DEVICE_ID: settings.deviceId = optarg; break;
+			case OPT_PSK: settings.psk = base64_decode(optarg); break;
+			case OPT_LEGACY_TLS: settings.legacyTls = true; break;
+			case OPT_NAME: name = optarg; break;
+			case OPT_IP: ip = optarg; break;
+			case OPT_NO_MDNS: mdns = false; break;
+			case OPT_DURATION: duration = atof(optarg); break;
+			case OPT_STATS: statsInterval = atof(optarg); break;
+			case 'h':
+				usage(argv[0]);
+				return 0;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if(instances < 1 || settings.rate <= 0 || statsInterval <= 0) {
+		fprintf(stderr, "Instances, rate and stats interval must be positive\n");
+		return 1;
+	}
+	if(settings.secure && (settings.deviceId.empty() || settings.psk.empty())) {
+		fprintf(stderr, "Secure connections need --device-id and --psk\n");
+		return 1;
+	}
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	signal(SIGPIPE, SIG_IGN);
+
+	SSL_CTX *tlsContext = NULL;
+	if(settings.secure) {
+		SSL_library_init();
+		SSL_load_error_strings();
+		if(!(tlsContext = SimPhone::CreateTlsContext(&settings))) {
+			ERR_print_errors_fp(stderr);
+			return 1;
+		}
+	}
+
+	SimAdvertiser advertiser(ip);
+	vector<SimPhone *> phones;
+	for(int i = 0; i < instances; i++) {
+		SimPhone *phone = new SimPhone(settings, i, tlsContext);
+		phones.push_back(phone);
+		if(!phone->Start()) {
+			quit = true;
+			break;
+		}
+		char host[32];
+		snprintf(host, sizeof(host), "dpsim-%d", i + 1);
+		string description = instances > 1 ? name + " " + (host + 6) : name;
+		advertiser.Add(host, description, settings.secure, phone->Port());
+		printf("Phone %d listening on port %d%s\n", i + 1, phone->Port(),
+				settings.secure ? " (and next port for secure connections)" : "");
+	}
+	if(!quit && mdns && !advertiser.Start()) quit = true;
+
+	// Print statistics until told to stop
+	const uint64_t start = monotonicNanos();
+	uint64_t lastStats = start;
+	while(!quit) {
+		usleep(50 * 1000);
+		uint64_t now = monotonicNanos();
+		if(duration > 0 && now - start >= duration * NANOS_PER_SEC) break;
+		if(now - lastStats < statsInterval * NANOS_PER_SEC) continue;
+
+		SimStats total;
+		for(vector<SimPhone *>::iterator it = phones.begin(); it != phones.end(); it++)
+			total += (*it)->GetStats(true);
+		double elapsed = (double)(now - lastStats) / NANOS_PER_SEC;
+		lastStats = now;
+		printf("%7.1fs connections=%llu drops=%llu stalls=%llu fps=%.1f kB/s=%.1f late=%llu skipped=%llu"
+				" avgLate=%.1fus maxLate=%.1fus\n",
+				(double)(now - start) / NANOS_PER_SEC,
+				(unsigned long long)total.connections,
+				(unsigned long long)total.drops,
+				(unsigned long long)total.stalls,
+				total.frames / elapsed,
+				total.bytes / elapsed / 1024,
+				(unsigned long long)total.lateFrames,
+				(unsigned long long)total.skippedFrames,
+				total.frames ? (double)total.totalLateness / total.frames / NANOS_PER_MICRO : 0,
+				(double)total.maxLateness / NANOS_PER_MICRO);
+		fflush(stdout);
+	}
+
+	advertiser.Stop();
+	for(vector<SimPhone *>::iterator it = phones.begin(); it != phones.end(); it++)
+		delete *it;
+	if(tlsContext) SSL_CTX_free(tlsContext);
+	return 0;
+}
@@ -0,0 +1,316 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frameGenerator.hpp"
+
+#include "types.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <arpa/inet.h>
+
+#define GRAVITY 9.81f
+// Largest tilt generated, each way
+#define MAX_TILT (M_PI / 4)
+// Trackpad movement per second at full deflection
+#define TRACKPAD_SPEED 2000
+// Sliders are sent in the range [-SLIDER_RANGE,SLIDER_RANGE]
+#define SLIDER_RANGE 16384
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::sim;
+using namespace droidpad::decode;
+
+SimLayout::SimLayout() :
+	mode(MODE_JS),
+	accel(true),
+	gyro(false),
+	axes(2),
+	buttons(4),
+	contacts(0),
+	shape(SHAPE_SINE),
+	frequency(0.5)
+{ }
+
+bool SimLayout::SetMode(const string &name) {
+	if(name == "js") mode = MODE_JS;
+	else if(name == "mouse") mode = MODE_MOUSE;
+	else if(name == "absmouse") mode = MODE_ABSMOUSE;
+	else if(name == "slide") mode = MODE_SLIDE;
+	else return false;
+	return true;
+}
+
+bool SimLayout::SetShape(const string &name) {
+	if(name == "sine") shape = SHAPE_SINE;
+	else if(name == "square") shape = SHAPE_SQUARE;
+	else if(name == "ramp") shape = SHAPE_RAMP;
+	else if(name == "random") shape = SHAPE_RANDOM;
+	else if(name == "static") shape = SHAPE_STATIC;
+	else return false;
+	return true;
+}
+
+static RawBinaryElement makeElement(int32_t flags) {
+	RawBinaryElement elem;
+	memset(&elem, 0, sizeof(RawBinaryElement));
+	elem.flags = flags;
+	return elem;
+}
+
+FrameGenerator::FrameGenerator(const SimLayout &layout, unsigned int seed) :
+	layout(layout),
+	seed(seed),
+	ax(0), ay(0), az(GRAVITY), gx(0), gy(0), gz(0),
+	lastT(0),
+	timestamped(false),
+	sequence(0),
+	senderMicros(0)
+{
+	switch(layout.mode) {
+		case MODE_JS:
+			for(int i = 0; i < layout.axes; i += 2)
+				elements.push_back(makeElement(ITEM_FLAG_SLIDER | ITEM_FLAG_HAS_X_AXIS |
+							(i + 1 < layout.axes ? ITEM_FLAG_HAS_Y_AXIS : 0)));
+			for(int i = 0; i < layout.buttons; i++)
+				elements.push_back(makeElement(ITEM_FLAG_BUTTON));
+			break;
+		case MODE_MOUSE:
+			elements.push_back(makeElement(ITEM_FLAG_TRACKPAD | ITEM_FLAG_HAS_X_AXIS | ITEM_FLAG_HAS_Y_AXIS));
+			// Scroll wheel
+			elements.push_back(makeElement(ITEM_FLAG_TRACKPAD | ITEM_FLAG_HAS_Y_AXIS));
+			for(int i = 0; i < 3; i++)
+				elements.push_back(makeElement(ITEM_FLAG_BUTTON));
+			break;
+		case MODE_ABSMOUSE:
+			this->layout.accel = true;
+			elements.push_back(makeElement(ITEM_FLAG_TRACKPAD | ITEM_FLAG_HAS_Y_AXIS));
+			for(int i = 0; i < 3; i++)
+				elements.push_back(makeElement(ITEM_FLAG_BUTTON));
+			elements.push_back(makeElement(ITEM_FLAG_BUTTON | ITEM_FLAG_IS_RESET));
+			break;
+		case MODE_SLIDE:
+			for(int i = 0; i < 8; i++)
+				elements.push_back(makeElement(
+							(i == 4 || i == 5) ? ITEM_FLAG_TOGGLE_BUTTON : ITEM_FLAG_BUTTON));
+			break;
+	}
+	if(layout.mode == MODE_MOUSE || layout.mode == MODE_ABSMOUSE) {
+		for(int i = 0; i < layout.contacts; i++)
+			elements.push_back(makeElement(ITEM_FLAG_TRACKPAD | ITEM_FLAG_HAS_X_AXIS |
+						ITEM_FLAG_HAS_Y_AXIS | ITEM_FLAG_HAS_CONTACT));
+	}
+	// Gyro is only reported in absolute mouse mode
+	if(layout.mode != MODE_ABSMOUSE) this->layout.gyro = false;
+}
+
+float FrameGenerator::Value(double t, int i) {
+	double phase = layout.frequency * t + i * 0.137;
+	double frac = phase - floor(phase);
+	switch(layout.shape) {
+		case SHAPE_SINE:
+			return sin(2 * M_PI * phase);
+		case SHAPE_SQUARE:
+			return frac < 0.5 ? 1 : -1;
+		case SHAPE_RAMP:
+			return frac * 2 - 1;
+		case SHAPE_RANDOM:
+			return (float)rand_r(&seed) / RAND_MAX * 2 - 1;
+		case SHAPE_STATIC:
+		default:
+			return 0;
+	}
+}
+
+void FrameGenerator::Step(double t) {
+	// Input numbers, so that every input moves slightly out of phase
+	int input = 0;
+	double dt = t - lastT;
+	lastT = t;
+
+	if(layout.accel) {
+		float tiltX = Value(t, input++) * MAX_TILT;
+		float tiltY = Value(t, input++) * MAX_TILT;
+		ax = GRAVITY * sin(tiltX);
+		ay = GRAVITY * cos(tiltX) * sin(tiltY);
+		az = GRAVITY * cos(tiltX) * cos(tiltY);
+		// The phone's integrated gyro angles, as TiltFilter reads them
+		gx = tiltY;
+		gy = -tiltX;
+	}
+	if(layout.gyro)
+		gz = Value(t, input++) * MAX_TILT;
+
+	for(vector<RawBinaryElement>::iterator it = elements.begin(); it != elements.end(); it++) {
+		if(it->flags & ITEM_FLAG_BUTTON) {
+			// Reset is only pressed occasionally
+			if(it->flags & ITEM_FLAG_IS_RESET)
+				it->integer.data1 = Value(t / 10, input++) > 0.95;
+			else
+				it->integer.data1 = Value(t, input++) > 0;
+		} else if(it->flags & ITEM_FLAG_SLIDER) {
+			if(it->flags & ITEM_FLAG_HAS_X_AXIS)
+				it->integer.data1 = Value(t, input++) * SLIDER_RANGE;
+			if(it->flags & ITEM_FLAG_HAS_Y_AXIS)
+				it->integer.data2 = Value(t, input++) * SLIDER_RANGE;
+		} else if(it->flags & ITEM_FLAG_TRACKPAD && it->flags & ITEM_FLAG_HAS_CONTACT) {
+			// Fingers are lifted for part of each cycle
+			it->integer.data3 = Value(t / 2, input++) > -0.5;
+			it->integer.data1 = Value(t, input++) * SLIDER_RANGE;
+			it->integer.data2 = Value(t, input++) * SLIDER_RANGE;
+		} else if(it->flags & ITEM_FLAG_TRACKPAD) {
+			// Trackpads report an absolute position, so move them in
+			// proportion to the shape rather than setting it directly.
+			if(it->flags & ITEM_FLAG_HAS_X_AXIS)
+				it->integer.data1 += Value(t, input++) * TRACKPAD_SPEED * dt;
+			if(it->flags & ITEM_FLAG_HAS_Y_AXIS)
+				it->integer.data2 += Value(t, input++) * TRACKPAD_SPEED * dt;
+		}
+	}
+}
+
+void FrameGenerator::SetSenderTime(uint32_t sequence, uint64_t micros) {
+	timestamped = true;
+	this->sequence = sequence;
+	senderMicros = micros;
+}
+
+string FrameGenerator::SettingsLine(bool supportsBinary, int32_t capabilities) const {
+	const char *modeName;
+	int rawDevices = layout.accel ? 1 : 0, axes = 0, buttons = 0;
+	switch(layout.mode) {
+		case MODE_MOUSE:	modeName = "mouse";	buttons = 3; break;
+		case MODE_ABSMOUSE:	modeName = "absmouse";	buttons = 4; break;
+		case MODE_SLIDE:	modeName = "slide";	buttons = 8; break;
+		case MODE_JS:
+		default:
+			modeName = "js";
+			axes = layout.axes;
+			buttons = layout.buttons;
+			break;
+	}
+	char line[256];
+	snprintf(line, sizeof(line), "<MODE>%s</MODE><MODESPEC>%d,%d,%d</MODESPEC>%s%s%s%s%s\n",
+			modeName, rawDevices, axes, buttons,
+			supportsBinary ? "<SUPPORTSBINARY>" : "",
+			supportsBinary && (capabilities & CAPABILITY_DELTA) ? "<SUPPORTSDELTA>" : "",
+			supportsBinary && (capabilities & CAPABILITY_TIMESTAMPS) ? "<SUPPORTSTIMESTAMPS>" : "",
+			(capabilities & CAPABILITY_HEARTBEAT) ? "<SUPPORTSHEARTBEAT>" : "",
+			supportsBinary && (capabilities & CAPABILITY_GYRO_ANGLES) ? "<SUPPORTSGYROANGLES>" : "");
+	return line;
+}
+
+BinaryConnectionInfo FrameGenerator::ConnectionInfo(int32_t capabilities) const {
+	BinaryConnectionInfo info;
+	memset(&info, 0, sizeof(BinaryConnectionInfo));
+	memcpy(info.sig.h, "DINF", 4);
+	int buttons = 0;
+	switch(layout.mode) {
+		case MODE_MOUSE:	buttons = 3; break;
+		case MODE_ABSMOUSE:	buttons = 4; break;
+		case MODE_SLIDE:	buttons = 8; break;
+		default:		buttons = layout.buttons; break;
+	}
+	info.modeType = htonl(layout.mode);
+	info.rawDevices = htonl(layout.accel ? 1 : 0);
+	info.axes = htonl(layout.mode == MODE_JS ? layout.axes : 0);
+	info.buttons = htonl(buttons);
+	info.capabilities = htonl(capabilities);
+	return info;
+}
+
+string FrameGenerator::TextFrame() const {
+	string line = "[";
+	char token[64];
+	bool first = true;
+	if(layout.accel) {
+		snprintf(token, sizeof(token), "{%f,%f,%f}", ax, ay, az);
+		line += token;
+		first = false;
+	}
+	for(vector<RawBinaryElement>::const_iterator it = elements.begin(); it != elements.end(); it++) {
+		// The text protocol has no multi-touch
+		if(it->flags & ITEM_FLAG_HAS_CONTACT) continue;
+		if(!first) line += ";";
+		first = false;
+		if(it->flags & ITEM_FLAG_BUTTON) {
+			line += it->integer.data1 ? "1" : "0";
+		} else if(it->flags & ITEM_FLAG_SLIDER) {
+			if(it->flags & ITEM_FLAG_HAS_Y_AXIS)
+				snprintf(token, sizeof(token), "{A%d,%d}", it->integer.data1, it->integer.data2);
+			else
+				snprintf(token, sizeof(token), "{S%d}", it->integer.data1);
+			line += token;
+		} else if(it->flags & ITEM_FLAG_TRACKPAD) {
+			// Only two way trackpads have their y axis negated by the text decoder
+			if(it->flags & ITEM_FLAG_HAS_X_AXIS)
+				snprintf(token, sizeof(token), "{T%d,%d}", it->integer.data1, it->integer.data2);
+			else
+				snprintf(token, sizeof(token), "{C%d}", -it->integer.data2);
+			line += token;
+		}
+	}
+	line += "]\n";
+	return line;
+}
+
+RawBinaryHeader FrameGenerator::Header() const {
+	RawBinaryHeader header;
+	memset(&header, 0, sizeof(RawBinaryHeader));
+	memcpy(header.sig.h, "DPAD", 4);
+	header.numElements = elements.size();
+	header.flags = (layout.accel ? HEADER_FLAG_HAS_ACCEL : 0) |
+		(layout.gyro ? HEADER_FLAG_HAS_GYRO : 0);
+	header.axis.ax = ax;
+	header.axis.ay = ay;
+	header.axis.az = az;
+	header.axis.gx = gx;
+	header.axis.gy = gy;
+	header.axis.gz = gz;
+	header.axis.gzn = gz;
+	if(timestamped) {
+		header.flags |= HEADER_FLAG_TIMESTAMPED;
+		header.raw.rx = sequence;
+		header.raw.ry = senderMicros >> 32;
+		header.raw.rz = senderMicros & 0xFFFFFFFF;
+	}
+	return header;
+}
+
+string FrameGenerator::BinaryFrame() const {
+	RawBinaryHeader header = Header();
+	// Everything after the signature is a 32-bit word
+	uint32_t *words = (uint32_t *)&header.numElements;
+	for(size_t i = 0; i < (sizeof(RawBinaryHeader) - sizeof(BinarySignature)) / 4; i++)
+		words[i] = htonl(words[i]);
+
+	string frame((const char *)&header, sizeof(RawBinaryHeader));
+	for(vector<RawBinaryElement>::const_iterator it = elements.begin(); it != elements.end(); it++) {
+		RawBinaryElement elem;
+		elem.flags = htonl(it->flags);
+		elem.raw.data1 = htonl(it->raw.data1);
+		elem.raw.data2 = htonl(it->raw.data2);
+		elem.raw.data3 = htonl(it->raw.data3);
+		frame.append((const char *)&elem, sizeof(RawBinaryElement));
+	}
+	return frame;
+}
@@ -0,0 +1,146 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_SIM_FRAMEGENERATOR_H
+#define DP_SIM_FRAMEGENERATOR_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "net/protocol.hpp"
+
+namespace droidpad {
+	namespace sim {
+		/**
+		 * How the simulated inputs move over time.
+		 */
+		enum {
+			SHAPE_SINE = 1,
+			SHAPE_SQUARE,
+			SHAPE_RAMP,
+			SHAPE_RANDOM,
+			SHAPE_STATIC,
+		};
+
+		/**
+		 * What a simulated phone reports. Mirrors the layouts the app sends for each mode.
+		 */
+		class SimLayout {
+			public:
+				SimLayout();
+
+				// One of the MODE_* constants
+				int mode;
+				bool accel, gyro;
+				// On-screen axes and buttons; only used in MODE_JS.
+				int axes, buttons;
+				// Multi-touch trackpads; only used in the mouse modes.
+				int contacts;
+
+				int shape;
+				// Cycles per second of the generated shape
+				float frequency;
+
+				/**
+				 * Parses a mode name as used in the <MODE> tag.
+				 * Returns false if the name is unknown.
+				 */
+				bool SetMode(const std::string &name);
+				/**
+				 * Parses a shape name, one of sine, square, ramp, random or static.
+				 */
+				bool SetShape(const std::string &name);
+		};
+
+		/**
+		 * Builds the frames a phone would send, in both the text and binary
+		 * protocols. Each instance keeps its own state, so one is needed
+		 * per connection.
+		 */
+		class FrameGenerator {
+			public:
+				FrameGenerator(const SimLayout &layout, unsigned int seed);
+
+				/**
+				 * Moves the simulated inputs to their position at time t, in seconds
+				 * since the connection started.
+				 */
+				void Step(double t);
+
+				/**
+				 * Timestamps the following binary frames.
+				 * sequence - frame number
+				 * micros - the phone's clock, in microseconds
+				 */
+				void SetSenderTime(uint32_t sequence, uint64_t micros);
+
+				/**
+				 * The settings line sent at the start of a plain connection, including
+				 * the trailing newline.
+				 * capabilities - CAPABILITY_* flags to advertise; all but heartbeats
+				 * need the binary protocol
+				 */
+				std::string SettingsLine(bool supportsBinary, int32_t capabilities = 0) const;
+				/**
+				 * The DINF block sent at the start of a secure connection.
+				 * capabilities - CAPABILITY_* flags to advertise
+				 */
+				decode::BinaryConnectionInfo ConnectionInfo(int32_t capabilities = 0) const;
+
+				/**
+				 * The current state as a text protocol line, including the trailing newline.
+				 */
+				std::string TextFrame() const;
+				/**
+				 * The current state as a binary DPAD header followed by its elements.
+				 */
+				std::string BinaryFrame() const;
+
+				/**
+				 * The current header and elements, in host byte order.
+				 */
+				decode::RawBinaryHeader Header() const;
+				inline const std::vector<decode::RawBinaryElement> &Elements() const { return elements; }
+
+				inline size_t ElementCount() const { return elements.size(); }
+
+			protected:
+				SimLayout layout;
+				unsigned int seed;
+
+				// Current header values
+				float ax, ay, az, gx, gy, gz;
+				// Time of the last step, used to move trackpads
+				double lastT;
+
+				bool timestamped;
+				uint32_t sequence;
+				uint64_t senderMicros;
+
+				// Elements in the order they are sent, in host byte order.
+				std::vector<decode::RawBinaryElement> elements;
+
+				// Value of input i at time t, in the range [-1,1]
+				float Value(double t, int i);
+		};
+	};
+};
+
+#endif
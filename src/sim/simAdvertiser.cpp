@@ -0,0 +1,205 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "simAdvertiser.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "b64/base64.hpp"
+#include "mdnsd.h"
+
+#define MDNS_SERVICE "_droidpad._tcp.local."
+#define MDNS_TTL 120
+
+using namespace std;
+using namespace droidpad::sim;
+
+SimAdvertiser::SimAdvertiser(const string &ip) :
+	ip(ip),
+	running(false),
+	exit(false)
+{ }
+
+SimAdvertiser::~SimAdvertiser() {
+	Stop();
+}
+
+void SimAdvertiser::Add(const string &host, const string &description, bool secure, int port) {
+	Service service;
+	service.host = host;
+	service.port = port;
+	// Same naming as the app: <host>:<base64 description>.<service>
+	string desc = secure ? "secure:" + description : description;
+	service.fullName = host + ":" +
+		base64_encode((const unsigned char *)desc.c_str(), desc.size()) + "." MDNS_SERVICE;
+	services.push_back(service);
+}
+
+bool SimAdvertiser::Start() {
+	if(ip.empty()) {
+		// Find the address the OS would use to reach the multicast group.
+		int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(5353);
+		addr.sin_addr.s_addr = inet_addr("224.0.0.251");
+		socklen_t len = sizeof(addr);
+		if(s < 0 || connect(s, (struct sockaddr *)&addr, sizeof(addr)) ||
+				getsockname(s, (struct sockaddr *)&addr, &len)) {
+			fprintf(stderr, "mDNS: Couldn't find local address: %s\n", strerror(errno));
+			if(s >= 0) close(s);
+			return false;
+		}
+		close(s);
+		ip = inet_ntoa(addr.sin_addr);
+	}
+	printf("Advertising %d simulated phone(s) at %s\n", (int)services.size(), ip.c_str());
+
+	exit = false;
+	if(pthread_create(&thread, NULL, run, this)) return false;
+	running = true;
+	return true;
+}
+
+void SimAdvertiser::Stop() {
+	if(!running) return;
+	exit = true;
+	pthread_join(thread, NULL);
+	running = false;
+}
+
+void *SimAdvertiser::run(void *arg) {
+	((SimAdvertiser *)arg)->Run();
+	return NULL;
+}
+
+static void conflict(char *name, int type, void *arg) {
+	fprintf(stderr, "mDNS: Name conflict for %s (type %d)\n", name, type);
+}
+
+// Same setup as the computer's own mDNS socket
+static int msock() {
+	int s, flag = 1, ttl = 255;
+	struct sockaddr_in addrLocal;
+	memset(&addrLocal, 0, sizeof(addrLocal));
+	addrLocal.sin_family = AF_INET;
+	addrLocal.sin_port = htons(5353);
+	addrLocal.sin_addr.s_addr = 0;
+
+	struct ip_mreq ipmr;
+	ipmr.imr_multiaddr.s_addr = inet_addr("224.0.0.251");
+	ipmr.imr_interface.s_addr = htonl(INADDR_ANY);
+
+	if((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) return -1;
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (char *)&flag, sizeof(flag));
+	if(bind(s, (struct sockaddr *)&addrLocal, sizeof(addrLocal))) {
+		close(s);
+		return -1;
+	}
+	setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL, (char *)&ttl, sizeof(ttl));
+	setsockopt(s, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char *)&ipmr, sizeof(ipmr));
+
+	flag = fcntl(s, F_GETFL, 0);
+	fcntl(s, F_SETFL, flag | O_NONBLOCK);
+	return s;
+}
+
+void SimAdvertiser::Run() {
+	int s = msock();
+	if(s < 0) {
+		fprintf(stderr, "mDNS: Can't create socket: %s\n", strerror(errno));
+		return;
+	}
+
+	mdnsd d = mdnsd_new(1, 1000);
+	// Published as raw data, rather than with mdnsd_set_ip, so that our own
+	// multicast answers coming back aren't seen as conflicts.
+	in_addr_t hostIp = inet_addr(ip.c_str());
+	for(vector<Service>::iterator it = services.begin(); it != services.end(); it++) {
+		string hostName = it->host + ".local.";
+		mdnsdr r = mdnsd_shared(d, (char *)MDNS_SERVICE, QTYPE_PTR, MDNS_TTL);
+		mdnsd_set_host(d, r, (char *)it->fullName.c_str());
+		r = mdnsd_unique(d, (char *)it->fullName.c_str(), QTYPE_SRV, MDNS_TTL, conflict, this);
+		mdnsd_set_srv(d, r, 0, 0, it->port, (char *)hostName.c_str());
+		r = mdnsd_unique(d, (char *)hostName.c_str(), QTYPE_A, MDNS_TTL, conflict, this);
+		mdnsd_set_raw(d, r, (char *)&hostIp, 4);
+	}
+
+	struct message m;
+	unsigned long int pip;
+	unsigned short int pport;
+	unsigned char buf[MAX_PACKET_LEN];
+	while(!exit) {
+		struct timeval *tv = mdnsd_sleep(d);
+		// Wake up regularly to check for exit
+		struct timeval limit = { 0, 100000 };
+		if(tv->tv_sec > 0 || tv->tv_usec > limit.tv_usec) tv = &limit;
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(s, &fds);
+		select(s + 1, &fds, 0, 0, tv);
+
+		if(FD_ISSET(s, &fds)) {
+			struct sockaddr_in from;
+			socklen_t ssize = sizeof(from);
+			int bsize;
+			while((bsize = recvfrom(s, (char *)buf, MAX_PACKET_LEN, 0, (struct sockaddr *)&from, &ssize)) > 0) {
+				memset(&m, 0, sizeof(struct message));
+				message_parse(&m, buf);
+				mdnsd_in(d, &m, (unsigned long int)from.sin_addr.s_addr, from.sin_port);
+			}
+		}
+
+		while(mdnsd_out(d, &m, &pip, &pport)) {
+			struct sockaddr_in to;
+			memset(&to, 0, sizeof(to));
+			to.sin_family = AF_INET;
+			to.sin_port = pport;
+			to.sin_addr.s_addr = pip;
+			if(sendto(s, (char *)message_packet(&m), message_packet_len(&m), 0,
+						(struct sockaddr *)&to, sizeof(to)) != message_packet_len(&m))
+				fprintf(stderr, "mDNS: Can't write to socket: %s\n", strerror(errno));
+		}
+	}
+
+	// Send goodbyes so that the computer removes the devices straight away
+	mdnsd_shutdown(d);
+	while(mdnsd_out(d, &m, &pip, &pport)) {
+		struct sockaddr_in to;
+		memset(&to, 0, sizeof(to));
+		to.sin_family = AF_INET;
+		to.sin_port = pport;
+		to.sin_addr.s_addr = pip;
+		sendto(s, (char *)message_packet(&m), message_packet_len(&m), 0,
+				(struct sockaddr *)&to, sizeof(to));
+	}
+	mdnsd_free(d);
+	close(s);
+}
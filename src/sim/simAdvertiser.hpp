@@ -0,0 +1,76 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_SIM_ADVERTISER_H
+#define DP_SIM_ADVERTISER_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace droidpad {
+	namespace sim {
+		/**
+		 * Publishes simulated phones over mDNS as _droidpad._tcp.local. services,
+		 * in the same form as the app. A single advertiser handles all instances.
+		 */
+		class SimAdvertiser {
+			public:
+				/**
+				 * ip - Address to advertise, in dotted form. If empty, the address
+				 * of the interface used for multicast is found automatically.
+				 */
+				SimAdvertiser(const std::string &ip);
+				~SimAdvertiser();
+
+				/**
+				 * Adds a service. Must be called before Start.
+				 * host - Single label host name, eg. "dpsim-1"
+				 * description - Name shown on the computer
+				 */
+				void Add(const std::string &host, const std::string &description, bool secure, int port);
+
+				bool Start();
+				void Stop();
+
+				/**
+				 * The full mDNS name of service i, as the computer will see it.
+				 */
+				inline const std::string &FullName(int i) const { return services[i].fullName; }
+
+			protected:
+				class Service {
+					public:
+						std::string host, fullName;
+						int port;
+				};
+				std::vector<Service> services;
+				std::string ip;
+
+				pthread_t thread;
+				bool running;
+				volatile bool exit;
+
+				static void *run(void *arg);
+				void Run();
+		};
+	};
+};
+
+#endif
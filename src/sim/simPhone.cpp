@@ -0,0 +1,436 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "simPhone.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <openssl/err.h>
+
+#include "timing.hpp"
+#include "net/deltaFrame.hpp"
+
+// How often blocked threads check whether they should exit, in ms
+#define EXIT_POLL_TIME 100
+
+using namespace std;
+using namespace droidpad;
+using namespace droidpad::sim;
+using namespace droidpad::decode;
+
+// Ways in which a stream of frames can end
+enum {
+	END_STOPPED = 1, // Computer asked to stop
+	END_CLOSED, // Computer closed the connection or it failed
+	END_DROPPED, // Simulated connection loss
+	END_EXIT, // Simulator shutting down
+};
+
+SimSettings::SimSettings() :
+	rate(60),
+	basePort(3141),
+	textOnly(false),
+	delta(false),
+	timestamps(false),
+	clockOffset(0),
+	dropAfter(0),
+	stallAfter(0),
+	secure(false),
+	legacyTls(false)
+{ }
+
+SimStats::SimStats() :
+	connections(0), drops(0), stalls(0),
+	frames(0), bytes(0),
+	lateFrames(0), skippedFrames(0),
+	totalLateness(0), maxLateness(0)
+{ }
+
+SimStats &SimStats::operator+=(const SimStats &rhs) {
+	connections += rhs.connections;
+	drops += rhs.drops;
+	stalls += rhs.stalls;
+	frames += rhs.frames;
+	bytes += rhs.bytes;
+	lateFrames += rhs.lateFrames;
+	skippedFrames += rhs.skippedFrames;
+	totalLateness += rhs.totalLateness;
+	if(rhs.maxLateness > maxLateness) maxLateness = rhs.maxLateness;
+	return *this;
+}
+
+SimPhone::SimPhone(const SimSettings &settings, int index, SSL_CTX *tlsContext) :
+	settings(settings),
+	index(index),
+	port(settings.basePort + index * 2),
+	tlsContext(tlsContext),
+	exit(false),
+	listenFd(-1),
+	secureListenFd(-1),
+	running(false),
+	secureRunning(false)
+{
+	pthread_mutex_init(&statsLock, NULL);
+}
+
+SimPhone::~SimPhone() {
+	Stop();
+	pthread_mutex_destroy(&statsLock);
+}
+
+static int createListener(int port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(fd < 0) return -1;
+	int flag = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (char *)&flag, sizeof(flag));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 1)) {
+		fprintf(stderr, "Couldn't listen on port %d: %s\n", port, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool SimPhone::Start() {
+	exit = false;
+	if((listenFd = createListener(port)) < 0) return false;
+	if(pthread_create(&thread, NULL, listenThread, this)) return false;
+	running = true;
+
+	if(tlsContext) {
+		if((secureListenFd = createListener(port + 1)) < 0) return false;
+		if(pthread_create(&secureThread, NULL, secureListenThread, this)) return false;
+		secureRunning = true;
+	}
+	return true;
+}
+
+void SimPhone::Stop() {
+	exit = true;
+	if(running) pthread_join(thread, NULL);
+	if(secureRunning) pthread_join(secureThread, NULL);
+	running = secureRunning = false;
+	if(listenFd >= 0) close(listenFd);
+	if(secureListenFd >= 0) close(secureListenFd);
+	listenFd = secureListenFd = -1;
+}
+
+SimStats SimPhone::GetStats(bool reset) {
+	pthread_mutex_lock(&statsLock);
+	SimStats ret = stats;
+	if(reset) {
+		// Connections are a running total
+		uint64_t connections = stats.connections;
+		stats = SimStats();
+		stats.connections = connections;
+	}
+	pthread_mutex_unlock(&statsLock);
+	return ret;
+}
+
+void *SimPhone::listenThread(void *arg) {
+	SimPhone *phone = (SimPhone *)arg;
+	phone->Listen(phone->listenFd, false);
+	return NULL;
+}
+
+void *SimPhone::secureListenThread(void *arg) {
+	SimPhone *phone = (SimPhone *)arg;
+	phone->Listen(phone->secureListenFd, true);
+	return NULL;
+}
+
+void SimPhone::Listen(int fd, bool secure) {
+	while(!exit) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if(poll(&pfd, 1, EXIT_POLL_TIME) <= 0) continue;
+
+		int conn = accept(fd, NULL, NULL);
+		if(conn < 0) continue;
+		int flag = 1;
+		setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, (char *)&flag, sizeof(flag));
+
+		pthread_mutex_lock(&statsLock);
+		stats.connections++;
+		pthread_mutex_unlock(&statsLock);
+
+		Serve(conn, secure);
+	}
+}
+
+int32_t SimPhone::Capabilities() const {
+	// Heartbeats are accepted, and ignored, by every simulated phone, and
+	// gyro angles always agree with the accelerometer
+	return CAPABILITY_HEARTBEAT | CAPABILITY_GYRO_ANGLES |
+		(settings.delta ? CAPABILITY_DELTA : 0) |
+		(settings.timestamps ? CAPABILITY_TIMESTAMPS : 0);
+}
+
+void SimPhone::Serve(int fd, bool secure) {
+	if(secure) {
+		ServeTls(fd);
+		return;
+	}
+	FrameGenerator gen(settings.layout, index);
+	string settingsLine = gen.SettingsLine(!settings.textOnly, Capabilities());
+	if(send(fd, settingsLine.c_str(), settingsLine.size(), MSG_NOSIGNAL) < 0) {
+		close(fd);
+		return;
+	}
+	Stream(fd, NULL, gen, false);
+	close(fd);
+}
+
+void SimPhone::ServeTls(int fd) {
+	FrameGenerator gen(settings.layout, index);
+	SSL *ssl = SSL_new(tlsContext);
+	SSL_set_fd(ssl, fd);
+	if(SSL_connect(ssl) != 1) {
+		fprintf(stderr, "Simulated phone %d: TLS handshake failed\n", index);
+		ERR_print_errors_fp(stderr);
+		SSL_free(ssl);
+		close(fd);
+		return;
+	}
+	fprintf(stderr, "Simulated phone %d: %s, %s\n", index, SSL_get_version(ssl), SSL_get_cipher_name(ssl));
+
+	BinaryConnectionInfo info = gen.ConnectionInfo(Capabilities());
+	if(SSL_write(ssl, &info, sizeof(BinaryConnectionInfo)) == sizeof(BinaryConnectionInfo)) {
+		if(Stream(fd, ssl, gen, true) == END_STOPPED)
+			SSL_shutdown(ssl);
+	}
+	SSL_free(ssl);
+	close(fd);
+}
+
+static bool sendAll(int fd, SSL *ssl, const string &data) {
+	if(ssl) return SSL_write(ssl, data.c_str(), data.size()) == (int)data.size();
+	size_t pos = 0;
+	while(pos < data.size()) {
+		ssize_t amt = send(fd, data.c_str() + pos, data.size() - pos, MSG_NOSIGNAL);
+		if(amt < 0) {
+			if(errno == EINTR) continue;
+			return false;
+		}
+		pos += amt;
+	}
+	return true;
+}
+
+// The simulated phone's clock, in microseconds
+static uint64_t phoneMicros(const SimSettings &settings) {
+	return monotonicNanos() / NANOS_PER_MICRO + settings.clockOffset;
+}
+
+static string makePong(uint32_t id, uint64_t receiveTime, uint64_t sendTime) {
+	BinaryPong pong;
+	memcpy(pong.sig.h, "DPNG", 4);
+	pong.id = htonl(id);
+	pong.receiveHigh = htonl(receiveTime >> 32);
+	pong.receiveLow = htonl(receiveTime & 0xFFFFFFFF);
+	pong.sendHigh = htonl(sendTime >> 32);
+	pong.sendLow = htonl(sendTime & 0xFFFFFFFF);
+	return string((const char *)&pong, sizeof(BinaryPong));
+}
+
+int SimPhone::Stream(int fd, SSL *ssl, FrameGenerator &gen, bool binary) {
+	const uint64_t period = NANOS_PER_SEC / settings.rate;
+	const uint64_t start = monotonicNanos();
+	uint64_t next = start;
+	int sent = 0;
+	string inData;
+	char buf[256];
+	DeltaEncoder encoder;
+	bool delta = false;
+	uint32_t sequence = 0;
+
+	while(!exit) {
+		uint64_t now = monotonicNanos();
+		if(now < next) {
+			// Wait for the next frame, handling anything sent by the computer meanwhile.
+			bool readable = ssl && SSL_pending(ssl);
+			if(!readable) {
+				uint64_t wait = next - now;
+				if(wait > EXIT_POLL_TIME * NANOS_PER_MILLI) wait = EXIT_POLL_TIME * NANOS_PER_MILLI;
+				struct timespec ts = { (time_t)(wait / NANOS_PER_SEC), (long)(wait % NANOS_PER_SEC) };
+				struct pollfd pfd = { fd, POLLIN, 0 };
+				int ret = ppoll(&pfd, 1, &ts, NULL);
+				if(ret < 0 && errno != EINTR) return END_CLOSED;
+				readable = ret > 0;
+			}
+			if(!readable) continue;
+
+			if(ssl) {
+				BinaryServerMessage msg;
+				if(SSL_read(ssl, &msg, sizeof(BinaryServerMessage)) != sizeof(BinaryServerMessage))
+					return END_CLOSED;
+				if(msg.sig.isCmd() && ntohl(msg.msg) == CMD_STOP)
+					return END_STOPPED;
+				if(msg.sig.isCmd() && ntohl(msg.msg) == CMD_DELTA && settings.delta)
+					delta = true;
+				if(msg.sig.isCmd() && ntohl(msg.msg) == CMD_PING) {
+					uint64_t received = phoneMicros(settings);
+					uint32_t id;
+					if(SSL_read(ssl, &id, sizeof(id)) != sizeof(id))
+						return END_CLOSED;
+					if(settings.timestamps &&
+							!sendAll(fd, ssl, makePong(ntohl(id), received, phoneMicros(settings))))
+						return END_CLOSED;
+				}
+			} else {
+				ssize_t amt = recv(fd, buf, sizeof(buf), 0);
+				if(amt <= 0) return END_CLOSED;
+				uint64_t received = phoneMicros(settings);
+				inData.append(buf, amt);
+				size_t returnPosition;
+				while((returnPosition = inData.find('\n')) != string::npos) {
+					string line = inData.substr(0, returnPosition);
+					inData = inData.substr(returnPosition + 1);
+					if(line == "<STOP>") return END_STOPPED;
+					if(line == "<BINARY>" && !settings.textOnly) binary = true;
+					if(line == "<DELTA>" && binary && settings.delta) delta = true;
+					unsigned int id;
+					if(sscanf(line.c_str(), "<PING>%u</PING>", &id) == 1 && binary && settings.timestamps)
+						if(!sendAll(fd, ssl, makePong(id, received, phoneMicros(settings))))
+							return END_CLOSED;
+				}
+			}
+			continue;
+		}
+
+		// Frame is due. If more than a period has been missed, skip those frames
+		// rather than sending a burst.
+		uint64_t lateness = now - next;
+		uint64_t skipped = lateness / period;
+		next += skipped * period;
+
+		gen.Step((double)(next - start) / NANOS_PER_SEC);
+		if(settings.timestamps) gen.SetSenderTime(sequence++, phoneMicros(settings));
+		string frame;
+		// Layouts too large for delta frames are sent in full
+		if(!delta || !encoder.Encode(gen.Header(), gen.Elements(), frame))
+			frame = binary ? gen.BinaryFrame() : gen.TextFrame();
+		if(!sendAll(fd, ssl, frame)) return END_CLOSED;
+		next += period;
+
+		pthread_mutex_lock(&statsLock);
+		stats.frames++;
+		stats.bytes += frame.size();
+		stats.skippedFrames += skipped;
+		if(lateness > period / 10) stats.lateFrames++;
+		stats.totalLateness += lateness;
+		if(lateness > stats.maxLateness) stats.maxLateness = lateness;
+		pthread_mutex_unlock(&statsLock);
+
+		sent++;
+		if(settings.stallAfter > 0 && sent == settings.stallAfter) {
+			// Keep handling what the computer sends, but never send another frame
+			next = (uint64_t)-1;
+			pthread_mutex_lock(&statsLock);
+			stats.stalls++;
+			pthread_mutex_unlock(&statsLock);
+		}
+		if(settings.dropAfter > 0 && sent >= settings.dropAfter) {
+			// Reset rather than close, as a phone losing its connection would.
+			struct linger lin = { 1, 0 };
+			setsockopt(fd, SOL_SOCKET, SO_LINGER, (char *)&lin, sizeof(lin));
+			pthread_mutex_lock(&statsLock);
+			stats.drops++;
+			pthread_mutex_unlock(&statsLock);
+			return END_DROPPED;
+		}
+	}
+	return END_EXIT;
+}
+
+unsigned int SimPhone::pskCallback(SSL *ssl, const char *hint,
+		char *identity, unsigned int maxIdentityLen,
+		unsigned char *psk, unsigned int maxPskLen) {
+	const SimSettings *settings = (const SimSettings *)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+	if(settings->deviceId.size() + 1 > maxIdentityLen || settings->psk.size() > maxPskLen)
+		return 0;
+	strcpy(identity, settings->deviceId.c_str());
+	memcpy(psk, settings->psk.c_str(), settings->psk.size());
+	return settings->psk.size();
+}
+
+#ifdef TLS1_3_VERSION
+int SimPhone::pskSessionCallback(SSL *ssl, const EVP_MD *md,
+		const unsigned char **id, size_t *idLen, SSL_SESSION **session) {
+	const SimSettings *settings = (const SimSettings *)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+	const unsigned char aes128GcmSha256[] = { 0x13, 0x01 };
+	const SSL_CIPHER *cipher = SSL_CIPHER_find(ssl, aes128GcmSha256);
+	*session = NULL;
+	// A second call is made with the hash of the chosen cipher; only SHA256 is offered
+	if(cipher == NULL || (md != NULL && md != SSL_CIPHER_get_handshake_digest(cipher)))
+		return 1;
+	SSL_SESSION *pskSession = SSL_SESSION_new();
+	if(pskSession == NULL ||
+			!SSL_SESSION_set1_master_key(pskSession, (const unsigned char *)settings->psk.c_str(), settings->psk.size()) ||
+			!SSL_SESSION_set_cipher(pskSession, cipher) ||
+			!SSL_SESSION_set_protocol_version(pskSession, TLS1_3_VERSION)) {
+		SSL_SESSION_free(pskSession);
+		return 0;
+	}
+	*id = (const unsigned char *)settings->deviceId.c_str();
+	*idLen = settings->deviceId.size();
+	*session = pskSession;
+	return 1;
+}
+#endif
+
+SSL_CTX *SimPhone::CreateTlsContext(SimSettings *settings) {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+	if(!ctx) return NULL;
+	// Computers before TLS 1.3 support only offer TLS 1.0 PSK ciphers, which
+	// newer OpenSSLs refuse by default.
+	SSL_CTX_set_min_proto_version(ctx, TLS1_VERSION);
+	SSL_CTX_set_security_level(ctx, 0);
+	if(settings->legacyTls) SSL_CTX_set_max_proto_version(ctx, TLS1_VERSION);
+#else
+	SSL_CTX *ctx = SSL_CTX_new(SSLv23_client_method());
+	if(!ctx) return NULL;
+#endif
+	SSL_CTX_set_cipher_list(ctx, settings->legacyTls ? "PSK" :
+			"PSK-AES128-GCM-SHA256:PSK-CHACHA20-POLY1305:PSK");
+#ifdef TLS1_3_VERSION
+	SSL_CTX_set_ciphersuites(ctx, "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256");
+	SSL_CTX_set_psk_use_session_callback(ctx, &SimPhone::pskSessionCallback);
+#endif
+	SSL_CTX_set_psk_client_callback(ctx, &SimPhone::pskCallback);
+	SSL_CTX_set_app_data(ctx, settings);
+	return ctx;
+}
@@ -0,0 +1,156 @@
+/*
+ * This file is part of DroidPad.
+ * DroidPad lets you use an Android mobile to control a joystick or mouse
+ * on a Windows or Linux computer.
+ *
+ * DroidPad is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DroidPad is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DroidPad, in the file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DP_SIM_SIMPHONE_H
+#define DP_SIM_SIMPHONE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+
+#include <openssl/ssl.h>
+
+#include "frameGenerator.hpp"
+
+namespace droidpad {
+	namespace sim {
+		class SimSettings {
+			public:
+				SimSettings();
+
+				SimLayout layout;
+
+				// Frames per second sent to the computer
+				float rate;
+				// Plain port of the first instance. Instance i listens on
+				// basePort + 2i, and basePort + 2i + 1 for secure connections.
+				int basePort;
+
+				// Ignore <BINARY> requests and keep sending the text protocol
+				bool textOnly;
+				// Offer DPD2 delta frames, and send them if the computer asks
+				bool delta;
+				// Timestamp binary frames and answer pings
+				bool timestamps;
+				// Added to the phone's clock, in microseconds, so that it
+				// differs from the computer's
+				int64_t clockOffset;
+				// Abruptly close each connection after this many frames, to
+				// exercise reconnection. 0 to never drop.
+				int dropAfter;
+				// Stop sending after this many frames, leaving the connection
+				// open, as when Wi-Fi goes out of range. 0 to never stall.
+				int stallAfter;
+
+				// Secure connections. Credentials are as created when pairing.
+				bool secure;
+				// Only use TLS 1.0 and CBC ciphers, as older versions of the app do
+				bool legacyTls;
+				std::string deviceId;
+				std::string psk;
+		};
+
+		/**
+		 * Counters for a simulated phone. Times are in nanoseconds.
+		 */
+		class SimStats {
+			public:
+				SimStats();
+
+				uint64_t connections, drops, stalls;
+				uint64_t frames, bytes;
+				// Frames sent more than a tenth of a period late, and frames which
+				// were skipped because the sender fell more than a whole period behind.
+				uint64_t lateFrames, skippedFrames;
+				uint64_t totalLateness, maxLateness;
+
+				SimStats &operator+=(const SimStats &rhs);
+		};
+
+		/**
+		 * A single simulated phone. Accepts one connection at a time on each
+		 * of its ports, and streams generated frames to it until the computer
+		 * stops or disconnects.
+		 */
+		class SimPhone {
+			public:
+				/**
+				 * tlsContext - client context used for secure connections; may be NULL
+				 * if secure connections aren't wanted.
+				 */
+				SimPhone(const SimSettings &settings, int index, SSL_CTX *tlsContext);
+				~SimPhone();
+
+				bool Start();
+				void Stop();
+
+				inline int Port() const { return port; }
+
+				/**
+				 * Returns the counters, and resets them if reset is true.
+				 */
+				SimStats GetStats(bool reset);
+
+				/**
+				 * Creates the TLS client context for the secure port. The phone
+				 * is the TLS client, even though the computer connects to it.
+				 */
+				static SSL_CTX *CreateTlsContext(SimSettings *settings);
+
+			protected:
+				const SimSettings &settings;
+				int index;
+				int port;
+				SSL_CTX *tlsContext;
+
+				volatile bool exit;
+				int listenFd, secureListenFd;
+				pthread_t thread, secureThread;
+				bool running, secureRunning;
+
+				pthread_mutex_t statsLock;
+				SimStats stats;
+
+				static void *listenThread(void *arg);
+				static void *secureListenThread(void *arg);
+				void Listen(int fd, bool secure);
+
+				// CAPABILITY_* flags to advertise
+				int32_t Capabilities() const;
+
+				void Serve(int fd, bool secure);
+				void ServeTls(int fd);
+				/**
+				 * Sends frames until the connection ends. Returns how it ended.
+				 * ssl - NULL for plain connections.
+				 */
+				int Stream(int fd, SSL *ssl, FrameGenerator &gen, bool binary);
+
+				static unsigned int pskCallback(SSL *ssl, const char *hint,
+						char *identity, unsigned int maxIdentityLen,
+						unsigned char *psk, unsigned int maxPskLen);
+#ifdef TLS1_3_VERSION
+				static int pskSessionCallback(SSL *ssl, const EVP_MD *md,
+						const unsigned char **id, size_t *idLen, SSL_SESSION **session);
+#endif
+		};
+	};
+};
+
+#endif